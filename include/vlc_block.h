@@ -621,6 +621,87 @@ static inline void vlc_fifo_Cleanup(void *fifo)
 
 /** @} */
 
+/**
+ * \defgroup block_spsc Single producer single consumer block FIFO
+ * @{
+ *
+ * Bounded block queue for exactly one writing thread and one reading thread,
+ * e.g. a demuxer feeding a decoder. Blocks are exchanged through a ring
+ * without locking: the threads only sleep, on a lock and condition variable,
+ * when the ring is empty (reader) or full (writer).
+ */
+
+typedef struct block_spsc_t block_spsc_t;
+
+/**
+ * Creates a single producer single consumer FIFO.
+ *
+ * @param size capacity in blocks (rounded up to a power of two)
+ * @return a FIFO, or NULL on memory error
+ */
+VLC_API block_spsc_t *block_SpscNew(size_t size) VLC_USED;
+
+/**
+ * Destroys a FIFO created with block_SpscNew(), releasing the queued blocks.
+ * Neither thread may use the FIFO anymore.
+ */
+VLC_API void block_SpscRelease(block_spsc_t *);
+
+/**
+ * Queues a block, if there is room for it.
+ *
+ * @note Only the producer thread may call this function.
+ *
+ * @return true if the block was queued, false if the FIFO is full
+ */
+VLC_API bool block_SpscTryPut(block_spsc_t *, block_t *) VLC_USED;
+
+/**
+ * Queues a list of blocks, waiting for room as needed.
+ * This function is a cancellation point when it waits.
+ *
+ * @note Only the producer thread may call this function.
+ *
+ * @param block head of a block list to queue (may be NULL)
+ */
+VLC_API void block_SpscPut(block_spsc_t *, block_t *block);
+
+/**
+ * Dequeues the first block, if any.
+ *
+ * @note Only the consumer thread may call this function.
+ *
+ * @return the first block, or NULL if the FIFO is empty
+ */
+VLC_API block_t *block_SpscTryGet(block_spsc_t *) VLC_USED;
+
+/**
+ * Dequeues the first block, waiting for one if needed.
+ * This function is (always) a cancellation point.
+ *
+ * @note Only the consumer thread may call this function.
+ *
+ * @return a valid block
+ */
+VLC_API block_t *block_SpscGet(block_spsc_t *) VLC_USED;
+
+/**
+ * Counts blocks in a FIFO.
+ *
+ * @note The other thread may change the count at any time. From the producer,
+ * this is an upper bound, from the consumer, a lower bound.
+ */
+VLC_API size_t block_SpscGetCount(const block_spsc_t *) VLC_USED;
+
+/**
+ * Counts bytes in a FIFO, as vlc_fifo_GetBytes() does.
+ *
+ * @note The value may be out of date as soon as it is returned.
+ */
+VLC_API size_t block_SpscGetBytes(const block_spsc_t *) VLC_USED;
+
+/** @} */
+
 /** @} */
 
 #endif /* VLC_BLOCK_H */
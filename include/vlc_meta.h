@@ -102,9 +102,18 @@ typedef struct meta_export_t
     VLC_COMMON_MEMBERS
     input_item_t *p_item;
     const char *psz_file;
+    uint64_t i_written; /**< bytes written, or UINT64_MAX if unknown */
 } meta_export_t;
 
 VLC_API int input_item_WriteMeta(vlc_object_t *, input_item_t *);
+/**
+ * Writes the meta of an item back to its file, like input_item_WriteMeta().
+ * \param written where to store the number of bytes written to the file,
+ * including the media data moved to make room for the tags, or UINT64_MAX
+ * if unknown (may be NULL)
+ */
+VLC_API int input_item_WriteMetaExt(vlc_object_t *, input_item_t *,
+                                    uint64_t *written);
 
 /* Setters for meta.
  * Warning: Make sure to use the input_item meta setters (defined in vlc_input_item.h)
@@ -136,6 +136,20 @@ struct playlist_item_t
     uint8_t                i_flags;     /**< Flags \see playlist_item_flags_e */
 };
 
+/** Entry of a playlist snapshot \see playlist_NodeSnapshot */
+typedef struct playlist_snapshot_entry_t
+{
+    input_item_t          *p_input;     /**< Linked input item (held) */
+    char                  *psz_uri;     /**< Input URI, or NULL */
+} playlist_snapshot_entry_t;
+
+/** Flat copy of the items below a node \see playlist_NodeSnapshot */
+typedef struct playlist_snapshot_t
+{
+    size_t                     i_count;
+    playlist_snapshot_entry_t *p_entries;
+} playlist_snapshot_t;
+
 typedef enum {
     PLAYLIST_DBL_FLAG          = 0x04,  /**< Is it disabled ? */
     PLAYLIST_RO_FLAG           = 0x08,  /**< Write-enabled ? */
@@ -319,6 +333,17 @@ VLC_API input_thread_t *playlist_CurrentInputLocked( playlist_t *p_playlist ) VL
  */
 VLC_API mtime_t playlist_GetNodeDuration( playlist_item_t * );
 
+/**
+ * Take a snapshot of all the items (not the nodes) below a node, in tree
+ * order, along with a copy of their URI. The entries can then be used without
+ * the playlist lock.
+ * The playlist must be locked.
+ * \return the snapshot, to release with playlist_SnapshotRelease(), or NULL
+ */
+VLC_API playlist_snapshot_t * playlist_NodeSnapshot( playlist_t *,
+                                                     playlist_item_t * ) VLC_USED;
+VLC_API void playlist_SnapshotRelease( playlist_snapshot_t * );
+
 /** Clear the playlist
  * \param b_locked TRUE if playlist is locked when entering this function
  */
@@ -52,6 +52,9 @@
 #   include <unistd.h>
 #endif
 #include <dirent.h>
+#ifdef HAVE_MMAP
+#   include <sys/mman.h>
+#endif
 
 #include <vlc_common.h>
 #include "fs.h"
@@ -69,8 +72,15 @@ struct access_sys_t
     int fd;
 
     bool b_pace_control;
+
+    /* memory mapped block mode */
+    uint64_t offset;
+    size_t page_mask;
 };
 
+/** Size of the file windows mapped at once in block mode */
+#define FILE_MMAP_SIZE (1 << 20)
+
 #if !defined (_WIN32) && !defined (__OS2__)
 static bool IsRemote (int fd)
 {
@@ -128,6 +138,9 @@ static bool IsRemote (const char *path)
 #endif
 
 static ssize_t Read (stream_t *, void *, size_t);
+#ifdef HAVE_MMAP
+static block_t *MmapBlock (stream_t *, bool *);
+#endif
 static int FileSeek (stream_t *, uint64_t);
 static int NoSeek (stream_t *, uint64_t);
 static int FileControl (stream_t *, int, va_list);
@@ -213,12 +226,25 @@ int FileOpen( vlc_object_t *p_this )
     p_access->pf_control = FileControl;
     p_access->p_sys = p_sys;
     p_sys->fd = fd;
+    p_sys->offset = 0;
 
     if (S_ISREG (st.st_mode) || S_ISBLK (st.st_mode))
     {
         p_access->pf_seek = FileSeek;
         p_sys->b_pace_control = true;
 
+#ifdef HAVE_MMAP
+        /* Hand out the mapped pages rather than copying them, but only for
+         * local regular files: remote ones may change under our feet. */
+        if (S_ISREG (st.st_mode) && var_InheritBool (p_access, "file-mmap")
+         && !IsRemote(fd, p_access->psz_filepath))
+        {
+            p_access->pf_read = NULL;
+            p_access->pf_block = MmapBlock;
+            p_sys->page_mask = sysconf (_SC_PAGESIZE) - 1;
+        }
+#endif
+
         /* Demuxers will need the beginning of the file for probing. */
         posix_fadvise (fd, 0, 4096, POSIX_FADV_WILLNEED);
         /* In most cases, we only read the file once. */
@@ -253,7 +279,7 @@ void FileClose (vlc_object_t * p_this)
 {
     stream_t     *p_access = (stream_t*)p_this;
 
-    if (p_access->pf_read == NULL)
+    if (p_access->pf_read == NULL && p_access->pf_block == NULL)
     {
         DirClose (p_this);
         return;
@@ -287,6 +313,59 @@ static ssize_t Read (stream_t *p_access, void *p_buffer, size_t i_len)
     return val;
 }
 
+#ifdef HAVE_MMAP
+static block_t *MmapBlock (stream_t *p_access, bool *restrict eof)
+{
+    access_sys_t *p_sys = p_access->p_sys;
+    struct stat st;
+
+    /* Never map past the end: the file may have grown, or shrunk, since */
+    if (fstat (p_sys->fd, &st))
+    {
+        msg_Err (p_access, "read error: %s", vlc_strerror_c(errno));
+        *eof = true;
+        return NULL;
+    }
+    if (p_sys->offset >= (uint64_t)st.st_size)
+    {
+        *eof = true;
+        return NULL;
+    }
+
+    size_t length = FILE_MMAP_SIZE;
+    if ((uint64_t)st.st_size - p_sys->offset < length)
+        length = st.st_size - p_sys->offset;
+
+    /* Mappings start on a page boundary */
+    size_t skip = p_sys->offset & p_sys->page_mask;
+    /* Private and writable: demuxers may modify their blocks in place */
+    void *addr = mmap (NULL, skip + length, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE, p_sys->fd, p_sys->offset - skip);
+    if (addr == MAP_FAILED)
+    {
+        msg_Err (p_access, "cannot map file: %s", vlc_strerror_c(errno));
+        *eof = true;
+        return NULL;
+    }
+
+#ifdef HAVE_POSIX_MADVISE
+    posix_madvise (addr, skip + length, POSIX_MADV_SEQUENTIAL);
+    posix_madvise (addr, skip + length, POSIX_MADV_WILLNEED);
+#endif
+
+    /* The block must cover the whole mapping, or it could be grown in place
+     * past its end, and could not be unmapped. */
+    block_t *block = block_mmap_Alloc (addr, skip + length);
+    if (unlikely(block == NULL))
+        return NULL;
+    block->p_buffer += skip;
+    block->i_buffer -= skip;
+
+    p_sys->offset += length;
+    return block;
+}
+#endif
+
 /*****************************************************************************
  * Seek: seek to a specific location in a file
  *****************************************************************************/
@@ -294,6 +373,12 @@ static int FileSeek (stream_t *p_access, uint64_t i_pos)
 {
     access_sys_t *sys = p_access->p_sys;
 
+    if (p_access->pf_block != NULL)
+    {   /* mapped block mode reads at its own offset */
+        sys->offset = i_pos;
+        return VLC_SUCCESS;
+    }
+
     if (lseek(sys->fd, i_pos, SEEK_SET) == (off_t)-1)
         return VLC_EGENERIC;
     return VLC_SUCCESS;
@@ -40,6 +40,11 @@ vlc_module_begin ()
     add_shortcut( "file", "fd", "stream" )
     set_callbacks( FileOpen, FileClose )
 
+    add_bool( "file-mmap", false, N_("Map local files in memory"),
+              N_("Read local files through memory mappings, rather than "
+                 "copying their data. The file must not be truncated while "
+                 "it is played, as this would crash."), true )
+
     add_submodule()
     set_section( N_("Directory" ), NULL )
     set_capability( "access", 55 )
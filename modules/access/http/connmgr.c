@@ -258,6 +258,72 @@ struct vlc_http_msg *vlc_http_mgr_request(struct vlc_http_mgr *mgr, bool https,
     return (https ? vlc_https_request : vlc_http_request)(mgr, host, port, m);
 }
 
+struct vlc_http_stream *vlc_https_mgr_open(struct vlc_http_mgr *mgr,
+                                           const char *host, unsigned port,
+                                           const struct vlc_http_msg *req,
+                                           bool *restrict multiplexed)
+{
+    if (mgr->conn != NULL)
+    {
+        struct vlc_http_stream *stream = vlc_http_stream_open(mgr->conn, req);
+        if (stream != NULL)
+        {
+            *multiplexed = true;
+            return stream;
+        }
+        /* Get rid of closing or reset connection */
+        vlc_http_mgr_release(mgr, mgr->conn);
+    }
+
+    if (mgr->creds == NULL)
+    {
+        mgr->creds = vlc_tls_ClientCreate(mgr->obj);
+        if (mgr->creds == NULL)
+            return NULL;
+    }
+
+    vlc_tls_t *tls;
+    bool http2 = true;
+
+    char *proxy = vlc_http_proxy_find(host, port, true);
+    if (proxy != NULL)
+    {
+        tls = vlc_https_connect_proxy(mgr->creds, mgr->creds,
+                                      host, port, &http2, proxy);
+        free(proxy);
+    }
+    else
+        tls = vlc_https_connect(mgr->creds, host, port, &http2);
+
+    if (tls == NULL)
+        return NULL;
+
+    struct vlc_http_conn *conn;
+
+    if (http2)
+        conn = vlc_h2_conn_create(mgr->obj, tls);
+    else
+        conn = vlc_h1_conn_create(mgr->obj, tls, false);
+
+    if (unlikely(conn == NULL))
+    {
+        vlc_tls_Close(tls);
+        return NULL;
+    }
+
+    struct vlc_http_stream *stream = vlc_http_stream_open(conn, req);
+
+    /* An HTTP/1.x connection carries one stream at a time: it is not kept,
+     * and is closed along with its only stream. */
+    if (http2 && stream != NULL)
+        mgr->conn = conn;
+    else
+        vlc_http_conn_release(conn);
+
+    *multiplexed = http2;
+    return stream;
+}
+
 struct vlc_http_cookie_jar_t *vlc_http_mgr_get_jar(struct vlc_http_mgr *mgr)
 {
     return mgr->jar;
@@ -30,6 +30,7 @@
 
 struct vlc_http_mgr;
 struct vlc_http_msg;
+struct vlc_http_stream;
 struct vlc_http_cookie_jar_t;
 
 /**
@@ -51,6 +52,35 @@ struct vlc_http_msg *vlc_http_mgr_request(struct vlc_http_mgr *mgr, bool https,
                                           const char *host, unsigned port,
                                           const struct vlc_http_msg *req);
 
+/**
+ * Sends an HTTPS request on a multiplexed connection
+ *
+ * Sends an HTTPS request through the manager HTTP/2 connection, or
+ * establishes a new one. Unlike vlc_http_mgr_request(), this function
+ * returns as soon as the request is sent. The response header is read by the
+ * caller with vlc_http_msg_get_initial(). Thus only the request needs to be
+ * serialized with other calls on the same manager, while the responses are
+ * awaited concurrently.
+ *
+ * If the server does not support HTTP/2, the request is sent on a new
+ * HTTP/1.x connection which is not kept by the manager.
+ *
+ * This function must not be mixed with vlc_http_mgr_request() on a given
+ * manager.
+ *
+ * @param mgr HTTP connection manager
+ * @param host name of authoritative HTTP server to send the request to
+ * @param port TCP server port number, or 0 for the default port number
+ * @param req HTTP request header to send
+ * @param multiplexed whether the server supports HTTP/2 [OUT]
+ *
+ * @return The HTTP stream of the request, or NULL in case of failure.
+ */
+struct vlc_http_stream *vlc_https_mgr_open(struct vlc_http_mgr *mgr,
+                                           const char *host, unsigned port,
+                                           const struct vlc_http_msg *req,
+                                           bool *restrict multiplexed);
+
 struct vlc_http_cookie_jar_t *vlc_http_mgr_get_jar(struct vlc_http_mgr *);
 
 /**
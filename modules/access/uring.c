@@ -0,0 +1,535 @@
+/*****************************************************************************
+ * uring.c: asynchronous file input using Linux io_uring
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+
+#include <vlc_common.h>
+#include <vlc_access.h>
+#include <vlc_atomic.h>
+#include <vlc_block.h>
+#include <vlc_fs.h>
+#include <vlc_interrupt.h>
+#include <vlc_plugin.h>
+
+/* Reads are aligned on this boundary, so that they map onto whole pages and
+ * file system blocks. */
+#define URING_CHUNK (256 << 10)
+
+struct uring_slot
+{
+    block_t *block;
+    struct iovec iov;
+    int result;
+    bool done;
+};
+
+struct access_sys_t
+{
+    int fd;
+    int ring_fd;
+
+    /* Submission ring */
+    void *sq_ptr;
+    size_t sq_size;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    /* Completion ring */
+    void *cq_ptr;
+    size_t cq_size;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+
+    uint64_t offset; /**< current stream position */
+    uint64_t next; /**< file offset of the next read to queue */
+    unsigned first; /**< oldest read in flight */
+    unsigned pending; /**< number of reads in flight */
+    unsigned depth;
+    bool failed; /**< the ring is unusable, reads may still be in flight */
+
+    /* Also published as the uring-bytes and uring-rate variables */
+    uint64_t bytes;
+    mtime_t start;
+    struct uring_slot slots[];
+};
+
+static int uring_setup (unsigned entries, struct io_uring_params *p)
+{
+    return syscall (__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter (int fd, unsigned submit, unsigned wait)
+{
+    return syscall (__NR_io_uring_enter, fd, submit, wait,
+                    wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+}
+
+/**
+ * Hands the queued submissions over to the kernel.
+ */
+static int Submit (access_sys_t *sys)
+{
+    unsigned head = atomic_load_explicit ((atomic_uint *)sys->sq_head,
+                                          memory_order_acquire);
+    unsigned count = *sys->sq_tail - head;
+
+    while (count > 0)
+    {
+        int val = uring_enter (sys->ring_fd, count, 0);
+        if (val < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        count -= val;
+    }
+    return 0;
+}
+
+/**
+ * Collects the completed reads, in whatever order they finished.
+ */
+static void Reap (access_sys_t *sys)
+{
+    unsigned head = *sys->cq_head;
+    unsigned tail = atomic_load_explicit ((atomic_uint *)sys->cq_tail,
+                                          memory_order_acquire);
+
+    while (head != tail)
+    {
+        const struct io_uring_cqe *cqe = &sys->cqes[head & sys->cq_mask];
+        struct uring_slot *slot = &sys->slots[cqe->user_data];
+
+        slot->result = cqe->res;
+        slot->done = true;
+        head++;
+    }
+    atomic_store_explicit ((atomic_uint *)sys->cq_head, head,
+                           memory_order_release);
+}
+
+/**
+ * Keeps depth reads in flight ahead of the current position.
+ */
+static void Queue (stream_t *access)
+{
+    access_sys_t *sys = access->p_sys;
+    unsigned tail = *sys->sq_tail;
+
+    while (sys->pending < sys->depth)
+    {
+        unsigned idx = (sys->first + sys->pending) % sys->depth;
+        struct uring_slot *slot = &sys->slots[idx];
+        /* Realign on chunk boundaries after a seek */
+        size_t len = URING_CHUNK - (sys->next % URING_CHUNK);
+
+        slot->block = block_Alloc (len);
+        if (unlikely(slot->block == NULL))
+            break;
+        slot->iov.iov_base = slot->block->p_buffer;
+        slot->iov.iov_len = len;
+        slot->done = false;
+
+        struct io_uring_sqe *sqe = &sys->sqes[tail & sys->sq_mask];
+
+        memset (sqe, 0, sizeof (*sqe));
+        sqe->opcode = IORING_OP_READV;
+        sqe->fd = sys->fd;
+        sqe->addr = (uintptr_t)&slot->iov;
+        sqe->len = 1;
+        sqe->off = sys->next;
+        sqe->user_data = idx;
+        sys->sq_array[tail & sys->sq_mask] = tail & sys->sq_mask;
+        tail++;
+
+        sys->next += len;
+        sys->pending++;
+    }
+
+    atomic_store_explicit ((atomic_uint *)sys->sq_tail, tail,
+                           memory_order_release);
+    if (Submit (sys))
+        msg_Err (access, "cannot submit reads: %s", vlc_strerror_c(errno));
+}
+
+/**
+ * Waits for all reads in flight and discards their data.
+ * This is not interruptible, but local reads complete quickly.
+ * @return 0 on success, -1 if the ring failed (the access is then unusable)
+ */
+static int Drain (stream_t *access)
+{
+    access_sys_t *sys = access->p_sys;
+    int ret = 0;
+
+    if (sys->failed)
+        return -1;
+
+    Submit (sys);
+
+    for (unsigned i = 0; i < sys->pending; i++)
+    {
+        struct uring_slot *slot =
+            &sys->slots[(sys->first + i) % sys->depth];
+
+        while (!slot->done && ret == 0)
+        {
+            if (uring_enter (sys->ring_fd, 0, 1) < 0 && errno != EINTR)
+            {
+                msg_Err (access, "cannot wait for reads: %s",
+                         vlc_strerror_c(errno));
+                sys->failed = true;
+                ret = -1;
+            }
+            else
+                Reap (sys);
+        }
+
+        /* The kernel may still write into the buffers of unfinished reads:
+         * leak them rather than free them. */
+        if (slot->done)
+            block_Release (slot->block);
+        slot->block = NULL;
+    }
+
+    sys->first = 0;
+    sys->pending = 0;
+    sys->next = sys->offset;
+    return ret;
+}
+
+static void UpdateStats (stream_t *access)
+{
+    access_sys_t *sys = access->p_sys;
+    mtime_t now = mdate ();
+
+    if (sys->start == VLC_TS_INVALID)
+        sys->start = now;
+
+    var_SetInteger (access, "uring-bytes", sys->bytes);
+    if (now > sys->start)
+        var_SetInteger (access, "uring-rate",
+                        (double)sys->bytes * CLOCK_FREQ / (now - sys->start));
+}
+
+static block_t *Block (stream_t *access, bool *restrict eof)
+{
+    access_sys_t *sys = access->p_sys;
+
+    if (sys->failed)
+    {
+        *eof = true;
+        return NULL;
+    }
+
+    Queue (access);
+    if (sys->pending == 0)
+        return NULL;
+
+    struct uring_slot *slot = &sys->slots[sys->first];
+    struct pollfd ufd = { .fd = sys->ring_fd, .events = POLLIN };
+
+    for (;;)
+    {
+        Reap (sys);
+        if (slot->done)
+            break;
+        if (Submit (sys))
+            return NULL;
+        if (vlc_poll_i11e (&ufd, 1, -1) < 0)
+        {
+            if (errno != EINTR)
+                msg_Err (access, "poll error: %s", vlc_strerror_c (errno));
+            return NULL; /* interrupted or failed */
+        }
+    }
+
+    block_t *block = slot->block;
+    int val = slot->result;
+
+    slot->block = NULL;
+    sys->first = (sys->first + 1) % sys->depth;
+    sys->pending--;
+
+    if (val <= 0)
+    {
+        block_Release (block);
+        if (val < 0)
+            msg_Err (access, "read error: %s", vlc_strerror_c(-val));
+        Drain (access); /* the file may grow: read again next time */
+        *eof = true;
+        return NULL;
+    }
+
+    block->i_buffer = val;
+    sys->offset += val;
+    sys->bytes += val;
+    UpdateStats (access);
+
+    /* After a short read, the queued reads do not follow on */
+    if ((size_t)val < slot->iov.iov_len)
+        Drain (access);
+    return block;
+}
+
+static int Seek (stream_t *access, uint64_t offset)
+{
+    access_sys_t *sys = access->p_sys;
+
+    if (offset == sys->offset)
+        return VLC_SUCCESS;
+
+    sys->offset = offset;
+    return Drain (access) ? VLC_EGENERIC : VLC_SUCCESS;
+}
+
+static int Control (stream_t *access, int query, va_list args)
+{
+    access_sys_t *sys = access->p_sys;
+
+    switch (query)
+    {
+        case STREAM_CAN_SEEK:
+        case STREAM_CAN_FASTSEEK:
+        case STREAM_CAN_PAUSE:
+        case STREAM_CAN_CONTROL_PACE:
+            *va_arg (args, bool *) = true;
+            break;
+
+        case STREAM_GET_SIZE:
+        {
+            struct stat st;
+
+            if (fstat (sys->fd, &st))
+                return VLC_EGENERIC;
+            *va_arg (args, uint64_t *) = st.st_size;
+            break;
+        }
+
+        case STREAM_GET_PTS_DELAY:
+            *va_arg (args, int64_t *) =
+                var_InheritInteger (access, "file-caching") * 1000;
+            break;
+
+        case STREAM_SET_PAUSE_STATE:
+            break;
+
+        default:
+            return VLC_EGENERIC;
+    }
+    return VLC_SUCCESS;
+}
+
+static int MapRings (access_sys_t *sys, const struct io_uring_params *p)
+{
+    sys->sq_size = p->sq_off.array + p->sq_entries * sizeof (unsigned);
+    sys->cq_size = p->cq_off.cqes
+                 + p->cq_entries * sizeof (struct io_uring_cqe);
+    if (p->features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (sys->cq_size > sys->sq_size)
+            sys->sq_size = sys->cq_size;
+        sys->cq_size = 0;
+    }
+
+    sys->sq_ptr = mmap (NULL, sys->sq_size, PROT_READ|PROT_WRITE,
+                        MAP_SHARED|MAP_POPULATE, sys->ring_fd,
+                        IORING_OFF_SQ_RING);
+    if (sys->sq_ptr == MAP_FAILED)
+        return -1;
+
+    if (sys->cq_size > 0)
+    {
+        sys->cq_ptr = mmap (NULL, sys->cq_size, PROT_READ|PROT_WRITE,
+                            MAP_SHARED|MAP_POPULATE, sys->ring_fd,
+                            IORING_OFF_CQ_RING);
+        if (sys->cq_ptr == MAP_FAILED)
+        {
+            munmap (sys->sq_ptr, sys->sq_size);
+            return -1;
+        }
+    }
+    else
+        sys->cq_ptr = sys->sq_ptr;
+
+    sys->sqes_size = p->sq_entries * sizeof (struct io_uring_sqe);
+    sys->sqes = mmap (NULL, sys->sqes_size, PROT_READ|PROT_WRITE,
+                      MAP_SHARED|MAP_POPULATE, sys->ring_fd,
+                      IORING_OFF_SQES);
+    if (sys->sqes == MAP_FAILED)
+    {
+        if (sys->cq_size > 0)
+            munmap (sys->cq_ptr, sys->cq_size);
+        munmap (sys->sq_ptr, sys->sq_size);
+        return -1;
+    }
+
+    unsigned char *sq = sys->sq_ptr, *cq = sys->cq_ptr;
+
+    sys->sq_head = (unsigned *)(sq + p->sq_off.head);
+    sys->sq_tail = (unsigned *)(sq + p->sq_off.tail);
+    sys->sq_mask = *(unsigned *)(sq + p->sq_off.ring_mask);
+    sys->sq_array = (unsigned *)(sq + p->sq_off.array);
+    sys->cq_head = (unsigned *)(cq + p->cq_off.head);
+    sys->cq_tail = (unsigned *)(cq + p->cq_off.tail);
+    sys->cq_mask = *(unsigned *)(cq + p->cq_off.ring_mask);
+    sys->cqes = (struct io_uring_cqe *)(cq + p->cq_off.cqes);
+    return 0;
+}
+
+static void UnmapRings (access_sys_t *sys)
+{
+    munmap (sys->sqes, sys->sqes_size);
+    if (sys->cq_size > 0)
+        munmap (sys->cq_ptr, sys->cq_size);
+    munmap (sys->sq_ptr, sys->sq_size);
+}
+
+static int Open (vlc_object_t *obj)
+{
+    stream_t *access = (stream_t *)obj;
+    unsigned depth = var_InheritInteger (obj, "uring-depth");
+
+    if (depth == 0 || access->psz_filepath == NULL)
+        return VLC_EGENERIC;
+
+    int fd = vlc_open (access->psz_filepath, O_RDONLY);
+    if (fd == -1)
+        return VLC_EGENERIC; /* let the file system module report it */
+
+    /* Leave directories, pipes and devices to the file system module */
+    struct stat st;
+    if (fstat (fd, &st) || !S_ISREG (st.st_mode))
+        goto error;
+
+    access_sys_t *sys = malloc (sizeof (*sys) + depth * sizeof (sys->slots[0]));
+    if (unlikely(sys == NULL))
+        goto error;
+
+    struct io_uring_params params;
+
+    memset (&params, 0, sizeof (params));
+    sys->ring_fd = uring_setup (depth, &params);
+    if (sys->ring_fd == -1)
+    {
+        msg_Dbg (access, "io_uring not available: %s",
+                 vlc_strerror_c(errno));
+        free (sys);
+        goto error;
+    }
+    fcntl (sys->ring_fd, F_SETFD, FD_CLOEXEC);
+
+    if (MapRings (sys, &params))
+    {
+        msg_Err (access, "cannot map io_uring: %s", vlc_strerror_c(errno));
+        vlc_close (sys->ring_fd);
+        free (sys);
+        goto error;
+    }
+
+    sys->fd = fd;
+    sys->offset = 0;
+    sys->next = 0;
+    sys->first = 0;
+    sys->pending = 0;
+    sys->depth = depth;
+    sys->failed = false;
+    sys->bytes = 0;
+    sys->start = VLC_TS_INVALID;
+
+    /* We do our own read-ahead */
+    posix_fadvise (fd, 0, 0, POSIX_FADV_RANDOM);
+
+    var_Create (access, "uring-bytes", VLC_VAR_INTEGER);
+    var_Create (access, "uring-rate", VLC_VAR_INTEGER);
+
+    access->pf_read = NULL;
+    access->pf_block = Block;
+    access->pf_seek = Seek;
+    access->pf_control = Control;
+    access->p_sys = sys;
+    msg_Dbg (access, "using io_uring with %u reads of %u KiB in flight",
+             depth, URING_CHUNK >> 10);
+    return VLC_SUCCESS;
+
+error:
+    vlc_close (fd);
+    return VLC_EGENERIC;
+}
+
+static void Close (vlc_object_t *obj)
+{
+    stream_t *access = (stream_t *)obj;
+    access_sys_t *sys = access->p_sys;
+
+    Drain (access);
+    var_Destroy (access, "uring-rate");
+    var_Destroy (access, "uring-bytes");
+
+    if (sys->start != VLC_TS_INVALID)
+    {
+        mtime_t elapsed = mdate () - sys->start;
+
+        msg_Dbg (access, "read %"PRIu64" bytes at %.1f MiB/s", sys->bytes,
+                 elapsed > 0 ? (double)sys->bytes * CLOCK_FREQ
+                               / (elapsed * 1048576.) : 0.);
+    }
+
+    UnmapRings (sys);
+    vlc_close (sys->ring_fd);
+    vlc_close (sys->fd);
+    free (sys);
+}
+
+vlc_module_begin ()
+    set_shortname (N_("io_uring"))
+    set_description (N_("Asynchronous file input"))
+    set_category (CAT_INPUT)
+    set_subcategory (SUBCAT_INPUT_ACCESS)
+    set_capability ("access", 60)
+    add_shortcut ("file")
+    set_callbacks (Open, Close)
+
+    add_integer_with_range ("uring-depth", 0, 0, 64,
+        N_("Reads in flight"),
+        N_("Number of reads of 256 KiB kept in flight ahead of the current "
+           "position with io_uring. Zero disables io_uring and uses the "
+           "regular file input."), true)
+vlc_module_end ()
@@ -25,6 +25,7 @@
 
 #include "PlaylistManager.h"
 #include "SegmentTracker.hpp"
+#include "Telemetry.hpp"
 #include "playlist/AbstractPlaylist.hpp"
 #include "playlist/BasePeriod.h"
 #include "playlist/BaseAdaptationSet.h"
@@ -56,6 +57,7 @@ PlaylistManager::PlaylistManager( demux_t *p_demux_,
              logic          ( NULL ),
              playlist       ( pl ),
              streamFactory  ( factory ),
+             telemetry      ( NULL ),
              p_demux        ( p_demux_ )
 {
     currentPeriod = playlist->getFirstPeriod();
@@ -82,6 +84,7 @@ PlaylistManager::~PlaylistManager   ()
     unsetPeriod();
     delete playlist;
     delete conManager;
+    delete telemetry;
     delete logic;
     vlc_cond_destroy(&waitcond);
     vlc_mutex_destroy(&lock);
@@ -116,6 +119,8 @@ bool PlaylistManager::setupPeriod()
             SegmentTracker *tracker = new (std::nothrow) SegmentTracker(logic, set);
             if(!tracker)
                 continue;
+            if(telemetry)
+                tracker->registerListener(telemetry);
 
             AbstractStream *st = streamFactory->create(p_demux, set->getStreamFormat(),
                                                        tracker, conManager);
@@ -153,6 +158,11 @@ bool PlaylistManager::start()
     if(!conManager && !(conManager = new (std::nothrow) HTTPConnectionManager(VLC_OBJECT(p_demux->s))))
         return false;
 
+    conManager->setSegmentCacheEnabled(!playlist->isLive());
+
+    if(!telemetry && (telemetry = new (std::nothrow) Telemetry(VLC_OBJECT(p_demux))))
+        conManager->setTelemetry(telemetry);
+
     if(!setupPeriod())
         return false;
 
@@ -468,6 +478,9 @@ int PlaylistManager::doDemux(int64_t increment)
         break;
     case AbstractStream::status_buffering:
         vlc_mutex_lock(&demux.lock);
+        /* playback started, and is now waiting for data */
+        if(telemetry && demux.i_nzpcr != VLC_TS_INVALID)
+            telemetry->playbackStalled(true);
         vlc_cond_timedwait(&demux.cond, &demux.lock, mdate() + CLOCK_FREQ / 20);
         vlc_mutex_unlock(&demux.lock);
         break;
@@ -479,6 +492,8 @@ int PlaylistManager::doDemux(int64_t increment)
         vlc_mutex_unlock(&demux.lock);
         break;
     case AbstractStream::status_demuxed:
+        if(telemetry)
+            telemetry->playbackStalled(false);
         vlc_mutex_lock(&demux.lock);
         if( demux.i_nzpcr != VLC_TS_INVALID && i_nzbarrier != demux.i_nzpcr )
         {
@@ -39,6 +39,8 @@ namespace adaptive
         class AbstractConnectionManager;
     }
 
+    class Telemetry;
+
     using namespace playlist;
     using namespace logic;
     using namespace http;
@@ -96,6 +98,7 @@ namespace adaptive
             AbstractAdaptationLogic             *logic;
             AbstractPlaylist                    *playlist;
             AbstractStreamFactory               *streamFactory;
+            Telemetry                           *telemetry;
             demux_t                             *p_demux;
             std::vector<AbstractStream *>        streams;
             BasePeriod                          *currentPeriod;
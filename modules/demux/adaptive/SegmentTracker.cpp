@@ -30,6 +30,8 @@
 #include "playlist/SegmentChunk.hpp"
 #include "logic/AbstractAdaptationLogic.h"
 
+#include <algorithm>
+
 using namespace adaptive;
 using namespace adaptive::logic;
 using namespace adaptive::playlist;
@@ -87,6 +89,8 @@ SegmentTracker::SegmentTracker(AbstractAdaptationLogic *logic_, BaseAdaptationSe
     setAdaptationLogic(logic_);
     adaptationSet = adaptSet;
     format = StreamFormat::UNSUPPORTED;
+    prefetchMaxChunks = 0;
+    prefetchMaxBytes = 0;
 }
 
 SegmentTracker::~SegmentTracker()
@@ -127,6 +131,7 @@ bool SegmentTracker::segmentsListReady() const
 
 void SegmentTracker::reset()
 {
+    discardPrefetched();
     notify(SegmentTrackerEvent(curRepresentation, NULL));
     curRepresentation = NULL;
     init_sent = false;
@@ -165,6 +170,8 @@ SegmentChunk * SegmentTracker::getNextChunk(bool switch_allowed,
 
     if(rep != curRepresentation)
     {
+        /* What was requested ahead is for the previous representation */
+        discardPrefetched();
         notify(SegmentTrackerEvent(curRepresentation, rep));
         prevRep = curRepresentation;
         curRepresentation = rep;
@@ -247,14 +254,18 @@ SegmentChunk * SegmentTracker::getNextChunk(bool switch_allowed,
         initializing = false;
     }
 
-    SegmentChunk *chunk = segment->toChunk(next, rep, connManager);
+    SegmentChunk *chunk = getPrefetchedChunk(next);
+    if(!chunk)
+        chunk = segment->toChunk(next, rep, connManager);
 
     /* Notify new segment length for stats / logic */
     if(chunk)
     {
-        const Timescale timescale = rep->inheritTimescale();
-        notify(SegmentTrackerEvent(rep->getAdaptationSet()->getID(),
-                                   timescale.ToTime(segment->duration.Get())));
+        /* templates' durations are in their own timescale */
+        mtime_t time, duration;
+        if(!rep->getPlaybackTimeDurationBySegmentNumber(next, &time, &duration))
+            duration = rep->inheritTimescale().ToTime(segment->duration.Get());
+        notify(SegmentTrackerEvent(rep->getAdaptationSet()->getID(), duration));
     }
 
     /* We need to check segment/chunk format changes, as we can't rely on representation's (HLS)*/
@@ -274,11 +285,103 @@ SegmentChunk * SegmentTracker::getNextChunk(bool switch_allowed,
     {
         curNumber = next;
         next++;
+        prefetch(rep, connManager);
     }
 
     return chunk;
 }
 
+/* Requests the next media chunks of the representation ahead of their
+ * consumption, so that their latency is hidden behind the current one. */
+void SegmentTracker::prefetch(BaseRepresentation *rep, AbstractConnectionManager *connManager)
+{
+    if(prefetched.size() >= prefetchMaxChunks)
+        return;
+
+    /* Don't go further than the playlist allows buffering, nor on live,
+       than what is already available */
+    mtime_t maxAhead = rep->getPlaylist()->getMaxBuffering();
+    if(rep->getPlaylist()->isLive())
+        maxAhead = std::min(maxAhead, rep->getMinAheadTime(curNumber));
+
+    mtime_t ahead = 0;
+    size_t bytes = 0;
+    uint64_t number = next;
+    mtime_t time, duration;
+
+    std::list<std::pair<uint64_t, SegmentChunk *> >::const_iterator it;
+    for(it = prefetched.begin(); it != prefetched.end(); ++it)
+    {
+        if(rep->getPlaybackTimeDurationBySegmentNumber((*it).first, &time, &duration))
+        {
+            ahead += duration;
+            bytes += rep->getBandwidth() * duration / CLOCK_FREQ / 8;
+        }
+        number = (*it).first + 1;
+    }
+
+    while(prefetched.size() < prefetchMaxChunks)
+    {
+        bool b_gap;
+        ISegment *segment = rep->getNextSegment(BaseRepresentation::INFOTYPE_MEDIA,
+                                                number, &number, &b_gap);
+        if(!segment ||
+           !rep->getPlaybackTimeDurationBySegmentNumber(number, &time, &duration))
+            break;
+
+        /* estimated from the bandwidth, as the size is usually unknown */
+        const size_t size = rep->getBandwidth() * duration / CLOCK_FREQ / 8;
+        if(ahead + duration > maxAhead || bytes + size > prefetchMaxBytes)
+            break;
+
+        SegmentChunk *chunk = segment->toChunk(number, rep, connManager);
+        if(!chunk)
+            break;
+        prefetched.push_back(std::make_pair(number, chunk));
+        ahead += duration;
+        bytes += size;
+        number++;
+    }
+}
+
+/* Returns the prefetched chunk for that segment, if any, dropping the ones
+ * which will no longer be read */
+SegmentChunk * SegmentTracker::getPrefetchedChunk(uint64_t number)
+{
+    while(!prefetched.empty())
+    {
+        std::pair<uint64_t, SegmentChunk *> front = prefetched.front();
+        if(front.first > number)
+            break;
+        prefetched.pop_front();
+        if(front.first == number)
+            return front.second;
+        delete front.second;
+    }
+    return NULL;
+}
+
+void SegmentTracker::discardPrefetched()
+{
+    /* cancels their downloads */
+    while(!prefetched.empty())
+    {
+        delete prefetched.front().second;
+        prefetched.pop_front();
+    }
+}
+
+void SegmentTracker::setPrefetchLimits(unsigned chunks, size_t bytes)
+{
+    prefetchMaxChunks = chunks;
+    prefetchMaxBytes = bytes;
+    while(prefetched.size() > prefetchMaxChunks)
+    {
+        delete prefetched.back().second;
+        prefetched.pop_back();
+    }
+}
+
 bool SegmentTracker::setPositionByTime(mtime_t time, bool restarted, bool tryonly)
 {
     uint64_t segnumber;
@@ -298,6 +401,7 @@ bool SegmentTracker::setPositionByTime(mtime_t time, bool restarted, bool tryonl
 
 void SegmentTracker::setPositionByNumber(uint64_t segnumber, bool restarted)
 {
+    discardPrefetched();
     if(restarted)
     {
         initializing = true;
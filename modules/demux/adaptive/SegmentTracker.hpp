@@ -24,6 +24,7 @@
 
 #include <vlc_common.h>
 #include <list>
+#include <utility>
 
 namespace adaptive
 {
@@ -127,10 +128,14 @@ namespace adaptive
             void notifyBufferingLevel(mtime_t, mtime_t, mtime_t) const;
             void registerListener(SegmentTrackerListenerInterface *);
             void updateSelected();
+            void setPrefetchLimits(unsigned, size_t);
 
         private:
             void setAdaptationLogic(AbstractAdaptationLogic *);
             void notify(const SegmentTrackerEvent &) const;
+            void prefetch(BaseRepresentation *, AbstractConnectionManager *);
+            SegmentChunk * getPrefetchedChunk(uint64_t);
+            void discardPrefetched();
             bool first;
             bool initializing;
             bool index_sent;
@@ -142,6 +147,10 @@ namespace adaptive
             BaseAdaptationSet *adaptationSet;
             BaseRepresentation *curRepresentation;
             std::list<SegmentTrackerListenerInterface *> listeners;
+            /* Media chunks of curRepresentation already requested, by segment number */
+            std::list<std::pair<uint64_t, SegmentChunk *> > prefetched;
+            unsigned prefetchMaxChunks;
+            size_t prefetchMaxBytes;
     };
 }
 
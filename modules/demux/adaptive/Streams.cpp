@@ -81,6 +81,9 @@ bool AbstractStream::init(const StreamFormat &format_, SegmentTracker *tracker,
                     format = format_;
                     segmentTracker = tracker;
                     segmentTracker->registerListener(this);
+                    segmentTracker->setPrefetchLimits(
+                        var_InheritInteger(p_realdemux, "adaptive-prefetch"),
+                        var_InheritInteger(p_realdemux, "adaptive-prefetch-size") * 1024);
                     segmentTracker->notifyBufferingState(true);
                     connManager = conn;
                     return true;
@@ -0,0 +1,400 @@
+/*
+ * Telemetry.cpp
+ *****************************************************************************
+ * Copyright (C) 2017 - VideoLAN and VLC authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "Telemetry.hpp"
+#include "playlist/BaseRepresentation.h"
+#include "playlist/BaseAdaptationSet.h"
+
+#include <vlc_fs.h>
+#include <vlc_variables.h>
+
+#include <cstring>
+#include <sstream>
+
+using namespace adaptive;
+using namespace adaptive::playlist;
+
+StreamTelemetry::StreamTelemetry()
+{
+    bandwidth = 0;
+    segments = 0;
+    bytes = 0;
+    cachedSegments = 0;
+    lastTTFB = 0;
+    lastTransfer = 0;
+    lastSize = 0;
+    bufferLevel = 0;
+    bufferTarget = 0;
+    switches = 0;
+}
+
+Telemetry::Sample::Sample(const char *event_, const std::string &stream_)
+{
+    time = mdate();
+    event = event_;
+    stream = stream_;
+    bandwidth = 0;
+    bytes = 0;
+    ttfb = 0;
+    transfer = 0;
+    buffer = 0;
+    duration = 0;
+}
+
+/* Variables mirroring each StreamTelemetry, in publishStats() order */
+static const struct
+{
+    const char *name;
+    int type;
+} streamVariables[] = {
+    { "representation",  VLC_VAR_STRING },
+    { "bandwidth",       VLC_VAR_INTEGER },
+    { "segments",        VLC_VAR_INTEGER },
+    { "bytes",           VLC_VAR_INTEGER },
+    { "cached-segments", VLC_VAR_INTEGER },
+    { "ttfb",            VLC_VAR_INTEGER },
+    { "transfer",        VLC_VAR_INTEGER },
+    { "size",            VLC_VAR_INTEGER },
+    { "buffer",          VLC_VAR_INTEGER },
+    { "buffer-target",   VLC_VAR_INTEGER },
+    { "switches",        VLC_VAR_INTEGER },
+};
+
+Telemetry::Telemetry(vlc_object_t *p_object_)
+{
+    p_object = p_object_;
+    log = NULL;
+    format = FORMAT_CSV;
+    stallStart = VLC_TS_INVALID;
+    stalls = 0;
+    stallDuration = 0;
+    vlc_mutex_init(&lock);
+
+    var_Create(p_object, "adaptive-telemetry", VLC_VAR_STRING);
+    var_Create(p_object, "adaptive-stalls", VLC_VAR_INTEGER);
+    var_Create(p_object, "adaptive-stall-duration", VLC_VAR_INTEGER);
+
+    char *psz_format = var_InheritString(p_object, "adaptive-telemetry-format");
+    if(psz_format && !strcmp(psz_format, "json"))
+        format = FORMAT_JSON;
+    free(psz_format);
+
+    char *psz_path = var_InheritString(p_object, "adaptive-telemetry-file");
+    if(psz_path && *psz_path)
+    {
+        log = vlc_fopen(psz_path, "a");
+        if(!log)
+            msg_Warn(p_object, "cannot open telemetry log %s", psz_path);
+        else if(format == FORMAT_CSV && ftell(log) == 0)
+            fputs("time,stream,event,representation,bandwidth,bytes,"
+                  "ttfb,transfer,buffer,duration,reason\n", log);
+    }
+    free(psz_path);
+}
+
+Telemetry::~Telemetry()
+{
+    if(log)
+        fclose(log);
+
+    std::map<ID, StreamTelemetry>::const_iterator it;
+    for(it = streams.begin(); it != streams.end(); ++it)
+    {
+        for(size_t i = 0; i < ARRAY_SIZE(streamVariables); i++)
+            var_Destroy(p_object, varName((*it).first, streamVariables[i].name).c_str());
+    }
+    var_Destroy(p_object, "adaptive-stall-duration");
+    var_Destroy(p_object, "adaptive-stalls");
+    var_Destroy(p_object, "adaptive-telemetry");
+    vlc_mutex_destroy(&lock);
+}
+
+std::string Telemetry::varName(const ID &id, const char *field) const
+{
+    return std::string("adaptive-") + id.str() + "-" + field;
+}
+
+/* Must be called with the lock held */
+StreamTelemetry & Telemetry::getStream(const ID &id)
+{
+    std::map<ID, StreamTelemetry>::iterator it = streams.find(id);
+    if(it != streams.end())
+        return (*it).second;
+
+    for(size_t i = 0; i < ARRAY_SIZE(streamVariables); i++)
+        var_Create(p_object, varName(id, streamVariables[i].name).c_str(),
+                   streamVariables[i].type);
+    return streams[id];
+}
+
+void Telemetry::trackerEvent(const SegmentTrackerEvent &event)
+{
+    vlc_mutex_lock(&lock);
+
+    switch(event.type)
+    {
+        case SegmentTrackerEvent::SWITCHING:
+        {
+            BaseRepresentation *prev = event.u.switching.prev;
+            BaseRepresentation *next = event.u.switching.next;
+            BaseRepresentation *rep = next ? next : prev;
+            if(!rep)
+                break;
+
+            const ID &id = rep->getAdaptationSet()->getID();
+            StreamTelemetry &stats = getStream(id);
+            Sample sample("switch", id.str());
+            if(next)
+            {
+                stats.representation = next->getID().str();
+                stats.bandwidth = next->getBandwidth();
+                sample.representation = stats.representation;
+                sample.bandwidth = stats.bandwidth;
+            }
+            if(!prev)
+                sample.reason = "start";
+            else if(!next)
+                sample.reason = "stop";
+            else if(next->getBandwidth() > prev->getBandwidth())
+                sample.reason = "up";
+            else
+                sample.reason = "down";
+            if(prev && next)
+                stats.switches++;
+            sample.buffer = stats.bufferLevel;
+            vlc_mutex_unlock(&lock);
+            publishStats(id);
+            publish(sample);
+            return;
+        }
+
+        case SegmentTrackerEvent::BUFFERING_LEVEL_CHANGE:
+        {
+            /* too frequent to be published on its own */
+            StreamTelemetry &stats = getStream(*event.u.buffering_level.id);
+            stats.bufferLevel = event.u.buffering_level.current;
+            stats.bufferTarget = event.u.buffering_level.target;
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    vlc_mutex_unlock(&lock);
+}
+
+/* Called from the downloader threads, once a segment was fully received */
+void Telemetry::segmentDownloaded(const ID &id, size_t size, mtime_t ttfb,
+                                  mtime_t transfer, bool cached)
+{
+    vlc_mutex_lock(&lock);
+
+    StreamTelemetry &stats = getStream(id);
+    stats.segments++;
+    stats.bytes += size;
+    if(cached)
+        stats.cachedSegments++;
+    stats.lastTTFB = ttfb;
+    stats.lastTransfer = transfer;
+    stats.lastSize = size;
+
+    Sample sample("segment", id.str());
+    sample.representation = stats.representation;
+    sample.bandwidth = stats.bandwidth;
+    sample.bytes = size;
+    sample.ttfb = ttfb;
+    sample.transfer = transfer;
+    sample.buffer = stats.bufferLevel;
+    if(cached)
+        sample.reason = "cache";
+    vlc_mutex_unlock(&lock);
+
+    publishStats(id);
+    publish(sample);
+}
+
+/* Playback is waiting for, or got back, data from the streams */
+void Telemetry::playbackStalled(bool b_stalled)
+{
+    Sample sample("stall", std::string());
+
+    vlc_mutex_lock(&lock);
+    if(b_stalled || stallStart == VLC_TS_INVALID)
+    {
+        if(b_stalled && stallStart == VLC_TS_INVALID)
+            stallStart = sample.time;
+        vlc_mutex_unlock(&lock);
+        return;
+    }
+    sample.duration = sample.time - stallStart;
+    stallStart = VLC_TS_INVALID;
+    stalls++;
+    stallDuration += sample.duration;
+    vlc_mutex_unlock(&lock);
+
+    publishStalls();
+    publish(sample);
+}
+
+bool Telemetry::getStreamStats(const ID &id, StreamTelemetry *p_stats) const
+{
+    vlc_mutex_locker locker(&lock);
+    std::map<ID, StreamTelemetry>::const_iterator it = streams.find(id);
+    if(it == streams.end())
+        return false;
+    *p_stats = (*it).second;
+    return true;
+}
+
+unsigned Telemetry::getStallCount() const
+{
+    vlc_mutex_locker locker(&lock);
+    return stalls;
+}
+
+mtime_t Telemetry::getStallDuration() const
+{
+    vlc_mutex_locker locker(&lock);
+    return stallDuration;
+}
+
+static std::string escapeJSON(const std::string &s)
+{
+    std::ostringstream out;
+    for(std::string::const_iterator it = s.begin(); it != s.end(); ++it)
+    {
+        const unsigned char c = *it;
+        if(c == '"' || c == '\\')
+            out << '\\' << c;
+        else if(c < 0x20)
+        {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out << buf;
+        }
+        else
+            out << c;
+    }
+    return out.str();
+}
+
+static std::string escapeCSV(const std::string &s)
+{
+    if(s.find_first_of(",\"\n") == std::string::npos)
+        return s;
+    std::string quoted = "\"";
+    for(std::string::const_iterator it = s.begin(); it != s.end(); ++it)
+    {
+        if(*it == '"')
+            quoted += '"';
+        quoted += *it;
+    }
+    return quoted + "\"";
+}
+
+std::string Telemetry::toJSON(const Sample &sample) const
+{
+    std::ostringstream json;
+    json << "{\"time\":" << sample.time
+         << ",\"stream\":\"" << escapeJSON(sample.stream) << "\""
+         << ",\"event\":\"" << sample.event << "\""
+         << ",\"representation\":\"" << escapeJSON(sample.representation) << "\""
+         << ",\"bandwidth\":" << sample.bandwidth
+         << ",\"bytes\":" << sample.bytes
+         << ",\"ttfb\":" << sample.ttfb
+         << ",\"transfer\":" << sample.transfer
+         << ",\"buffer\":" << sample.buffer
+         << ",\"duration\":" << sample.duration
+         << ",\"reason\":\"" << escapeJSON(sample.reason) << "\"}";
+    return json.str();
+}
+
+std::string Telemetry::toCSV(const Sample &sample) const
+{
+    std::ostringstream csv;
+    csv << sample.time << ","
+        << escapeCSV(sample.stream) << ","
+        << sample.event << ","
+        << escapeCSV(sample.representation) << ","
+        << sample.bandwidth << ","
+        << sample.bytes << ","
+        << sample.ttfb << ","
+        << sample.transfer << ","
+        << sample.buffer << ","
+        << sample.duration << ","
+        << escapeCSV(sample.reason);
+    return csv.str();
+}
+
+/* The stats variables are updated before the sample is published, and
+ * without the lock held, as variable callbacks may query the stats */
+void Telemetry::publishStats(const ID &id)
+{
+    StreamTelemetry stats;
+    if(!getStreamStats(id, &stats))
+        return;
+
+    const int64_t values[] = {
+        0, /* representation */
+        (int64_t) stats.bandwidth,
+        stats.segments,
+        (int64_t) stats.bytes,
+        stats.cachedSegments,
+        stats.lastTTFB,
+        stats.lastTransfer,
+        (int64_t) stats.lastSize,
+        stats.bufferLevel,
+        stats.bufferTarget,
+        stats.switches,
+    };
+    static_assert(ARRAY_SIZE(values) == ARRAY_SIZE(streamVariables),
+                  "missing stream variable");
+
+    var_SetString(p_object, varName(id, streamVariables[0].name).c_str(),
+                  stats.representation.c_str());
+    for(size_t i = 1; i < ARRAY_SIZE(streamVariables); i++)
+        var_SetInteger(p_object, varName(id, streamVariables[i].name).c_str(),
+                       values[i]);
+}
+
+void Telemetry::publishStalls()
+{
+    var_SetInteger(p_object, "adaptive-stalls", getStallCount());
+    var_SetInteger(p_object, "adaptive-stall-duration", getStallDuration());
+}
+
+void Telemetry::publish(const Sample &sample)
+{
+    const std::string json = toJSON(sample);
+    var_SetString(p_object, "adaptive-telemetry", json.c_str());
+
+    if(log)
+    {
+        const std::string line = (format == FORMAT_JSON) ? json : toCSV(sample);
+        /* one call per line, which stdio serializes */
+        fprintf(log, "%s\n", line.c_str());
+        fflush(log);
+    }
+}
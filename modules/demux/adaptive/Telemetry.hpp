@@ -0,0 +1,115 @@
+/*
+ * Telemetry.hpp
+ *****************************************************************************
+ * Copyright (C) 2017 - VideoLAN and VLC authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef TELEMETRY_HPP
+#define TELEMETRY_HPP
+
+#include "SegmentTracker.hpp"
+#include "ID.hpp"
+
+#include <vlc_common.h>
+#include <cstdio>
+#include <map>
+#include <string>
+
+namespace adaptive
+{
+    /* What happened so far on a stream */
+    class StreamTelemetry
+    {
+        public:
+            StreamTelemetry();
+            std::string representation; /* currently selected */
+            uint64_t    bandwidth;      /* of the representation, in bps */
+            unsigned    segments;
+            uint64_t    bytes;
+            unsigned    cachedSegments;
+            mtime_t     lastTTFB;       /* request sent to first byte received */
+            mtime_t     lastTransfer;   /* first to last byte received */
+            size_t      lastSize;
+            mtime_t     bufferLevel;
+            mtime_t     bufferTarget;
+            unsigned    switches;
+    };
+
+    /* Collects throughput, latency, buffering and switching data about the
+     * streams. The totals are mirrored as variables of the demuxer:
+     * "adaptive-stalls", "adaptive-stall-duration", and for each stream
+     * "adaptive-<stream id>-<StreamTelemetry field>" (e.g. -ttfb, -bytes).
+     * Each sample is then published as a JSON object through the
+     * "adaptive-telemetry" string variable, and optionally logged as CSV or
+     * JSON lines for offline analysis. */
+    class Telemetry : public SegmentTrackerListenerInterface
+    {
+        public:
+            Telemetry(vlc_object_t *);
+            virtual ~Telemetry();
+
+            virtual void trackerEvent(const SegmentTrackerEvent &); /* impl */
+            void segmentDownloaded(const ID &, size_t, mtime_t, mtime_t, bool);
+            void playbackStalled(bool);
+
+            bool getStreamStats(const ID &, StreamTelemetry *) const;
+            unsigned getStallCount() const;
+            mtime_t getStallDuration() const;
+
+        private:
+            enum Format
+            {
+                FORMAT_CSV,
+                FORMAT_JSON,
+            };
+
+            class Sample
+            {
+                public:
+                    Sample(const char *, const std::string &);
+                    mtime_t     time;
+                    const char *event;
+                    std::string stream;
+                    std::string representation;
+                    uint64_t    bandwidth;
+                    size_t      bytes;
+                    mtime_t     ttfb;
+                    mtime_t     transfer;
+                    mtime_t     buffer;
+                    mtime_t     duration;
+                    std::string reason;
+            };
+
+            StreamTelemetry & getStream(const ID &);
+            std::string varName(const ID &, const char *) const;
+            void publishStats(const ID &);
+            void publishStalls();
+            void publish(const Sample &);
+            std::string toJSON(const Sample &) const;
+            std::string toCSV(const Sample &) const;
+
+            vlc_object_t *p_object;
+            FILE         *log;
+            Format        format;
+            std::map<ID, StreamTelemetry> streams;
+            mtime_t       stallStart;
+            unsigned      stalls;
+            mtime_t       stallDuration;
+            mutable vlc_mutex_t lock;
+    };
+}
+
+#endif // TELEMETRY_HPP
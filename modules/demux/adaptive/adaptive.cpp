@@ -74,6 +74,40 @@ static void Close   (vlc_object_t *);
 #define ADAPT_ACCESS_TEXT N_("Use regular HTTP modules")
 #define ADAPT_ACCESS_LONGTEXT N_("Connect using http access instead of custom http code")
 
+#define ADAPT_MULTIPLEX_TEXT N_("Share connections between segments")
+#define ADAPT_MULTIPLEX_LONGTEXT N_("Send the concurrent requests to a server over a " \
+                                    "single connection, using HTTP/2 when available")
+
+#define ADAPT_DOWNLOADERS_TEXT N_("Parallel downloads")
+#define ADAPT_DOWNLOADERS_LONGTEXT N_("Number of segments downloaded at the same time, " \
+                                      "such as the audio and video ones")
+
+#define ADAPT_HOSTCONN_TEXT N_("Maximum connections per server")
+#define ADAPT_HOSTCONN_LONGTEXT N_("Maximum number of segments downloaded at the same " \
+                                   "time from a single server (0 for no limit)")
+
+#define ADAPT_PREFETCH_TEXT N_("Segments requested ahead")
+#define ADAPT_PREFETCH_LONGTEXT N_("Number of segments requested before they are needed, " \
+                                   "to hide the request latency (0 to disable)")
+
+#define ADAPT_PREFETCHSIZE_TEXT N_("Maximum size requested ahead (KiB)")
+#define ADAPT_PREFETCHSIZE_LONGTEXT N_("Estimated size of the segments requested ahead " \
+                                       "not to exceed, per stream")
+
+#define ADAPT_CACHE_TEXT N_("Segments cache size (MiB)")
+#define ADAPT_CACHE_LONGTEXT N_("Keep the segments of non-live streams on disk, up to " \
+                                "that size, so that seeking back or playing them again " \
+                                "does not download them again (0 to disable)")
+
+#define ADAPT_TELEMETRY_TEXT N_("Telemetry log file")
+#define ADAPT_TELEMETRY_LONGTEXT N_("Append the throughput, latency, buffering, switching " \
+                                    "and stall samples of the streams to that file")
+
+#define ADAPT_TELEMETRYFMT_TEXT N_("Telemetry log format")
+
+static const char *const ppsz_telemetry_formats[] = { "csv", "json" };
+static const char *const ppsz_telemetry_formats_text[] = { N_("CSV"), N_("JSON lines") };
+
 static const AbstractAdaptationLogic::LogicType pi_logics[] = {
                                 AbstractAdaptationLogic::Default,
                                 AbstractAdaptationLogic::Predictive,
@@ -120,6 +154,22 @@ vlc_module_begin ()
                      ADAPT_HEIGHT_TEXT, ADAPT_HEIGHT_TEXT, false )
         add_integer( "adaptive-bw",     250, ADAPT_BW_TEXT,     ADAPT_BW_LONGTEXT,     false )
         add_bool   ( "adaptive-use-access", false, ADAPT_ACCESS_TEXT, ADAPT_ACCESS_LONGTEXT, true );
+        add_bool   ( "adaptive-multiplex", true, ADAPT_MULTIPLEX_TEXT, ADAPT_MULTIPLEX_LONGTEXT, true )
+        add_integer_with_range( "adaptive-downloaders", 4, 1, 16,
+                     ADAPT_DOWNLOADERS_TEXT, ADAPT_DOWNLOADERS_LONGTEXT, true )
+        add_integer( "adaptive-host-connections", 3,
+                     ADAPT_HOSTCONN_TEXT, ADAPT_HOSTCONN_LONGTEXT, true )
+        add_integer_with_range( "adaptive-prefetch", 2, 0, 16,
+                     ADAPT_PREFETCH_TEXT, ADAPT_PREFETCH_LONGTEXT, true )
+        add_integer( "adaptive-prefetch-size", 16384,
+                     ADAPT_PREFETCHSIZE_TEXT, ADAPT_PREFETCHSIZE_LONGTEXT, true )
+        add_integer( "adaptive-cache-size", 0,
+                     ADAPT_CACHE_TEXT, ADAPT_CACHE_LONGTEXT, true )
+        add_savefile( "adaptive-telemetry-file", NULL,
+                      ADAPT_TELEMETRY_TEXT, ADAPT_TELEMETRY_LONGTEXT, true )
+        add_string( "adaptive-telemetry-format", "csv",
+                    ADAPT_TELEMETRYFMT_TEXT, NULL, true )
+            change_string_list( ppsz_telemetry_formats, ppsz_telemetry_formats_text )
         set_callbacks( Open, Close )
 vlc_module_end ()
 
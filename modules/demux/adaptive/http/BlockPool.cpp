@@ -0,0 +1,214 @@
+/*
+ * BlockPool.cpp
+ *****************************************************************************
+ * Copyright (C) 2017 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "BlockPool.hpp"
+
+#include <vlc_block.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace adaptive::http;
+
+namespace
+{
+    struct PooledBlock
+    {
+        block_t self;
+        BlockPool *pool;
+    };
+
+    /* A block shared by the slices of it */
+    struct SharedBlock
+    {
+        block_t *block;
+        std::atomic<unsigned> refs;
+    };
+
+    /* A range of a shared block, which it keeps alive */
+    struct SliceBlock
+    {
+        block_t self;
+        SharedBlock *shared;
+    };
+
+    /* keeps the payload aligned */
+    const size_t pooledHeaderSize = (sizeof(PooledBlock) + 15) & ~(size_t)15;
+}
+
+BlockPool::BlockPool(size_t blocksize, unsigned maxidle)
+{
+    vlc_mutex_init(&lock);
+    refs = 1;
+    idle = NULL;
+    idleCount = 0;
+    maxIdle = maxidle;
+    blockSize = blocksize;
+}
+
+BlockPool::~BlockPool()
+{
+    while(idle)
+    {
+        block_t *next = idle->p_next;
+        free(idle);
+        idle = next;
+    }
+    vlc_mutex_destroy(&lock);
+}
+
+size_t BlockPool::getBlockSize() const
+{
+    return blockSize;
+}
+
+block_t * BlockPool::get()
+{
+    vlc_mutex_lock(&lock);
+    block_t *p_block = idle;
+    if(p_block)
+    {
+        idle = p_block->p_next;
+        idleCount--;
+    }
+    refs++;
+    vlc_mutex_unlock(&lock);
+
+    if(!p_block)
+    {
+        PooledBlock *pb = (PooledBlock *) malloc(pooledHeaderSize + blockSize);
+        if(unlikely(!pb))
+        {
+            vlc_mutex_lock(&lock);
+            refs--; /* the owner still holds its own */
+            vlc_mutex_unlock(&lock);
+            return NULL;
+        }
+        pb->pool = this;
+        p_block = &pb->self;
+    }
+
+    block_Init(p_block, reinterpret_cast<uint8_t *>(p_block) + pooledHeaderSize, blockSize);
+    p_block->pf_release = recycle;
+    return p_block;
+}
+
+void BlockPool::drop()
+{
+    vlc_mutex_lock(&lock);
+    /* nobody will ask for blocks anymore */
+    maxIdle = 0;
+    bool b_last = (--refs == 0);
+    vlc_mutex_unlock(&lock);
+
+    if(b_last)
+        delete this;
+}
+
+void BlockPool::recycle(block_t *p_block)
+{
+    BlockPool *pool = reinterpret_cast<PooledBlock *>(p_block)->pool;
+
+    vlc_mutex_lock(&pool->lock);
+    if(pool->idleCount < pool->maxIdle)
+    {
+        p_block->p_next = pool->idle;
+        pool->idle = p_block;
+        pool->idleCount++;
+        p_block = NULL;
+    }
+    bool b_last = (--pool->refs == 0);
+    vlc_mutex_unlock(&pool->lock);
+
+    free(p_block);
+    if(b_last)
+        delete pool;
+}
+
+block_t * BlockPool::newSlice(void *opaque, uint8_t *p_buffer, size_t size)
+{
+    SliceBlock *sb = (SliceBlock *) malloc(sizeof(*sb));
+    if(unlikely(!sb))
+        return NULL;
+    block_Init(&sb->self, p_buffer, size);
+    sb->self.pf_release = releaseSlice;
+    sb->shared = static_cast<SharedBlock *>(opaque);
+    return &sb->self;
+}
+
+/* Returns a block referencing the first bytes of the given one, which are
+ * then cut from it, without copying them. The first time a block is
+ * sliced, it is replaced by a slice covering it entirely. Each slice only
+ * spans its own bytes, so that none can be reallocated over another. */
+block_t * BlockPool::slice(block_t **pp_block, size_t size)
+{
+    block_t *p_block = *pp_block;
+
+    if(p_block->pf_release != releaseSlice)
+    {
+        SharedBlock *shared = new (std::nothrow) SharedBlock;
+        if(unlikely(!shared))
+            return NULL;
+        shared->block = p_block;
+        shared->refs = 1;
+
+        block_t *p_whole = newSlice(shared, p_block->p_buffer, p_block->i_buffer);
+        if(unlikely(!p_whole))
+        {
+            delete shared;
+            return NULL;
+        }
+        p_whole->p_next = p_block->p_next;
+        p_whole->i_flags = p_block->i_flags;
+        p_block->p_next = NULL;
+        *pp_block = p_block = p_whole;
+    }
+
+    SliceBlock *parent = reinterpret_cast<SliceBlock *>(p_block);
+    block_t *p_slice = newSlice(parent->shared, p_block->p_buffer, size);
+    if(unlikely(!p_slice))
+        return NULL;
+    p_slice->i_flags = p_block->i_flags;
+    parent->shared->refs++;
+
+    /* The rest no longer owns the sliced bytes: it must not grow back over
+     * them (e.g. block_Realloc() with a prebody) */
+    uint8_t *p_end = p_block->p_start + p_block->i_size;
+    p_block->p_buffer += size;
+    p_block->i_buffer -= size;
+    p_block->p_start = p_block->p_buffer;
+    p_block->i_size = p_end - p_block->p_start;
+    return p_slice;
+}
+
+void BlockPool::releaseSlice(block_t *p_block)
+{
+    SharedBlock *shared = reinterpret_cast<SliceBlock *>(p_block)->shared;
+    free(p_block);
+    if(--shared->refs == 0)
+    {
+        block_Release(shared->block);
+        delete shared;
+    }
+}
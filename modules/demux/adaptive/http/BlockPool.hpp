@@ -0,0 +1,58 @@
+/*
+ * BlockPool.hpp
+ *****************************************************************************
+ * Copyright (C) 2017 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef BLOCKPOOL_HPP
+#define BLOCKPOOL_HPP
+
+#include <vlc_common.h>
+
+namespace adaptive
+{
+    namespace http
+    {
+        /* Receive buffers of a fixed size, which go back to the pool once
+         * released by whoever consumed them (demuxer, packetizer...).
+         * Blocks can outlive the owner of the pool: it is only freed once
+         * both the owner dropped it and all its blocks were released. */
+        class BlockPool
+        {
+            public:
+                BlockPool(size_t, unsigned);
+                block_t *   get();
+                void        drop();
+                size_t      getBlockSize() const;
+
+                static block_t * slice(block_t **, size_t);
+
+            private:
+                ~BlockPool();
+                static void recycle(block_t *);
+                static block_t * newSlice(void *, uint8_t *, size_t);
+                static void releaseSlice(block_t *);
+                vlc_mutex_t lock;
+                unsigned    refs;
+                block_t    *idle;
+                unsigned    idleCount;
+                unsigned    maxIdle;
+                size_t      blockSize;
+        };
+    }
+}
+
+#endif // BLOCKPOOL_HPP
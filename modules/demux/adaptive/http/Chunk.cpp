@@ -29,6 +29,8 @@
 #include "HTTPConnection.hpp"
 #include "HTTPConnectionManager.h"
 #include "Downloader.hpp"
+#include "BlockPool.hpp"
+#include "SegmentCache.hpp"
 
 #include <vlc_common.h>
 #include <vlc_block.h>
@@ -133,7 +135,7 @@ HTTPChunkSource::HTTPChunkSource(const std::string& url, AbstractConnectionManag
 HTTPChunkSource::~HTTPChunkSource()
 {
     if(connection)
-        connection->setUsed(false);
+        connManager->recycleConnection(connection);
 }
 
 bool HTTPChunkSource::init(const std::string &url)
@@ -175,7 +177,9 @@ block_t * HTTPChunkSource::read(size_t readsize)
     if(contentLength && readsize > contentLength - consumed)
         readsize = contentLength - consumed;
 
-    block_t *p_block = block_Alloc(readsize);
+    BlockPool *pool = connManager->getBlockPool();
+    block_t *p_block = (pool && readsize <= pool->getBlockSize()) ? pool->get()
+                                                                  : block_Alloc(readsize);
     if(!p_block)
     {
         eof = true;
@@ -195,7 +199,7 @@ block_t * HTTPChunkSource::read(size_t readsize)
     {
         p_block->i_buffer = (size_t) ret;
         consumed += p_block->i_buffer;
-        if((size_t)ret < readsize)
+        if(ret == 0 || (contentLength && consumed == contentLength))
             eof = true;
         connManager->updateDownloadRate(sourceid, p_block->i_buffer, time);
     }
@@ -241,6 +245,7 @@ block_t * HTTPChunkSource::readBlock()
 HTTPChunkBufferedSource::HTTPChunkBufferedSource(const std::string& url, AbstractConnectionManager *manager,
                                                  const adaptive::ID &sourceid) :
     HTTPChunkSource(url, manager, sourceid),
+    cacheWriter(NULL),
     p_head     (NULL),
     pp_tail    (&p_head),
     buffered     (0)
@@ -251,6 +256,7 @@ HTTPChunkBufferedSource::HTTPChunkBufferedSource(const std::string& url, Abstrac
     eof = false;
     held = false;
     downloadstart = 0;
+    responsetime = 0;
 }
 
 HTTPChunkBufferedSource::~HTTPChunkBufferedSource()
@@ -272,6 +278,9 @@ HTTPChunkBufferedSource::~HTTPChunkBufferedSource()
     buffered = 0;
     vlc_mutex_unlock(&lock);
 
+    /* discards the partial segment */
+    delete cacheWriter;
+
     vlc_cond_destroy(&avail);
     vlc_mutex_destroy(&lock);
 }
@@ -295,8 +304,37 @@ void HTTPChunkBufferedSource::release()
     vlc_cond_signal(&avail);
 }
 
+/* Serves the whole segment from the cache, if there, or prepares to
+ * store it there once downloaded. Called by the downloader only. */
+bool HTTPChunkBufferedSource::readCached()
+{
+    SegmentCache *cache = connManager->getSegmentCache();
+    if(!cache)
+        return false;
+
+    block_t *p_block = cache->get(params.getUrl(), bytesRange);
+    if(!p_block)
+    {
+        cacheWriter = cache->createWriter(params.getUrl(), bytesRange);
+        return false;
+    }
+
+    vlc_mutex_locker locker(&lock);
+    prepared = true;
+    contentLength = p_block->i_buffer;
+    buffered += p_block->i_buffer;
+    block_ChainLastAppend(&pp_tail, p_block);
+    done = true;
+    vlc_cond_signal(&avail);
+    connManager->updateSegmentStats(sourceid, contentLength, 0, 0, true);
+    return true;
+}
+
 void HTTPChunkBufferedSource::bufferize(size_t readsize)
 {
+    if(!prepared && readCached())
+        return;
+
     vlc_mutex_lock(&lock);
     if(!prepare())
     {
@@ -315,7 +353,9 @@ void HTTPChunkBufferedSource::bufferize(size_t readsize)
 
     vlc_mutex_unlock(&lock);
 
-    block_t *p_block = block_Alloc(readsize);
+    BlockPool *pool = connManager->getBlockPool();
+    block_t *p_block = (pool && readsize <= pool->getBlockSize()) ? pool->get()
+                                                                  : block_Alloc(readsize);
     if(!p_block)
     {
         eof = true;
@@ -326,9 +366,17 @@ void HTTPChunkBufferedSource::bufferize(size_t readsize)
     {
         size_t size;
         mtime_t time;
-    } rate = {0,0};
+        mtime_t ttfb;
+        mtime_t transfer;
+    } rate = {0,0,0,0};
 
     ssize_t ret = connection->read(p_block->p_buffer, readsize);
+    if(cacheWriter && ret > 0 && !cacheWriter->write(p_block->p_buffer, ret))
+    {
+        delete cacheWriter;
+        cacheWriter = NULL;
+    }
+
     if(ret <= 0)
     {
         block_Release(p_block);
@@ -337,6 +385,8 @@ void HTTPChunkBufferedSource::bufferize(size_t readsize)
         done = true;
         rate.size = buffered + consumed;
         rate.time = mdate() - downloadstart;
+        rate.ttfb = responsetime - downloadstart;
+        rate.transfer = mdate() - responsetime;
         downloadstart = 0;
     }
     else
@@ -345,11 +395,15 @@ void HTTPChunkBufferedSource::bufferize(size_t readsize)
         vlc_mutex_locker locker( &lock );
         buffered += p_block->i_buffer;
         block_ChainLastAppend(&pp_tail, p_block);
-        if((size_t) ret < readsize)
+        /* Short reads are just what arrived so far (chunked transfers of
+           segments still being produced), the reader gets them right away */
+        if(contentLength && buffered + consumed >= contentLength)
         {
             done = true;
             rate.size = buffered + consumed;
             rate.time = mdate() - downloadstart;
+            rate.ttfb = responsetime - downloadstart;
+            rate.transfer = mdate() - responsetime;
             downloadstart = 0;
         }
     }
@@ -357,6 +411,25 @@ void HTTPChunkBufferedSource::bufferize(size_t readsize)
     if(rate.size)
     {
         connManager->updateDownloadRate(sourceid, rate.size, rate.time);
+        connManager->updateSegmentStats(sourceid, rate.size, rate.ttfb, rate.transfer, false);
+    }
+
+    if(cacheWriter && isDone())
+    {
+        /* only complete segments go to the cache: without a length to check
+           against, a connection closed early would look like the end */
+        if(contentLength && rate.size == contentLength)
+            cacheWriter->commit(contentLength);
+        delete cacheWriter;
+        cacheWriter = NULL;
+    }
+
+    if(isDone() && connection)
+    {
+        /* Only the downloader uses the connection: hand it back as soon as
+           the transfer is over, for the other segments from the same host */
+        connManager->recycleConnection(connection);
+        connection = NULL;
     }
 
     vlc_cond_signal(&avail);
@@ -367,7 +440,10 @@ bool HTTPChunkBufferedSource::prepare()
     if(!prepared)
     {
         downloadstart = mdate();
-        return HTTPChunkSource::prepare();
+        if(!HTTPChunkSource::prepare())
+            return false;
+        responsetime = mdate();
+        return true;
     }
     return true;
 }
@@ -419,8 +495,42 @@ block_t * HTTPChunkBufferedSource::read(size_t readsize)
     while(readsize > buffered && !done)
         vlc_cond_wait(&avail, &lock);
 
+    if(!readsize || !buffered)
+    {
+        eof = true;
+        return NULL;
+    }
+
     block_t *p_block = NULL;
-    if(!readsize || !buffered || !(p_block = block_Alloc(readsize)) )
+    if(readsize <= p_head->i_buffer)
+    {
+        /* Hand out the received data itself */
+        if(readsize == p_head->i_buffer)
+        {
+            p_block = p_head;
+            p_head = p_head->p_next;
+            p_block->p_next = NULL;
+        }
+        else
+        {
+            const bool b_tail = (p_head->p_next == NULL);
+            p_block = BlockPool::slice(&p_head, readsize);
+            if(b_tail)
+                pp_tail = &p_head->p_next;
+        }
+
+        if(p_block)
+        {
+            if(p_head == NULL)
+                pp_tail = &p_head;
+            buffered -= readsize;
+            consumed += readsize;
+            return p_block;
+        }
+    }
+
+    /* Spans several received blocks */
+    if(!(p_block = block_Alloc(readsize)))
     {
         eof = true;
         return NULL;
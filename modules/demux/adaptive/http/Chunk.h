@@ -40,6 +40,7 @@ namespace adaptive
     {
         class AbstractConnection;
         class AbstractConnectionManager;
+        class SegmentCacheWriter;
         class AbstractChunk;
 
         class AbstractChunkSource
@@ -101,10 +102,10 @@ namespace adaptive
                 bool                prepared;
                 bool                eof;
                 ID                  sourceid;
+                ConnectionParams    params;
 
             private:
                 bool init(const std::string &);
-                ConnectionParams    params;
         };
 
         class HTTPChunkBufferedSource : public HTTPChunkSource
@@ -127,12 +128,15 @@ namespace adaptive
                 bool               isDone() const;
 
             private:
+                bool               readCached();
+                SegmentCacheWriter *cacheWriter;
                 block_t            *p_head; /* read cache buffer */
                 block_t           **pp_tail;
                 size_t              buffered; /* read cache size */
                 bool                done;
                 bool                eof;
                 mtime_t             downloadstart;
+                mtime_t             responsetime;
                 mutable vlc_mutex_t lock;
                 vlc_cond_t          avail;
                 bool                held;
@@ -26,39 +26,47 @@
 #include <vlc_threads.h>
 #include <vlc_atomic.h>
 
+#include <algorithm>
+#include <sstream>
+
 using namespace adaptive::http;
 
-Downloader::Downloader()
+Downloader::Downloader(unsigned threads_, unsigned perhost)
 {
     vlc_mutex_init(&lock);
     vlc_cond_init(&waitcond);
+    vlc_cond_init(&updatedcond);
     killed = false;
-    thread_handle_valid = false;
+    maxThreads = threads_ ? threads_ : 1;
+    maxPerHost = perhost;
 }
 
 bool Downloader::start()
 {
-    if(!thread_handle_valid &&
-       vlc_clone(&thread_handle, downloaderThread,
-                 static_cast<void *>(this), VLC_THREAD_PRIORITY_INPUT))
+    while(threads.size() < maxThreads)
     {
-        return false;
+        vlc_thread_t thread_handle;
+        if(vlc_clone(&thread_handle, downloaderThread,
+                     static_cast<void *>(this), VLC_THREAD_PRIORITY_INPUT))
+            break;
+        threads.push_back(thread_handle);
     }
-    thread_handle_valid = true;
-    return true;
+    return !threads.empty();
 }
 
 Downloader::~Downloader()
 {
     vlc_mutex_lock( &lock );
     killed = true;
-    vlc_cond_signal(&waitcond);
+    vlc_cond_broadcast(&waitcond);
     vlc_mutex_unlock( &lock );
 
-    if(thread_handle_valid)
-        vlc_join(thread_handle, NULL);
+    std::vector<vlc_thread_t>::const_iterator it;
+    for(it = threads.begin(); it != threads.end(); ++it)
+        vlc_join(*it, NULL);
     vlc_mutex_destroy(&lock);
     vlc_cond_destroy(&waitcond);
+    vlc_cond_destroy(&updatedcond);
 }
 void Downloader::schedule(HTTPChunkBufferedSource *source)
 {
@@ -72,8 +80,10 @@ void Downloader::schedule(HTTPChunkBufferedSource *source)
 void Downloader::cancel(HTTPChunkBufferedSource *source)
 {
     vlc_mutex_lock(&lock);
-    source->release();
-    chunks.remove(source);
+    /* let the current read, if any, complete */
+    while(std::find(downloading.begin(), downloading.end(), source) != downloading.end())
+        vlc_cond_wait(&updatedcond, &lock);
+    finishSource(source);
     vlc_mutex_unlock(&lock);
 }
 
@@ -92,27 +102,89 @@ void Downloader::DownloadSource(HTTPChunkBufferedSource *source)
         source->bufferize(HTTPChunkSource::CHUNK_SIZE);
 }
 
+std::string Downloader::hostKey(const HTTPChunkBufferedSource *source)
+{
+    std::ostringstream key;
+    key << source->params.getScheme() << "://"
+        << source->params.getHostname() << ":" << source->params.getPort();
+    return key.str();
+}
+
+/* Oldest source no other thread is reading, and which either already has a
+ * connection or can open one without exceeding the limit for its host.
+ * Must be called with the lock held. */
+HTTPChunkBufferedSource * Downloader::nextSource()
+{
+    std::list<HTTPChunkBufferedSource *>::const_iterator it;
+    for(it = chunks.begin(); it != chunks.end(); ++it)
+    {
+        HTTPChunkBufferedSource *source = *it;
+        if(std::find(downloading.begin(), downloading.end(), source) != downloading.end())
+            continue;
+
+        if(std::find(started.begin(), started.end(), source) == started.end())
+        {
+            if(maxPerHost)
+            {
+                unsigned &count = hostConnections[hostKey(source)];
+                if(count >= maxPerHost)
+                    continue;
+                count++;
+            }
+            started.push_back(source);
+        }
+
+        downloading.push_back(source);
+        return source;
+    }
+    return NULL;
+}
+
+/* Must be called with the lock held */
+void Downloader::finishSource(HTTPChunkBufferedSource *source)
+{
+    chunks.remove(source);
+
+    std::list<HTTPChunkBufferedSource *>::iterator it =
+            std::find(started.begin(), started.end(), source);
+    if(it != started.end())
+    {
+        started.erase(it);
+        if(maxPerHost)
+        {
+            std::map<std::string, unsigned>::iterator host =
+                    hostConnections.find(hostKey(source));
+            if(host != hostConnections.end() && --(*host).second == 0)
+                hostConnections.erase(host);
+        }
+        /* a connection slot got free */
+        vlc_cond_broadcast(&waitcond);
+    }
+
+    source->release();
+}
+
 void Downloader::Run()
 {
     vlc_mutex_lock(&lock);
     while(1)
     {
-        while(chunks.empty() && !killed)
+        HTTPChunkBufferedSource *source = NULL;
+        while(!killed && !(source = nextSource()))
             vlc_cond_wait(&waitcond, &lock);
 
         if(killed)
             break;
 
-        if(!chunks.empty())
-        {
-            HTTPChunkBufferedSource *source = chunks.front();
-            DownloadSource(source);
-            if(source->isDone())
-            {
-                chunks.pop_front();
-                source->release();
-            }
-        }
+        /* other threads keep downloading the other sources meanwhile */
+        vlc_mutex_unlock(&lock);
+        DownloadSource(source);
+        vlc_mutex_lock(&lock);
+
+        downloading.remove(source);
+        if(source->isDone())
+            finishSource(source);
+        vlc_cond_broadcast(&updatedcond);
     }
     vlc_mutex_unlock(&lock);
 }
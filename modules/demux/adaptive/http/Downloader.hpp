@@ -24,6 +24,9 @@
 
 #include <vlc_common.h>
 #include <list>
+#include <map>
+#include <string>
+#include <vector>
 
 namespace adaptive
 {
@@ -34,7 +37,7 @@ namespace adaptive
         class Downloader
         {
             public:
-                Downloader();
+                Downloader(unsigned = 1, unsigned = 0);
                 ~Downloader();
                 bool start();
                 void schedule(HTTPChunkBufferedSource *);
@@ -44,12 +47,20 @@ namespace adaptive
                 static void * downloaderThread(void *);
                 void Run();
                 void DownloadSource(HTTPChunkBufferedSource *);
-                vlc_thread_t thread_handle;
+                HTTPChunkBufferedSource * nextSource();
+                void finishSource(HTTPChunkBufferedSource *);
+                static std::string hostKey(const HTTPChunkBufferedSource *);
+                std::vector<vlc_thread_t> threads;
                 vlc_mutex_t  lock;
                 vlc_cond_t   waitcond;
-                bool         thread_handle_valid;
+                vlc_cond_t   updatedcond;
                 bool         killed;
+                unsigned     maxThreads;
+                unsigned     maxPerHost; /* 0 for no limit */
                 std::list<HTTPChunkBufferedSource *> chunks;
+                std::list<HTTPChunkBufferedSource *> downloading; /* by a thread right now */
+                std::list<HTTPChunkBufferedSource *> started; /* holding a connection */
+                std::map<std::string, unsigned> hostConnections;
         };
 
     }
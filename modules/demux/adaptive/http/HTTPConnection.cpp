@@ -27,8 +27,18 @@
 #include "../adaptive/tools/Helper.h"
 
 #include <cstdio>
+#include <cstring>
 #include <sstream>
 #include <vlc_stream.h>
+#include <vlc_block.h>
+#include <vlc_url.h>
+
+extern "C"
+{
+    #include "../../../access/http/message.h"
+    #include "../../../access/http/resource.h"
+    #include "../../../access/http/connmgr.h"
+}
 
 using namespace adaptive::http;
 
@@ -195,7 +205,8 @@ ssize_t HTTPConnection::read(void *p_buffer, size_t len)
     if(ret >= 0)
         bytesRead += ret;
 
-    if(ret < 0 || (size_t)ret < len || /* set EOF */
+    /* chunked replies are returned as they arrive, and not only at EOF */
+    if(ret < 0 || (chunked ? chunked_eof : (size_t)ret < len) || /* set EOF */
        (contentLength == bytesRead && connectionClose))
     {
         socket->disconnect();
@@ -306,6 +317,11 @@ ssize_t HTTPConnection::readChunk(void *p_buffer, size_t len)
             ssize_t in = socket->read(p_object, &crlf, 2);
             if(in < 2 || memcmp(crlf, "\r\n", 2))
                 return (copied == 0) ? -1 : copied;
+
+            /* Don't wait for the next chunk, which the server might still be
+               producing (low latency live): hand out this one right away */
+            if(copied > 0)
+                break;
         }
     }
 
@@ -494,6 +510,168 @@ void StreamUrlConnection::setUsed( bool b )
        reset();
 }
 
+LibVLCHTTPConnection::LibVLCHTTPConnection(vlc_object_t *p_object_,
+                                           LibVLCHTTPConnectionFactory *factory_)
+    : AbstractConnection( p_object_ )
+{
+    factory = factory_;
+    manager = NULL;
+    response = NULL;
+    pending = NULL;
+    psz_useragent = var_InheritString(p_object_, "http-user-agent");
+}
+
+LibVLCHTTPConnection::~LibVLCHTTPConnection()
+{
+    reset();
+    if(manager)
+        vlc_http_mgr_destroy(manager);
+    free(psz_useragent);
+}
+
+void LibVLCHTTPConnection::reset()
+{
+    if(pending)
+        block_Release(pending);
+    pending = NULL;
+    /* also cancels the transfer if it is not over */
+    if(response)
+        vlc_http_msg_destroy(response);
+    response = NULL;
+    bytesRead = 0;
+    contentLength = 0;
+    bytesRange = BytesRange();
+}
+
+bool LibVLCHTTPConnection::canReuse(const ConnectionParams &params_) const
+{
+    return ( available &&
+             params.getHostname() == params_.getHostname() &&
+             params.getScheme() == params_.getScheme() &&
+             params.getPort() == params_.getPort() );
+}
+
+int LibVLCHTTPConnection::request(const std::string &path, const BytesRange &range)
+{
+    reset();
+
+    /* Set new path for this query */
+    params.setPath(path);
+
+    for(int i_redir = 0; ; i_redir++)
+    {
+        msg_Dbg(p_object, "Retrieving %s @%zu", params.getUrl().c_str(),
+                           range.isValid() ? range.getStartByte() : 0);
+
+        struct vlc_http_msg *resp = factory->open(p_object, params, range,
+                                                  psz_useragent, &manager);
+        if(!resp)
+            return VLC_EGENERIC;
+
+        int status = vlc_http_msg_get_status(resp);
+        if((status == 301 || status == 302 || status == 303 ||
+            status == 307 || status == 308) && i_redir < maxRedirects)
+        {
+            const char *location = vlc_http_msg_get_header(resp, "Location");
+            char *psz_url = location ? vlc_uri_resolve(params.getUrl().c_str(), location)
+                                     : NULL;
+            vlc_http_msg_destroy(resp);
+            if(!psz_url)
+                return VLC_EGENERIC;
+            msg_Info(p_object, "%d redirection to %s", status, psz_url);
+            /* possibly to another server, which has its own shared connection */
+            ConnectionParams redirected(psz_url);
+            free(psz_url);
+            if(manager && (redirected.getHostname() != params.getHostname() ||
+                           redirected.getScheme() != params.getScheme() ||
+                           redirected.getPort() != params.getPort()))
+            {
+                /* own connection is only valid for a single server */
+                vlc_http_mgr_destroy(manager);
+                manager = NULL;
+            }
+            params = redirected;
+            continue;
+        }
+
+        if(status != 200 && status != 206)
+        {
+            msg_Err(p_object, "Failed reading %s: %d", params.getUrl().c_str(), status);
+            vlc_http_msg_destroy(resp);
+            return VLC_ENOOBJ;
+        }
+
+        response = resp;
+        break;
+    }
+
+    bytesRange = range;
+    uintmax_t size = vlc_http_msg_get_size(response);
+    if(size != (uintmax_t) -1)
+        contentLength = size;
+    else if(range.isValid() && range.getEndByte() > 0)
+        contentLength = range.getEndByte() - range.getStartByte() + 1;
+
+    return VLC_SUCCESS;
+}
+
+ssize_t LibVLCHTTPConnection::read(void *p_buffer, size_t len)
+{
+    if(!response)
+        return VLC_EGENERIC;
+
+    if(len == 0)
+        return VLC_SUCCESS;
+
+    const size_t toRead = (contentLength) ? contentLength - bytesRead : len;
+    if (toRead == 0)
+        return VLC_SUCCESS;
+
+    if(len > toRead)
+        len = toRead;
+
+    size_t copied = 0;
+    while(copied < len)
+    {
+        if(!pending)
+        {
+            /* Return what already arrived instead of waiting for more */
+            if(copied > 0)
+                break;
+            block_t *p_block = vlc_http_msg_read(response);
+            if(p_block == vlc_http_error)
+                return (copied == 0) ? -1 : copied;
+            if(p_block == NULL) /* end of stream */
+                break;
+            pending = p_block;
+        }
+
+        size_t chunk = len - copied;
+        if(chunk > pending->i_buffer)
+            chunk = pending->i_buffer;
+        memcpy(&((uint8_t *)p_buffer)[copied], pending->p_buffer, chunk);
+        pending->p_buffer += chunk;
+        pending->i_buffer -= chunk;
+        copied += chunk;
+
+        if(pending->i_buffer == 0)
+        {
+            block_Release(pending);
+            pending = NULL;
+        }
+    }
+
+    bytesRead += copied;
+    return copied;
+}
+
+void LibVLCHTTPConnection::setUsed( bool b )
+{
+    available = !b;
+    if(available)
+        reset();
+}
+
 ConnectionFactory::ConnectionFactory()
 {
 }
@@ -531,3 +709,172 @@ AbstractConnection * StreamUrlConnectionFactory::createConnection(vlc_object_t *
 {
     return new (std::nothrow) StreamUrlConnection(p_object);
 }
+
+LibVLCHTTPConnectionFactory::LibVLCHTTPConnectionFactory()
+    : ConnectionFactory()
+{
+    vlc_mutex_init(&lock);
+}
+
+LibVLCHTTPConnectionFactory::~LibVLCHTTPConnectionFactory()
+{
+    std::map<std::string, Origin *>::const_iterator it;
+    for(it = origins.begin(); it != origins.end(); ++it)
+    {
+        vlc_http_mgr_destroy((*it).second->manager);
+        vlc_mutex_destroy(&(*it).second->lock);
+        delete (*it).second;
+    }
+    vlc_mutex_destroy(&lock);
+}
+
+AbstractConnection * LibVLCHTTPConnectionFactory::createConnection(vlc_object_t *p_object,
+                                                                   const ConnectionParams &params)
+{
+    if((params.getScheme() != "http" && params.getScheme() != "https") || params.getHostname().empty())
+        return NULL;
+
+    return new (std::nothrow) LibVLCHTTPConnection(p_object, this);
+}
+
+LibVLCHTTPConnectionFactory::Origin *
+LibVLCHTTPConnectionFactory::getOrigin(vlc_object_t *p_object, const ConnectionParams &params)
+{
+    std::ostringstream key;
+    key << params.getScheme() << "://" << params.getHostname() << ":" << params.getPort();
+
+    vlc_mutex_locker locker(&lock);
+
+    std::map<std::string, Origin *>::const_iterator it = origins.find(key.str());
+    if(it != origins.end())
+        return (*it).second;
+
+    Origin *origin = new (std::nothrow) Origin;
+    if(!origin)
+        return NULL;
+    origin->manager = vlc_http_mgr_create(p_object, NULL);
+    if(!origin->manager)
+    {
+        delete origin;
+        return NULL;
+    }
+    origin->multiplexed = (params.getScheme() == "https"); /* h2 requires TLS */
+    vlc_mutex_init(&origin->lock);
+    origins[key.str()] = origin;
+    return origin;
+}
+
+static int formatRequest(const struct vlc_http_resource *, struct vlc_http_msg *req,
+                         void *opaque)
+{
+    const BytesRange *range = static_cast<const BytesRange *>(opaque);
+    if(!range->isValid())
+        return 0;
+
+    if(range->getEndByte() > 0)
+        return vlc_http_msg_add_header(req, "Range", "bytes=%zu-%zu",
+                                       range->getStartByte(), range->getEndByte());
+    return vlc_http_msg_add_header(req, "Range", "bytes=%zu-", range->getStartByte());
+}
+
+static int validateResponse(const struct vlc_http_resource *, const struct vlc_http_msg *,
+                            void *)
+{
+    return 0; /* status is checked by the connection, which handles redirects */
+}
+
+static const struct vlc_http_resource_cbs resourceCallbacks =
+{
+    formatRequest,
+    validateResponse,
+};
+
+static struct vlc_http_msg * createRequest(const ConnectionParams &params,
+                                           const BytesRange &range,
+                                           const char *psz_useragent)
+{
+    std::ostringstream authority;
+    if(params.getHostname().find(':') != std::string::npos)
+        authority << "[" << params.getHostname() << "]";
+    else
+        authority << params.getHostname();
+    if(params.getPort() != 443)
+        authority << ":" << params.getPort();
+
+    struct vlc_http_msg *req = vlc_http_req_create("GET", "https",
+                                                   authority.str().c_str(),
+                                                   params.getPath().c_str());
+    if(!req)
+        return NULL;
+
+    vlc_http_msg_add_header(req, "Accept", "*/*");
+    if(psz_useragent)
+        vlc_http_msg_add_agent(req, psz_useragent);
+    if(formatRequest(NULL, req, const_cast<BytesRange *>(&range)))
+    {
+        vlc_http_msg_destroy(req);
+        return NULL;
+    }
+    return req;
+}
+
+/* Sends a GET request for the URL, and returns the response header */
+struct vlc_http_msg * LibVLCHTTPConnectionFactory::open(vlc_object_t *p_object,
+                                                        const ConnectionParams &params,
+                                                        const BytesRange &range,
+                                                        const char *psz_useragent,
+                                                        struct vlc_http_mgr **pp_manager)
+{
+    Origin *origin = getOrigin(p_object, params);
+    if(!origin)
+        return NULL;
+
+    vlc_mutex_lock(&origin->lock);
+    bool multiplexed = origin->multiplexed;
+    vlc_mutex_unlock(&origin->lock);
+
+    if(multiplexed)
+    {
+        struct vlc_http_msg *req = createRequest(params, range, psz_useragent);
+        if(!req)
+            return NULL;
+
+        /* The HTTP connection manager is not thread-safe: only sending the
+           requests is serialized, the responses are then received
+           concurrently */
+        vlc_mutex_lock(&origin->lock);
+        struct vlc_http_stream *stream =
+                vlc_https_mgr_open(origin->manager, params.getHostname().c_str(),
+                                   params.getPort(), req, &multiplexed);
+        if(!multiplexed)
+            origin->multiplexed = false;
+        vlc_mutex_unlock(&origin->lock);
+        vlc_http_msg_destroy(req);
+
+        if(!stream)
+            return NULL;
+        return vlc_http_msg_get_final(vlc_http_msg_get_initial(stream));
+    }
+
+    if(!*pp_manager)
+    {
+        *pp_manager = vlc_http_mgr_create(p_object, NULL);
+        if(!*pp_manager)
+            return NULL;
+    }
+
+    struct vlc_http_resource *res = (struct vlc_http_resource *) malloc(sizeof(*res));
+    if(!res)
+        return NULL;
+
+    if(vlc_http_res_init(res, &resourceCallbacks, *pp_manager,
+                         params.getUrl().c_str(), psz_useragent, NULL))
+    {
+        free(res);
+        return NULL;
+    }
+
+    struct vlc_http_msg *resp = vlc_http_res_open(res, const_cast<BytesRange *>(&range));
+    vlc_http_res_destroy(res);
+    return resp;
+}
@@ -28,8 +28,12 @@
 #include "ConnectionParams.hpp"
 #include "BytesRange.hpp"
 #include <vlc_common.h>
+#include <map>
 #include <string>
 
+struct vlc_http_mgr;
+struct vlc_http_msg;
+
 namespace adaptive
 {
     namespace http
@@ -46,6 +50,8 @@ namespace adaptive
                 virtual bool    canReuse     (const ConnectionParams &) const = 0;
 
                 virtual int     request     (const std::string& path, const BytesRange & = BytesRange()) = 0;
+                /* Can return less than asked before the end, as data arrives.
+                 * Returns 0 at the end of the reply */
                 virtual ssize_t read        (void *p_buffer, size_t len) = 0;
 
                 virtual size_t  getContentLength() const;
@@ -120,6 +126,31 @@ namespace adaptive
                 stream_t *p_streamurl;
        };
 
+       class LibVLCHTTPConnectionFactory;
+
+       class LibVLCHTTPConnection : public AbstractConnection
+       {
+            public:
+                LibVLCHTTPConnection(vlc_object_t *, LibVLCHTTPConnectionFactory *);
+                virtual ~LibVLCHTTPConnection();
+
+                virtual bool    canReuse     (const ConnectionParams &) const;
+
+                virtual int     request     (const std::string& path, const BytesRange & = BytesRange());
+                virtual ssize_t read        (void *p_buffer, size_t len);
+
+                virtual void    setUsed( bool );
+
+            protected:
+                void reset();
+                LibVLCHTTPConnectionFactory *factory;
+                struct vlc_http_mgr *manager; /* own, if not multiplexed */
+                struct vlc_http_msg *response;
+                block_t *pending; /* received but not read yet */
+                char *psz_useragent;
+                static const int maxRedirects = 5;
+       };
+
        class ConnectionFactory
        {
            public:
@@ -133,6 +164,33 @@ namespace adaptive
            public:
                virtual AbstractConnection * createConnection(vlc_object_t *, const ConnectionParams &);
        };
+
+       /* All the connections to a given server share a single HTTP connection
+          manager, hence a single HTTP/2 connection when the server supports
+          it: requests are multiplexed instead of each opening its own
+          TCP/TLS session. Otherwise each connection keeps its own manager,
+          as an HTTP/1.x connection serves only one request at a time. */
+       class LibVLCHTTPConnectionFactory : public ConnectionFactory
+       {
+           public:
+               LibVLCHTTPConnectionFactory();
+               virtual ~LibVLCHTTPConnectionFactory();
+               virtual AbstractConnection * createConnection(vlc_object_t *, const ConnectionParams &);
+               struct vlc_http_msg * open(vlc_object_t *, const ConnectionParams &,
+                                          const BytesRange &, const char *,
+                                          struct vlc_http_mgr **);
+
+           private:
+               struct Origin
+               {
+                   struct vlc_http_mgr *manager;
+                   bool multiplexed; /* until HTTP/2 is known unsupported */
+                   vlc_mutex_t lock;
+               };
+               Origin * getOrigin(vlc_object_t *, const ConnectionParams &);
+               vlc_mutex_t lock;
+               std::map<std::string, Origin *> origins;
+       };
     }
 }
 
@@ -30,7 +30,12 @@
 #include "ConnectionParams.hpp"
 #include "Sockets.hpp"
 #include "Downloader.hpp"
+#include "BlockPool.hpp"
+#include "SegmentCache.hpp"
+#include "../Telemetry.hpp"
 #include <vlc_url.h>
+#include <vlc_configuration.h>
+#include <vlc_fs.h>
 
 using namespace adaptive::http;
 
@@ -39,11 +44,36 @@ AbstractConnectionManager::AbstractConnectionManager(vlc_object_t *p_object_)
 {
     p_object = p_object_;
     rateObserver = NULL;
+    telemetry = NULL;
+    /* Enough receive buffers to hold about a second of high bitrate
+       streams, so that they are seldom allocated again */
+    blockPool = new (std::nothrow) BlockPool(HTTPChunkSource::CHUNK_SIZE, 256);
+    segmentCache = NULL;
+    b_cache_enabled = false;
 }
 
 AbstractConnectionManager::~AbstractConnectionManager()
 {
+    delete segmentCache;
+    /* freed once all its blocks are released */
+    if(blockPool)
+        blockPool->drop();
+}
 
+BlockPool * AbstractConnectionManager::getBlockPool() const
+{
+    return blockPool;
+}
+
+SegmentCache * AbstractConnectionManager::getSegmentCache() const
+{
+    return b_cache_enabled ? segmentCache : NULL;
+}
+
+/* Only segments which won't change (VOD) should go through the cache */
+void AbstractConnectionManager::setSegmentCacheEnabled(bool b)
+{
+    b_cache_enabled = b;
 }
 
 void AbstractConnectionManager::updateDownloadRate(const adaptive::ID &sourceid, size_t size, mtime_t time)
@@ -57,16 +87,48 @@ void AbstractConnectionManager::setDownloadRateObserver(IDownloadRateObserver *o
     rateObserver = obs;
 }
 
+void AbstractConnectionManager::setTelemetry(Telemetry *telemetry_)
+{
+    telemetry = telemetry_;
+}
+
+void AbstractConnectionManager::updateSegmentStats(const adaptive::ID &sourceid, size_t size,
+                                                   mtime_t ttfb, mtime_t transfer, bool cached)
+{
+    if(telemetry)
+        telemetry->segmentDownloaded(sourceid, size, ttfb, transfer, cached);
+}
+
 HTTPConnectionManager::HTTPConnectionManager    (vlc_object_t *p_object_, ConnectionFactory *factory_)
     : AbstractConnectionManager( p_object_ )
 {
     vlc_mutex_init(&lock);
-    downloader = new (std::nothrow) Downloader();
-    downloader->start();
+    /* Segments of the different streams are downloaded in parallel, but
+       without opening too many connections to the same server */
+    unsigned threads = var_InheritInteger(p_object, "adaptive-downloaders");
+    unsigned perhost = var_InheritInteger(p_object, "adaptive-host-connections");
+    downloader = new (std::nothrow) Downloader(threads, perhost);
+    if(downloader)
+        downloader->start();
+    uint64_t cachesize = var_InheritInteger(p_object, "adaptive-cache-size");
+    if(cachesize)
+    {
+        char *psz_dir = config_GetUserDir(VLC_CACHE_DIR);
+        if(psz_dir)
+        {
+            vlc_mkdir(psz_dir, 0700);
+            std::string dir(psz_dir);
+            free(psz_dir);
+            segmentCache = new (std::nothrow) SegmentCache(p_object, dir + DIR_SEP "adaptive",
+                                                           cachesize << 20);
+        }
+    }
     if(!factory_)
     {
         if(var_InheritBool(p_object, "adaptive-use-access"))
             factory = new (std::nothrow) StreamUrlConnectionFactory();
+        else if(var_InheritBool(p_object, "adaptive-multiplex"))
+            factory = new (std::nothrow) LibVLCHTTPConnectionFactory();
         else
             factory = new (std::nothrow) ConnectionFactory();
     }
@@ -76,8 +138,9 @@ HTTPConnectionManager::HTTPConnectionManager    (vlc_object_t *p_object_, Connec
 HTTPConnectionManager::~HTTPConnectionManager   ()
 {
     delete downloader;
-    delete factory;
+    /* connections may still refer to their factory */
     this->closeAllConnections();
+    delete factory;
     vlc_mutex_destroy(&lock);
 }
 
@@ -138,6 +201,15 @@ AbstractConnection * HTTPConnectionManager::getConnection(ConnectionParams &para
     return conn;
 }
 
+/* Gives back a connection once its transfer is over, so that it can be
+   reused for another request to the same server */
+void HTTPConnectionManager::recycleConnection(AbstractConnection *conn)
+{
+    vlc_mutex_lock(&lock);
+    conn->setUsed(false);
+    vlc_mutex_unlock(&lock);
+}
+
 void HTTPConnectionManager::start(AbstractChunkSource *source)
 {
     HTTPChunkBufferedSource *src = dynamic_cast<HTTPChunkBufferedSource *>(source);
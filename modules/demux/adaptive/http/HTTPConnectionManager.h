@@ -33,6 +33,8 @@
 
 namespace adaptive
 {
+    class Telemetry;
+
     namespace http
     {
         class ConnectionParams;
@@ -40,6 +42,8 @@ namespace adaptive
         class AbstractConnection;
         class Downloader;
         class AbstractChunkSource;
+        class BlockPool;
+        class SegmentCache;
 
         class AbstractConnectionManager : public IDownloadRateObserver
         {
@@ -48,17 +52,27 @@ namespace adaptive
                 ~AbstractConnectionManager();
                 virtual void    closeAllConnections () = 0;
                 virtual AbstractConnection * getConnection(ConnectionParams &) = 0;
+                virtual void recycleConnection(AbstractConnection *) = 0;
                 virtual void start(AbstractChunkSource *) = 0;
                 virtual void cancel(AbstractChunkSource *) = 0;
 
                 virtual void updateDownloadRate(const ID &, size_t, mtime_t); /* impl */
                 void setDownloadRateObserver(IDownloadRateObserver *);
+                BlockPool * getBlockPool() const;
+                SegmentCache * getSegmentCache() const;
+                void setSegmentCacheEnabled(bool);
+                void setTelemetry(Telemetry *);
+                void updateSegmentStats(const ID &, size_t, mtime_t, mtime_t, bool);
 
             protected:
                 vlc_object_t                                       *p_object;
+                BlockPool                                          *blockPool;
+                SegmentCache                                       *segmentCache;
+                bool                                                b_cache_enabled;
 
             private:
                 IDownloadRateObserver                              *rateObserver;
+                Telemetry                                          *telemetry;
         };
 
         class HTTPConnectionManager : public AbstractConnectionManager
@@ -69,6 +83,7 @@ namespace adaptive
 
                 virtual void    closeAllConnections () /* impl */;
                 virtual AbstractConnection * getConnection(ConnectionParams &) /* impl */;
+                virtual void recycleConnection(AbstractConnection *) /* impl */;
 
                 virtual void start(AbstractChunkSource *) /* impl */;
                 virtual void cancel(AbstractChunkSource *) /* impl */;
@@ -0,0 +1,293 @@
+/*
+ * SegmentCache.cpp
+ *****************************************************************************
+ * Copyright (C) 2017 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "SegmentCache.hpp"
+
+#include <vlc_block.h>
+#include <vlc_fs.h>
+#include <vlc_md5.h>
+
+#include <sys/stat.h>
+#include <algorithm>
+#include <ctime>
+#include <new>
+#include <sstream>
+#include <vector>
+
+using namespace adaptive::http;
+
+/* Downloads in progress are written to <name>.part.XXXXXX, unique even when
+ * several instances share the directory */
+#define PART_SUFFIX ".part."
+/* Parts left by crashed instances: active ones are written continuously */
+#define PART_STALE_TIME 3600
+
+SegmentCacheWriter::SegmentCacheWriter(SegmentCache *cache_, const std::string &name_,
+                                       const std::string &partpath_, int fd_)
+{
+    cache = cache_;
+    name = name_;
+    partpath = partpath_;
+    fd = fd_;
+    size = 0;
+}
+
+SegmentCacheWriter::~SegmentCacheWriter()
+{
+    if(fd != -1)
+    {
+        vlc_close(fd);
+        vlc_unlink(partpath.c_str());
+    }
+}
+
+bool SegmentCacheWriter::write(const void *p_data, size_t len)
+{
+    const uint8_t *p = static_cast<const uint8_t *>(p_data);
+    while(len > 0)
+    {
+        ssize_t ret = vlc_write(fd, p, len);
+        if(ret < 0)
+            return false;
+        p += ret;
+        len -= ret;
+        size += ret;
+    }
+    return true;
+}
+
+void SegmentCacheWriter::commit(uint64_t expected)
+{
+    if(fd == -1)
+        return;
+
+    vlc_close(fd);
+    fd = -1;
+
+    if(size == 0 || size != expected ||
+       vlc_rename(partpath.c_str(), cache->getPath(name).c_str()))
+    {
+        vlc_unlink(partpath.c_str());
+        return;
+    }
+    cache->add(name, size);
+}
+
+SegmentCache::SegmentCache(vlc_object_t *p_object_, const std::string &dir, uint64_t maxsize)
+{
+    p_object = p_object_;
+    directory = dir;
+    maxSize = maxsize;
+    totalSize = 0;
+    vlc_mutex_init(&lock);
+    load();
+}
+
+SegmentCache::~SegmentCache()
+{
+    vlc_mutex_destroy(&lock);
+}
+
+std::string SegmentCache::getName(const std::string &url, const BytesRange &range)
+{
+    struct md5_s md5;
+    InitMD5(&md5);
+    AddMD5(&md5, url.c_str(), url.length());
+    if(range.isValid())
+    {
+        std::ostringstream key;
+        key << "@" << range.getStartByte() << "-" << range.getEndByte();
+        AddMD5(&md5, key.str().c_str(), key.str().length());
+    }
+    EndMD5(&md5);
+
+    char *psz_hash = psz_md5_hash(&md5);
+    if(!psz_hash)
+        return std::string();
+    std::string name(psz_hash);
+    free(psz_hash);
+    return name;
+}
+
+std::string SegmentCache::getPath(const std::string &name) const
+{
+    return directory + DIR_SEP + name;
+}
+
+static bool compareMTime(const std::pair<time_t, std::string> &a,
+                         const std::pair<time_t, std::string> &b)
+{
+    return a.first > b.first;
+}
+
+/* Indexes what previous sessions left, oldest files being the first
+ * evicted, and removes unfinished writes no longer in progress */
+void SegmentCache::load()
+{
+    vlc_mkdir(directory.c_str(), 0700);
+
+    DIR *dir = vlc_opendir(directory.c_str());
+    if(!dir)
+    {
+        msg_Warn(p_object, "cannot open segments cache %s", directory.c_str());
+        return;
+    }
+
+    std::vector<std::pair<time_t, std::string> > files;
+    std::map<std::string, uint64_t> sizes;
+    const char *psz_name;
+    while((psz_name = vlc_readdir(dir)) != NULL)
+    {
+        std::string name(psz_name);
+        if(name[0] == '.')
+            continue;
+
+        std::string path = getPath(name);
+        struct stat st;
+        if(vlc_stat(path.c_str(), &st) || !S_ISREG(st.st_mode))
+            continue;
+
+        if(name.find(PART_SUFFIX) != std::string::npos)
+        {
+            /* possibly being written by another instance */
+            if(st.st_mtime < time(NULL) - PART_STALE_TIME)
+                vlc_unlink(path.c_str());
+            continue;
+        }
+
+        files.push_back(std::make_pair(st.st_mtime, name));
+        sizes[name] = st.st_size;
+    }
+    closedir(dir);
+
+    std::sort(files.begin(), files.end(), compareMTime);
+
+    vlc_mutex_locker locker(&lock);
+    std::vector<std::pair<time_t, std::string> >::const_iterator it;
+    for(it = files.begin(); it != files.end(); ++it)
+    {
+        Entry entry;
+        entry.name = (*it).second;
+        entry.size = sizes[entry.name];
+        entries.push_back(entry);
+        index[entry.name] = --entries.end();
+        totalSize += entry.size;
+    }
+    evict();
+}
+
+/* Returns the cached segment memory mapped, or NULL if it is not cached */
+block_t * SegmentCache::get(const std::string &url, const BytesRange &range)
+{
+    const std::string name = getName(url, range);
+
+    vlc_mutex_lock(&lock);
+    std::map<std::string, std::list<Entry>::iterator>::iterator it = index.find(name);
+    if(it == index.end())
+    {
+        vlc_mutex_unlock(&lock);
+        return NULL;
+    }
+    /* most recently used now */
+    entries.splice(entries.begin(), entries, (*it).second);
+    vlc_mutex_unlock(&lock);
+
+    block_t *p_block = block_FilePath(getPath(name).c_str(), false);
+    if(!p_block)
+    {
+        /* removed behind our back */
+        vlc_mutex_locker locker(&lock);
+        it = index.find(name);
+        if(it != index.end())
+            remove((*it).second);
+    }
+    else
+    {
+        msg_Dbg(p_object, "Reading %s from the segments cache", url.c_str());
+    }
+    return p_block;
+}
+
+SegmentCacheWriter * SegmentCache::createWriter(const std::string &url, const BytesRange &range)
+{
+    const std::string name = getName(url, range);
+    if(name.empty())
+        return NULL;
+
+    std::string partpath = getPath(name) + PART_SUFFIX "XXXXXX";
+    std::vector<char> psz_partpath(partpath.begin(), partpath.end());
+    psz_partpath.push_back('\0');
+
+    int fd = vlc_mkstemp(&psz_partpath[0]);
+    if(fd == -1)
+        return NULL;
+    partpath = &psz_partpath[0];
+
+    SegmentCacheWriter *writer = new (std::nothrow) SegmentCacheWriter(this, name,
+                                                                       partpath, fd);
+    if(!writer)
+    {
+        vlc_close(fd);
+        vlc_unlink(partpath.c_str());
+    }
+    return writer;
+}
+
+void SegmentCache::add(const std::string &name, uint64_t size)
+{
+    vlc_mutex_locker locker(&lock);
+
+    std::map<std::string, std::list<Entry>::iterator>::iterator it = index.find(name);
+    if(it != index.end())
+    {
+        /* replaced */
+        totalSize -= (*(*it).second).size;
+        entries.erase((*it).second);
+        index.erase(it);
+    }
+
+    Entry entry;
+    entry.name = name;
+    entry.size = size;
+    entries.push_front(entry);
+    index[name] = entries.begin();
+    totalSize += size;
+    evict();
+}
+
+/* Must be called with the lock held */
+void SegmentCache::remove(std::list<Entry>::iterator it)
+{
+    vlc_unlink(getPath((*it).name).c_str());
+    totalSize -= (*it).size;
+    index.erase((*it).name);
+    entries.erase(it);
+}
+
+/* Must be called with the lock held */
+void SegmentCache::evict()
+{
+    /* Mapped segments stay readable once their file is removed */
+    while(totalSize > maxSize && !entries.empty())
+        remove(--entries.end());
+}
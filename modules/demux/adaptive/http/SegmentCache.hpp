@@ -0,0 +1,96 @@
+/*
+ * SegmentCache.hpp
+ *****************************************************************************
+ * Copyright (C) 2017 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef SEGMENTCACHE_HPP
+#define SEGMENTCACHE_HPP
+
+#include "BytesRange.hpp"
+
+#include <vlc_common.h>
+#include <list>
+#include <map>
+#include <string>
+
+namespace adaptive
+{
+    namespace http
+    {
+        class SegmentCache;
+
+        /* Stores a segment in the cache while it is being downloaded. The
+         * segment is only added once it is complete: destroying the writer
+         * before committing it, or committing fewer or more bytes than
+         * expected, discards what was written. */
+        class SegmentCacheWriter
+        {
+            friend class SegmentCache;
+
+            public:
+                ~SegmentCacheWriter();
+                bool write(const void *, size_t);
+                void commit(uint64_t);
+
+            private:
+                SegmentCacheWriter(SegmentCache *, const std::string &,
+                                   const std::string &, int);
+                SegmentCache *cache;
+                std::string   name;
+                std::string   partpath;
+                int           fd;
+                uint64_t      size;
+        };
+
+        /* Segments downloaded during previous seeks or sessions, as files
+         * named after their URL and range, evicted in least recently used
+         * order once over the size limit. Hits are memory mapped. */
+        class SegmentCache
+        {
+            friend class SegmentCacheWriter;
+
+            public:
+                SegmentCache(vlc_object_t *, const std::string &, uint64_t);
+                ~SegmentCache();
+                block_t *            get(const std::string &, const BytesRange &);
+                SegmentCacheWriter * createWriter(const std::string &, const BytesRange &);
+
+            private:
+                struct Entry
+                {
+                    std::string name;
+                    uint64_t    size;
+                };
+                static std::string getName(const std::string &, const BytesRange &);
+                std::string getPath(const std::string &) const;
+                void load();
+                void add(const std::string &, uint64_t);
+                void remove(std::list<Entry>::iterator);
+                void evict();
+
+                vlc_object_t *p_object;
+                std::string   directory;
+                uint64_t      maxSize;
+                uint64_t      totalSize;
+                std::list<Entry> entries; /* most recently used first */
+                std::map<std::string, std::list<Entry>::iterator> index;
+                vlc_mutex_t   lock;
+        };
+    }
+}
+
+#endif // SEGMENTCACHE_HPP
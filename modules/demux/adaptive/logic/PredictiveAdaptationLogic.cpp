@@ -85,7 +85,9 @@ BaseRepresentation *PredictiveAdaptationLogic::getNextRepresentation(BaseAdaptat
 
         double f_buffering_level = (double)stats.buffering_level / stats.buffering_target;
         double f_min_buffering_level = f_buffering_level;
-        unsigned i_max_bitrate = 0;
+        /* The streams share the link: its bandwidth is at least the best
+         * download rate of any of them, including this one */
+        unsigned i_max_bitrate = stats.last_download_rate;
         if(streams.size() > 1)
         {
             std::map<ID, PredictiveStats>::const_iterator it2 = streams.begin();
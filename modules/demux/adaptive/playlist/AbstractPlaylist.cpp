@@ -46,6 +46,7 @@ AbstractPlaylist::AbstractPlaylist (vlc_object_t *p_object_) :
     minBufferTime = 0;
     timeShiftBufferDepth.Set( 0 );
     suggestedPresentationDelay.Set( 0 );
+    lowLatency.Set( false );
 }
 
 AbstractPlaylist::~AbstractPlaylist()
@@ -86,6 +87,9 @@ void AbstractPlaylist::setMinBuffering( mtime_t min )
 
 mtime_t AbstractPlaylist::getMinBuffering() const
 {
+    /* Low latency streams can't be ahead of their live edge by much */
+    if(lowLatency.Get())
+        return std::max(minBufferTime, CLOCK_FREQ);
     return std::max(minBufferTime, 6*CLOCK_FREQ);
 }
 
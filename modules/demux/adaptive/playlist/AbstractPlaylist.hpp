@@ -69,6 +69,7 @@ namespace adaptive
                 Property<mtime_t>                   maxSegmentDuration;
                 Property<mtime_t>                   timeShiftBufferDepth;
                 Property<mtime_t>                   suggestedPresentationDelay;
+                Property<bool>                      lowLatency; /* segments served while produced */
 
             protected:
                 vlc_object_t                       *p_object;
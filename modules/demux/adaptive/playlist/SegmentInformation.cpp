@@ -164,11 +164,15 @@ std::size_t SegmentInformation::getAllSegments(std::vector<ISegment *> &retSegme
 
 uint64_t SegmentInformation::getLiveStartSegmentNumber(uint64_t def) const
 {
-    const mtime_t i_max_buffering = getPlaylist()->getMaxBuffering() +
-                                    /* FIXME: add dynamic pts-delay */ CLOCK_FREQ;
+    /* Low latency streams start as close to the live edge as their minimum
+       buffering allows, as their last segment is served while produced */
+    const bool b_lowlatency = getPlaylist()->lowLatency.Get();
+    const mtime_t i_buffering = b_lowlatency ? getPlaylist()->getMinBuffering()
+                              : getPlaylist()->getMaxBuffering() +
+                                /* FIXME: add dynamic pts-delay */ CLOCK_FREQ;
 
     /* Try to never buffer up to really end */
-    const uint64_t OFFSET_FROM_END = 3;
+    const uint64_t OFFSET_FROM_END = b_lowlatency ? 0 : 3;
 
     if( mediaSegmentTemplate )
     {
@@ -186,11 +190,11 @@ uint64_t SegmentInformation::getLiveStartSegmentNumber(uint64_t def) const
             stime_t endtime, duration;
             timeline->getScaledPlaybackTimeDurationBySegmentNumber( end, &endtime, &duration );
 
-            if( endtime + duration <= timescale.ToScaled( i_max_buffering ) )
+            if( endtime + duration <= timescale.ToScaled( i_buffering ) )
                 return start;
 
             uint64_t number = timeline->getElementNumberByScaledPlaybackTime(
-                                        endtime + duration - timescale.ToScaled( i_max_buffering ) );
+                                        endtime + duration - timescale.ToScaled( i_buffering ) );
             if( number < start )
                 number = start;
             return number;
@@ -215,7 +219,7 @@ uint64_t SegmentInformation::getLiveStartSegmentNumber(uint64_t def) const
             else
                 start = end - count;
 
-            const uint64_t bufcount = ( OFFSET_FROM_END + timescale.ToScaled(i_max_buffering) /
+            const uint64_t bufcount = ( OFFSET_FROM_END + timescale.ToScaled(i_buffering) /
                                         mediaSegmentTemplate->duration.Get() );
 
             return ( end - start > bufcount ) ? end - bufcount : start;
@@ -227,7 +231,7 @@ uint64_t SegmentInformation::getLiveStartSegmentNumber(uint64_t def) const
         const std::vector<ISegment *> list = segmentList->getSegments();
 
         const ISegment *back = list.back();
-        const stime_t bufferingstart = back->startTime.Get() + back->duration.Get() - timescale.ToScaled( i_max_buffering );
+        const stime_t bufferingstart = back->startTime.Get() + back->duration.Get() - timescale.ToScaled( i_buffering );
         uint64_t number;
         if( !segmentList->getSegmentNumberByScaledTime( bufferingstart, &number ) )
             return list.front()->getSequenceNumber();
@@ -246,7 +250,7 @@ uint64_t SegmentInformation::getLiveStartSegmentNumber(uint64_t def) const
         const Timescale timescale = inheritTimescale();
         const ISegment *back = list.back();
         const stime_t bufferingstart = back->startTime.Get() -
-                (OFFSET_FROM_END * back->duration.Get())- timescale.ToScaled( i_max_buffering );
+                (OFFSET_FROM_END * back->duration.Get())- timescale.ToScaled( i_buffering );
         uint64_t number;
         if( !SegmentInfoCommon::getSegmentNumberByScaledTime( list, bufferingstart, &number ) )
             return list.front()->getSequenceNumber();
@@ -121,9 +121,11 @@ void SegmentList::pruneBySegmentNumber(uint64_t tobelownum)
         if(seg->chunksuse.Get()) /* can't prune from here, still in use */
             break;
 
-        delete *it;
-        it = segments.erase(it);
+        delete seg;
+        ++it;
     }
+    /* single shift of the remaining segments */
+    segments.erase(segments.begin(), it);
 }
 
 bool SegmentList::getSegmentNumberByScaledTime(stime_t time, uint64_t *ret) const
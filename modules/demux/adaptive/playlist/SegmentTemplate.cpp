@@ -29,6 +29,8 @@
 #include "SegmentInformation.hpp"
 #include "AbstractPlaylist.hpp"
 
+#include <algorithm>
+
 using namespace adaptive::playlist;
 
 BaseSegmentTemplate::BaseSegmentTemplate( ICanonicalUrl *parent ) :
@@ -43,6 +45,7 @@ MediaSegmentTemplate::MediaSegmentTemplate( SegmentInformation *parent ) :
     debugName = "SegmentTemplate";
     classId = Segment::CLASSID_SEGMENT;
     startNumber.Set( 1 );
+    availabilityTimeOffset.Set( 0 );
     initialisationSegment.Set( NULL );
     templated = true;
     parentSegmentInformation = parent;
@@ -90,7 +93,14 @@ uint64_t MediaSegmentTemplate::getCurrentLiveTemplateNumber() const
         time_t streamstart = parentSegmentInformation->getPlaylist()->availabilityStartTime.Get();
         streamstart += parentSegmentInformation->getPeriodStart();
         stime_t elapsed = timescale.ToScaled(CLOCK_FREQ * (playbacktime - streamstart));
-        number += elapsed / dur - 2;
+        /* With an availability offset, segments are served before their end
+           (chunked low latency): take the last available one, instead of
+           keeping one more of margin */
+        const mtime_t offset = std::min(availabilityTimeOffset.Get(), timescale.ToTime(dur));
+        if(offset > 0)
+            number += (elapsed + timescale.ToScaled(offset)) / dur - 1;
+        else
+            number += elapsed / dur - 2;
     }
 
     return number;
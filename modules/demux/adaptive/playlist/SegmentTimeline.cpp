@@ -43,111 +43,105 @@ SegmentTimeline::SegmentTimeline(uint64_t scale)
 
 SegmentTimeline::~SegmentTimeline()
 {
-    std::list<Element *>::iterator it;
-    for(it = elements.begin(); it != elements.end(); ++it)
-        delete *it;
 }
 
 void SegmentTimeline::addElement(uint64_t number, stime_t d, uint64_t r, stime_t t)
 {
-    Element *element = new (std::nothrow) Element(number, d, r, t);
-    if(element)
+    if(!elements.empty())
     {
-        if(!elements.empty() && !t)
+        Element &el = elements.back();
+        /* Same duration right after the previous run: just repeat it */
+        if(el.d == d && (!t || t == el.end()) && number == el.number + el.r + 1)
         {
-            const Element *el = elements.back();
-            element->t = el->t + (el->d * (el->r + 1));
+            el.r += r + 1;
+            return;
         }
-        elements.push_back(element);
+        if(!t)
+            t = el.end();
     }
+    elements.push_back(Element(number, d, r, t));
 }
 
-mtime_t SegmentTimeline::getMinAheadScaledTime(uint64_t number) const
+/* Run containing number, or the first one if it is before */
+std::vector<SegmentTimeline::Element>::const_iterator
+SegmentTimeline::findByNumber(uint64_t number) const
 {
-    stime_t totalscaledtime = 0;
-
-    std::list<Element *>::const_reverse_iterator it;
-    for(it = elements.rbegin(); it != elements.rend(); ++it)
+    std::vector<Element>::const_iterator first = elements.begin();
+    std::size_t count = elements.size();
+    while(count > 0)
     {
-        const Element *el = *it;
-
-        if(number < el->number)
+        const std::size_t step = count / 2;
+        std::vector<Element>::const_iterator it = first + step;
+        if(it->number <= number)
         {
-            totalscaledtime += (el->d * (el->r + 1));
-            break;
+            first = ++it;
+            count -= step + 1;
         }
-        else if(number <= el->number + el->r)
-        {
-            totalscaledtime += el->d * (el->number + el->r - number);
-        }
-        else break;
+        else count = step;
     }
-
-    return totalscaledtime;
+    return (first == elements.begin()) ? first : first - 1;
 }
 
-uint64_t SegmentTimeline::getElementNumberByScaledPlaybackTime(stime_t scaled) const
+/* Run containing scaled time, or the first one if it is before */
+std::vector<SegmentTimeline::Element>::const_iterator
+SegmentTimeline::findByScaledTime(stime_t scaled) const
 {
-    uint64_t prevnumber = 0;
-    std::list<Element *>::const_iterator it;
-    for(it = elements.begin(); it != elements.end(); ++it)
+    std::vector<Element>::const_iterator first = elements.begin();
+    std::size_t count = elements.size();
+    while(count > 0)
     {
-        const Element *el = *it;
-        if(it == elements.begin())
+        const std::size_t step = count / 2;
+        std::vector<Element>::const_iterator it = first + step;
+        if(it->t <= scaled)
         {
-            scaled -= el->t;
-            prevnumber = el->number;
+            first = ++it;
+            count -= step + 1;
         }
-
-        for(uint64_t repeat = 1 + el->r; repeat; repeat--)
-        {
-            if(el->d >= scaled)
-                return prevnumber;
-
-            scaled -= el->d;
-            prevnumber++;
-        }
-
-        /* might have been discontinuity */
-        prevnumber = el->number;
+        else count = step;
     }
-
-    return prevnumber;
+    return (first == elements.begin()) ? first : first - 1;
 }
 
-bool SegmentTimeline::getScaledPlaybackTimeDurationBySegmentNumber(uint64_t number,
-                                                                   stime_t *time, stime_t *duration) const
+stime_t SegmentTimeline::getMinAheadScaledTime(uint64_t number) const
 {
-    stime_t totalscaledtime = 0;
-    stime_t lastduration = 0;
+    if(elements.empty())
+        return 0;
 
-    std::list<Element *>::const_iterator it;
-    for(it = elements.begin(); it != elements.end(); ++it)
-    {
-        const Element *el = *it;
+    const Element &el = *findByNumber(number);
+    stime_t segmentend = el.t;
+    if(number >= el.number)
+        segmentend += el.d * (stime_t)(std::min(number - el.number, el.r) + 1);
 
-        /* set start time, or from discontinuity */
-        if(it == elements.begin() || el->t)
-        {
-            totalscaledtime = el->t;
-        }
+    return elements.back().end() - segmentend;
+}
 
-        lastduration = el->d;
+uint64_t SegmentTimeline::getElementNumberByScaledPlaybackTime(stime_t scaled) const
+{
+    if(elements.empty())
+        return 0;
 
-        if(number <= el->number)
-            break;
+    const Element &el = *findByScaledTime(scaled);
+    if(scaled <= el.t || !el.d)
+        return el.number;
 
-        if(number <= el->number + el->r)
-        {
-            totalscaledtime += el->d * (number - el->number);
-            break;
-        }
+    /* past the run's end when there's a gap before the next one */
+    return el.number + std::min((uint64_t)((scaled - el.t) / el.d), el.r);
+}
 
-        totalscaledtime += (el->d * (el->r + 1));
+bool SegmentTimeline::getScaledPlaybackTimeDurationBySegmentNumber(uint64_t number,
+                                                                   stime_t *time, stime_t *duration) const
+{
+    if(elements.empty())
+    {
+        *time = *duration = 0;
+        return true;
     }
 
-    *time = totalscaledtime;
-    *duration = lastduration;
+    const Element &el = *findByNumber(number);
+    *time = el.t;
+    *duration = el.d;
+    if(number > el.number)
+        *time += el.d * (stime_t)std::min(number - el.number, el.r + 1);
     return true;
 }
 
@@ -163,15 +157,15 @@ uint64_t SegmentTimeline::maxElementNumber() const
     if(elements.empty())
         return 0;
 
-    const Element *e = elements.back();
-    return e->number + e->r;
+    const Element &e = elements.back();
+    return e.number + e.r;
 }
 
 uint64_t SegmentTimeline::minElementNumber() const
 {
     if(elements.empty())
         return 0;
-    return elements.front()->number;
+    return elements.front().number;
 }
 
 void SegmentTimeline::pruneByPlaybackTime(mtime_t time)
@@ -184,29 +178,21 @@ void SegmentTimeline::pruneByPlaybackTime(mtime_t time)
 size_t SegmentTimeline::pruneBySequenceNumber(uint64_t number)
 {
     size_t prunednow = 0;
-    while(elements.size())
+    std::vector<Element>::iterator it;
+    for(it = elements.begin(); it != elements.end() && it->number < number; ++it)
     {
-        Element *el = elements.front();
-        if(el->number >= number)
-        {
-            break;
-        }
-        else if(el->number + el->r >= number)
+        if(it->number + it->r >= number)
         {
-            uint64_t count = number - el->number;
-            el->number += count;
-            el->t += count * el->d;
-            el->r -= count;
+            uint64_t count = number - it->number;
+            it->number += count;
+            it->t += count * it->d;
+            it->r -= count;
             prunednow += count;
             break;
         }
-        else
-        {
-            prunednow += el->r + 1;
-            elements.pop_front();
-            delete el;
-        }
+        prunednow += it->r + 1;
     }
+    elements.erase(elements.begin(), it);
 
     return prunednow;
 }
@@ -215,36 +201,38 @@ void SegmentTimeline::mergeWith(SegmentTimeline &other)
 {
     if(elements.empty())
     {
-        while(other.elements.size())
-        {
-            elements.push_back(other.elements.front());
-            other.elements.pop_front();
-        }
+        elements.swap(other.elements);
         return;
     }
 
-    Element *last = elements.back();
-    while(other.elements.size())
-    {
-        Element *el = other.elements.front();
-        other.elements.pop_front();
+    stime_t lastend = elements.back().end();
 
-        if(last->contains(el->t)) /* Same element, but prev could have been middle of repeat */
-        {
-            const uint64_t count = (el->t - last->t) / last->d;
-            last->r = std::max(last->r, el->r + count);
-            delete el;
-        }
-        else if(el->t < last->t)
-        {
-            delete el;
-        }
+    /* Only the tail of a refreshed timeline can be new: look for the first
+     * element ending past ours from the back, so that merging only costs the
+     * number of new elements. */
+    std::vector<Element>::const_iterator it = other.elements.end();
+    while(it != other.elements.begin() && (it - 1)->end() > lastend)
+        --it;
+
+    for(; it != other.elements.end(); ++it)
+    {
+        if(!it->d)
+            continue;
+
+        uint64_t skip = 0;
+        if(it->t < lastend) /* Same element, but prev could have been middle of repeat */
+            skip = (lastend - it->t + it->d - 1) / it->d;
+        if(skip > it->r)
+            continue;
+
+        const stime_t t = it->t + it->d * (stime_t)skip;
+        const uint64_t r = it->r - skip;
+        Element &last = elements.back();
+        if(it->d == last.d && t == last.end())
+            last.r += r + 1;
         else /* Did not exist in previous list */
-        {
-            elements.push_back(el);
-            el->number = last->number + last->r + 1;
-            last = el;
-        }
+            elements.push_back(Element(last.number + last.r + 1, it->d, r, t));
+        lastend = elements.back().end();
     }
 }
 
@@ -252,16 +240,14 @@ mtime_t SegmentTimeline::start() const
 {
     if(elements.empty())
         return 0;
-    return inheritTimescale().ToTime(elements.front()->t);
+    return inheritTimescale().ToTime(elements.front().t);
 }
 
 mtime_t SegmentTimeline::end() const
 {
     if(elements.empty())
         return 0;
-    const Element *last = elements.back();
-    stime_t scaled = last->t + last->d * (last->r + 1);
-    return inheritTimescale().ToTime(scaled);
+    return inheritTimescale().ToTime(elements.back().end());
 }
 
 void SegmentTimeline::debug(vlc_object_t *obj, int indent) const
@@ -270,9 +256,9 @@ void SegmentTimeline::debug(vlc_object_t *obj, int indent) const
     ss << std::string(indent, ' ') << "Timeline";
     msg_Dbg(obj, "%s", ss.str().c_str());
 
-    std::list<Element *>::const_iterator it;
+    std::vector<Element>::const_iterator it;
     for(it = elements.begin(); it != elements.end(); ++it)
-        (*it)->debug(obj, indent + 1);
+        (*it).debug(obj, indent + 1);
 }
 
 SegmentTimeline::Element::Element(uint64_t number_, stime_t d_, uint64_t r_, stime_t t_)
@@ -283,11 +269,9 @@ SegmentTimeline::Element::Element(uint64_t number_, stime_t d_, uint64_t r_, sti
     r = r_;
 }
 
-bool SegmentTimeline::Element::contains(stime_t time) const
+stime_t SegmentTimeline::Element::end() const
 {
-    if(time >= t && time < t + (stime_t)(r + 1) * d)
-        return true;
-    return false;
+    return t + d * (stime_t)(r + 1);
 }
 
 void SegmentTimeline::Element::debug(vlc_object_t *obj, int indent) const
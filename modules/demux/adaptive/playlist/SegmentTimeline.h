@@ -26,7 +26,7 @@
 
 #include "SegmentInfoCommon.h"
 #include <vlc_common.h>
-#include <list>
+#include <vector>
 
 namespace adaptive
 {
@@ -34,8 +34,6 @@ namespace adaptive
     {
         class SegmentTimeline : public TimescaleAble
         {
-            class Element;
-
             public:
                 SegmentTimeline(TimescaleAble *);
                 SegmentTimeline(uint64_t);
@@ -55,19 +53,24 @@ namespace adaptive
                 void debug(vlc_object_t *, int = 0) const;
 
             private:
-                std::list<Element *> elements;
-
+                /* One run of r + 1 segments of duration d. t and number are the
+                 * start time and number of its first segment, which sort the
+                 * runs for binary searches by time or by number. */
                 class Element
                 {
                     public:
                         Element(uint64_t, stime_t, uint64_t, stime_t);
                         void debug(vlc_object_t *, int = 0) const;
-                        bool contains(stime_t) const;
+                        stime_t end() const;
                         stime_t  t;
                         stime_t  d;
                         uint64_t r;
                         uint64_t number;
                 };
+
+                std::vector<Element>::const_iterator findByNumber(uint64_t) const;
+                std::vector<Element>::const_iterator findByScaledTime(stime_t) const;
+                std::vector<Element> elements;
         };
     }
 }
@@ -0,0 +1,486 @@
+/*
+ * abr.cpp: trace driven adaptation logic simulation
+ *****************************************************************************
+ * Copyright (C) 2017 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Replays a bandwidth trace through the SegmentTracker and the adaptation
+ * logics in virtual time, and reports the quality of experience they
+ * achieve. Nothing is actually downloaded nor demuxed: segment sizes are
+ * derived from the representations' bandwidth, and the playback buffer is
+ * modelled from the segments' durations.
+ *
+ * Without arguments, runs the fixtures and checks the results.
+ * Otherwise, usage: adaptive_abr_test <mpd> <trace> [...]
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_stream.h>
+#include <vlc_xml.h>
+
+#include "../../../../lib/libvlc_internal.h"
+
+#include "playlist/BasePeriod.h"
+#include "playlist/BaseAdaptationSet.h"
+#include "playlist/BaseRepresentation.h"
+#include "playlist/SegmentChunk.hpp"
+#include "http/HTTPConnectionManager.h"
+#include "logic/RateBasedAdaptationLogic.h"
+#include "logic/PredictiveAdaptationLogic.hpp"
+#include "logic/NearOptimalAdaptationLogic.hpp"
+#include "SegmentTracker.hpp"
+#include "xml/DOMParser.h"
+#include "../dash/mpd/IsoffMainParser.h"
+#include "../dash/mpd/MPD.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#undef NDEBUG
+#include <assert.h>
+
+#ifndef ABR_FIXTURES_DIR
+# define ABR_FIXTURES_DIR "."
+#endif
+
+using namespace adaptive;
+using namespace adaptive::http;
+using namespace adaptive::logic;
+using namespace adaptive::playlist;
+using namespace adaptive::xml;
+using namespace dash::mpd;
+
+/* Piecewise constant network conditions */
+class Trace
+{
+    public:
+        bool load(const char *path)
+        {
+            FILE *fp = fopen(path, "r");
+            if(!fp)
+                return false;
+
+            char line[256];
+            while(fgets(line, sizeof(line), fp))
+            {
+                double start, kbps, rtt = 0;
+                if(line[0] == '#' ||
+                   sscanf(line, "%lf %lf %lf", &start, &kbps, &rtt) < 2 || kbps <= 0)
+                    continue;
+                Step step;
+                step.start = start * CLOCK_FREQ;
+                step.bps = kbps * 1000;
+                step.latency = rtt * CLOCK_FREQ / 1000;
+                steps.push_back(step);
+            }
+            fclose(fp);
+            return !steps.empty() && steps.front().start == 0;
+        }
+
+        /* Time at which a request issued at the given time has been
+         * received, the last step lasting forever */
+        mtime_t transfer(mtime_t time, size_t bytes) const
+        {
+            size_t i = find(time);
+            double now = time + steps[i].latency;
+            double bits = bytes * 8.0;
+            for(i = find(now); ; i++)
+            {
+                double avail = bits;
+                if(i + 1 < steps.size())
+                    avail = (steps[i + 1].start - now) * steps[i].bps / CLOCK_FREQ;
+                if(bits <= avail)
+                    return now + bits * CLOCK_FREQ / steps[i].bps;
+                bits -= avail;
+                now = steps[i + 1].start;
+            }
+        }
+
+    private:
+        struct Step
+        {
+            mtime_t start;
+            double bps;
+            mtime_t latency;
+        };
+        std::vector<Step> steps;
+
+        size_t find(double time) const
+        {
+            size_t i = 0;
+            while(i + 1 < steps.size() && steps[i + 1].start <= time)
+                i++;
+            return i;
+        }
+};
+
+/* Nothing goes over the network: the simulation times the chunks itself */
+class SimulatedConnectionManager : public AbstractConnectionManager
+{
+    public:
+        SimulatedConnectionManager(vlc_object_t *obj) :
+            AbstractConnectionManager(obj) {}
+        virtual void closeAllConnections() {}
+        virtual AbstractConnection * getConnection(ConnectionParams &) { return NULL; }
+        virtual void recycleConnection(AbstractConnection *) {}
+        virtual void start(AbstractChunkSource *) {}
+        virtual void cancel(AbstractChunkSource *) {}
+};
+
+/* Follows what the tracker hands out */
+class TrackerObserver : public SegmentTrackerListenerInterface
+{
+    public:
+        TrackerObserver() : current(NULL), duration(0), switches(0) {}
+
+        virtual void trackerEvent(const SegmentTrackerEvent &event)
+        {
+            switch(event.type)
+            {
+                case SegmentTrackerEvent::SWITCHING:
+                    if(event.u.switching.prev && event.u.switching.next)
+                        switches++;
+                    current = event.u.switching.next;
+                    break;
+                case SegmentTrackerEvent::SEGMENT_CHANGE:
+                    duration = event.u.segment.duration;
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        BaseRepresentation *current;
+        mtime_t duration;
+        unsigned switches;
+};
+
+struct QoE
+{
+    mtime_t played;
+    double bitrate; /* average of the played segments, in bit/s */
+    unsigned switches;
+    unsigned stalls;
+    mtime_t stalled;
+    mtime_t startup;
+};
+
+enum LogicType
+{
+    RATE_BASED,
+    PREDICTIVE,
+    NEAR_OPTIMAL,
+};
+
+static const char * const logic_names[] = { "rate", "predictive", "nearoptimal" };
+
+static AbstractAdaptationLogic * CreateLogic(vlc_object_t *obj, LogicType type)
+{
+    switch(type)
+    {
+        case RATE_BASED:   return new RateBasedAdaptationLogic(obj);
+        case PREDICTIVE:   return new PredictiveAdaptationLogic(obj);
+        case NEAR_OPTIMAL: return new NearOptimalAdaptationLogic(obj);
+    }
+    return NULL;
+}
+
+static MPD * LoadMPD(vlc_object_t *obj, const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    if(!fp)
+        return NULL;
+
+    uint8_t *buf = NULL;
+    size_t len = 0;
+    char chunk[4096];
+    size_t got;
+    while((got = fread(chunk, 1, sizeof(chunk), fp)) > 0)
+    {
+        uint8_t *realloced = (uint8_t *) realloc(buf, len + got);
+        if(!realloced)
+            break;
+        buf = realloced;
+        memcpy(&buf[len], chunk, got);
+        len += got;
+    }
+    fclose(fp);
+
+    stream_t *s = vlc_stream_MemoryNew(obj, buf, len, false);
+    if(!s)
+    {
+        free(buf);
+        return NULL;
+    }
+
+    MPD *mpd = NULL;
+    DOMParser parser(s);
+    if(parser.parse(true))
+    {
+        IsoffMainParser mpdparser(parser.getRootNode(), obj, s, "http://abr.test/");
+        mpd = mpdparser.parse();
+    }
+    vlc_stream_Delete(s);
+    return mpd;
+}
+
+/* Plays the first adaptation set of the playlist under the given network
+ * conditions, downloading one chunk after the other as the real streams do */
+static void Simulate(vlc_object_t *obj, AbstractPlaylist *playlist,
+                     const Trace &trace, LogicType type, QoE *qoe)
+{
+    BasePeriod *period = playlist->getFirstPeriod();
+    assert(period && !period->getAdaptationSets().empty());
+    BaseAdaptationSet *set = period->getAdaptationSets().front();
+
+    const mtime_t minbuffering = playlist->getMinBuffering();
+    const mtime_t maxbuffering = playlist->getMaxBuffering();
+
+    AbstractAdaptationLogic *logic = CreateLogic(obj, type);
+    SimulatedConnectionManager connManager(obj);
+    connManager.setDownloadRateObserver(logic);
+    SegmentTracker *tracker = new SegmentTracker(logic, set);
+    TrackerObserver observer;
+    tracker->registerListener(&observer);
+    tracker->notifyBufferingState(true);
+
+    mtime_t now = 0;
+    mtime_t fetched = 0;
+    mtime_t buffered = 0;
+    bool playing = false;
+    double bits = 0;
+    memset(qoe, 0, sizeof(*qoe));
+
+    /* Templates without a timeline are unbounded, the server answering
+       past the end with errors */
+    while(playlist->duration.Get() == 0 || fetched < playlist->duration.Get())
+    {
+        /* Don't request more than what the playlist allows buffering */
+        if(buffered > maxbuffering)
+        {
+            now += buffered - maxbuffering;
+            qoe->played += buffered - maxbuffering;
+            buffered = maxbuffering;
+        }
+
+        observer.duration = 0;
+        SegmentChunk *chunk = tracker->getNextChunk(true, &connManager);
+        if(!chunk)
+            break;
+        assert(observer.current);
+
+        /* init segments only cost a round trip */
+        const mtime_t duration = observer.duration;
+        const size_t size = observer.current->getBandwidth() * duration / CLOCK_FREQ / 8;
+        const mtime_t elapsed = trace.transfer(now, size) - now;
+        delete chunk;
+
+        if(playing)
+        {
+            if(elapsed > buffered)
+            {
+                qoe->stalls++;
+                qoe->stalled += elapsed - buffered;
+                qoe->played += buffered;
+                buffered = 0;
+                playing = false;
+            }
+            else
+            {
+                qoe->played += elapsed;
+                buffered -= elapsed;
+            }
+        }
+        else if(qoe->played > 0)
+        {
+            qoe->stalled += elapsed;
+        }
+        now += elapsed;
+
+        if(duration > 0)
+        {
+            fetched += duration;
+            buffered += duration;
+            bits += (double) observer.current->getBandwidth() * duration;
+            connManager.updateDownloadRate(set->getID(), size, elapsed);
+        }
+
+        if(!playing && buffered >= minbuffering)
+        {
+            playing = true;
+            if(qoe->played == 0)
+                qoe->startup = now;
+        }
+
+        tracker->notifyBufferingLevel(minbuffering, buffered, maxbuffering);
+    }
+
+    /* the end of the buffer always plays */
+    if(!playing && qoe->played == 0)
+        qoe->startup = now;
+    qoe->played += buffered;
+
+    qoe->switches = observer.switches;
+    if(qoe->played > 0)
+        qoe->bitrate = bits / qoe->played;
+
+    tracker->notifyBufferingState(false);
+    delete tracker;
+    delete logic;
+}
+
+static void Report(const char *trace, LogicType type, const QoE &qoe)
+{
+    printf("%-16s %-12s %8.0f kbit/s %3u switches %3u stalls %6.2f s stalled"
+           " %5.2f s startup\n", trace, logic_names[type], qoe.bitrate / 1000,
+           qoe.switches, qoe.stalls, (double) qoe.stalled / CLOCK_FREQ,
+           (double) qoe.startup / CLOCK_FREQ);
+}
+
+static bool Run(vlc_object_t *obj, const char *mpdpath, const char *tracepath,
+                QoE qoe[3])
+{
+    MPD *mpd = LoadMPD(obj, mpdpath);
+    if(!mpd)
+    {
+        fprintf(stderr, "cannot load playlist %s\n", mpdpath);
+        return false;
+    }
+
+    Trace trace;
+    if(!trace.load(tracepath))
+    {
+        fprintf(stderr, "cannot load trace %s\n", tracepath);
+        delete mpd;
+        return false;
+    }
+
+    const char *name = strrchr(tracepath, '/');
+    name = name ? name + 1 : tracepath;
+
+    for(int i = RATE_BASED; i <= NEAR_OPTIMAL; i++)
+    {
+        Simulate(obj, mpd, trace, (LogicType) i, &qoe[i]);
+        Report(name, (LogicType) i, qoe[i]);
+    }
+
+    fflush(stdout);
+    delete mpd;
+    return true;
+}
+
+/* What each logic currently achieves on the fixtures, with some margin:
+ * a regression shows up as one of these bounds being crossed */
+struct Expected
+{
+    double bitrate;  /* minimum average, bit/s */
+    mtime_t stalled; /* maximum */
+    mtime_t startup; /* maximum */
+};
+
+static void Check(vlc_object_t *obj, const char *trace, const Expected expected[3])
+{
+    QoE qoe[3];
+    assert(Run(obj, ABR_FIXTURES_DIR "/vod.mpd", trace, qoe));
+    for(int i = RATE_BASED; i <= NEAR_OPTIMAL; i++)
+    {
+        assert(qoe[i].played == 120 * CLOCK_FREQ);
+        assert(qoe[i].bitrate >= expected[i].bitrate);
+        assert(qoe[i].stalled <= expected[i].stalled);
+        assert(qoe[i].startup <= expected[i].startup);
+    }
+}
+
+static void CheckFixtures(vlc_object_t *obj)
+{
+    /* Plenty of bandwidth: every logic settles on the highest bitrate */
+    const Expected constant[3] = {
+        { 7000000, 0, 1 * CLOCK_FREQ },
+        { 7000000, 0, 3 * CLOCK_FREQ },
+        { 7500000, 0, 3 * CLOCK_FREQ },
+    };
+    Check(obj, ABR_FIXTURES_DIR "/constant.trace", constant);
+
+    /* Fades, down to below the lowest bitrate. The near optimal logic
+     * picks from the buffer level only, and stalls on the deepest ones */
+    const Expected variable[3] = {
+        { 1200000,  0,                2 * CLOCK_FREQ },
+        { 2000000,  0,               10 * CLOCK_FREQ },
+        { 7000000, 60 * CLOCK_FREQ,   7 * CLOCK_FREQ },
+    };
+    Check(obj, ABR_FIXTURES_DIR "/variable.trace", variable);
+}
+
+/* The MPD parser needs an XML reader module, which may not be built */
+static bool HasXMLReader(vlc_object_t *obj)
+{
+    static const char doc[] = "<?xml version=\"1.0\"?><MPD/>";
+    stream_t *s = vlc_stream_MemoryNew(obj, (uint8_t *) doc,
+                                       sizeof(doc) - 1, true);
+    if(!s)
+        return false;
+
+    xml_reader_t *reader = xml_ReaderCreate(obj, s);
+    if(reader)
+        xml_ReaderDelete(reader);
+    vlc_stream_Delete(s);
+    return reader != NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    setenv("VLC_PLUGIN_PATH", "../modules", 0);
+
+    const char *args[] = { "adaptive_abr_test", "--ignore-config", "--quiet" };
+    libvlc_int_t *vlc = libvlc_InternalCreate();
+    assert(vlc);
+    if(libvlc_InternalInit(vlc, ARRAY_SIZE(args), args) != VLC_SUCCESS)
+    {
+        libvlc_InternalDestroy(vlc);
+        return 77;
+    }
+
+    int ret = 0;
+    if(!HasXMLReader(VLC_OBJECT(vlc)))
+    {
+        fprintf(stderr, "no XML reader module, skipping\n");
+        ret = 77;
+    }
+    else if(argc < 3)
+    {
+        CheckFixtures(VLC_OBJECT(vlc));
+    }
+    else
+    {
+        for(int i = 2; i < argc; i++)
+        {
+            QoE qoe[3];
+            if(!Run(VLC_OBJECT(vlc), argv[1], argv[i], qoe))
+                ret = 1;
+        }
+    }
+
+    libvlc_InternalCleanup(vlc);
+    libvlc_InternalDestroy(vlc);
+    return ret;
+}
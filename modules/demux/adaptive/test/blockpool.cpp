@@ -0,0 +1,88 @@
+/*
+ * blockpool.cpp: receive buffers pool and slicing tests
+ *****************************************************************************
+ * Copyright (C) 2017 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+
+#include "http/BlockPool.hpp"
+
+#undef NDEBUG
+#include <assert.h>
+
+using namespace adaptive::http;
+
+static bool CheckBytes(const uint8_t *p, size_t size, unsigned first)
+{
+    for(size_t i = 0; i < size; i++)
+        if(p[i] != (uint8_t)(first + i))
+            return false;
+    return true;
+}
+
+/* Growing a slice must never overwrite the bytes of the previous ones */
+static void TestSliceRealloc()
+{
+    BlockPool *pool = new BlockPool(1024, 4);
+    block_t *p_block = pool->get();
+    assert(p_block);
+    p_block->i_buffer = 300;
+    for(size_t i = 0; i < p_block->i_buffer; i++)
+        p_block->p_buffer[i] = i;
+
+    block_t *p_first = BlockPool::slice(&p_block, 100);
+    assert(p_first);
+    block_t *p_second = BlockPool::slice(&p_block, 100);
+    assert(p_second);
+    assert(p_first->p_start == p_first->p_buffer && p_first->i_size == 100);
+    assert(p_second->p_start == p_second->p_buffer && p_second->i_size == 100);
+    assert(p_block->p_start == p_block->p_buffer);
+    assert(p_block->i_buffer == 100);
+
+    /* Last slice, then middle one, with a prebody */
+    p_block = block_Realloc(p_block, 16, p_block->i_buffer);
+    assert(p_block && p_block->i_buffer == 116);
+    memset(p_block->p_buffer, 0xAA, 16);
+    assert(CheckBytes(p_block->p_buffer + 16, 100, 200));
+
+    p_second = block_Realloc(p_second, 16, p_second->i_buffer);
+    assert(p_second && p_second->i_buffer == 116);
+    memset(p_second->p_buffer, 0xAA, 16);
+    assert(CheckBytes(p_second->p_buffer + 16, 100, 100));
+
+    assert(CheckBytes(p_first->p_buffer, 100, 0));
+
+    /* Only the last release gives the buffer back */
+    block_Release(p_second);
+    block_Release(p_block);
+    assert(CheckBytes(p_first->p_buffer, 100, 0));
+    block_Release(p_first);
+
+    pool->drop();
+}
+
+int main(void)
+{
+    TestSliceRealloc();
+    return 0;
+}
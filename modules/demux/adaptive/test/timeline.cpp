@@ -0,0 +1,176 @@
+/*
+ * timeline.cpp: SegmentTimeline lookup, merge and prune tests
+ *****************************************************************************
+ * Copyright (C) 2017 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+
+#include "playlist/SegmentTimeline.h"
+
+#undef NDEBUG
+#include <assert.h>
+
+using namespace adaptive::playlist;
+
+/*
+ * Segments 10-12 of 1000 at 0, 13-14 of 500 at 3000, then, after a gap,
+ * 15-17 of 1000 at 5000 (added as two runs that get merged).
+ */
+static void Fill(SegmentTimeline *timeline)
+{
+    timeline->addElement(10, 1000, 2, 0);
+    timeline->addElement(13, 500, 1);
+    timeline->addElement(15, 1000, 0, 5000);
+    timeline->addElement(16, 1000, 1, 6000);
+}
+
+static void CheckSegment(const SegmentTimeline *timeline, uint64_t number,
+                         stime_t time, stime_t duration)
+{
+    stime_t t, d;
+    assert(timeline->getScaledPlaybackTimeDurationBySegmentNumber(number, &t, &d));
+    assert(t == time);
+    assert(d == duration);
+}
+
+static void TestFindByNumber()
+{
+    SegmentTimeline timeline(1000);
+    Fill(&timeline);
+
+    assert(timeline.minElementNumber() == 10);
+    assert(timeline.maxElementNumber() == 17);
+
+    CheckSegment(&timeline, 9, 0, 1000); /* before the first one */
+    CheckSegment(&timeline, 10, 0, 1000);
+    CheckSegment(&timeline, 12, 2000, 1000); /* last repeat of a run */
+    CheckSegment(&timeline, 13, 3000, 500); /* first one of the next run */
+    CheckSegment(&timeline, 14, 3500, 500);
+    CheckSegment(&timeline, 15, 5000, 1000); /* after the gap */
+    CheckSegment(&timeline, 16, 6000, 1000); /* merged run */
+    CheckSegment(&timeline, 17, 7000, 1000);
+    CheckSegment(&timeline, 20, 8000, 1000); /* past the end */
+
+    assert(timeline.getMinAheadScaledTime(10) == 7000);
+    assert(timeline.getMinAheadScaledTime(15) == 2000);
+    assert(timeline.getMinAheadScaledTime(17) == 0);
+}
+
+static void TestFindByScaledTime()
+{
+    SegmentTimeline timeline(1000);
+    Fill(&timeline);
+
+    assert(timeline.getElementNumberByScaledPlaybackTime(-5) == 10);
+    assert(timeline.getElementNumberByScaledPlaybackTime(0) == 10);
+    assert(timeline.getElementNumberByScaledPlaybackTime(999) == 10);
+    assert(timeline.getElementNumberByScaledPlaybackTime(1000) == 11);
+    assert(timeline.getElementNumberByScaledPlaybackTime(2999) == 12);
+    assert(timeline.getElementNumberByScaledPlaybackTime(3000) == 13);
+    assert(timeline.getElementNumberByScaledPlaybackTime(3499) == 13);
+    assert(timeline.getElementNumberByScaledPlaybackTime(3500) == 14);
+    /* in the gap: the last segment before it */
+    assert(timeline.getElementNumberByScaledPlaybackTime(4500) == 14);
+    assert(timeline.getElementNumberByScaledPlaybackTime(5000) == 15);
+    assert(timeline.getElementNumberByScaledPlaybackTime(7999) == 17);
+    assert(timeline.getElementNumberByScaledPlaybackTime(100000) == 17);
+
+    SegmentTimeline empty(1000);
+    assert(empty.getElementNumberByScaledPlaybackTime(1000) == 0);
+}
+
+static void TestMergeWith()
+{
+    SegmentTimeline timeline(1000);
+    timeline.addElement(1, 1000, 4, 0); /* 1-5, up to 5000 */
+
+    /* A refresh overlapping in the middle of a run, with a gap and
+     * a duration change after it. Its numbers are not trusted. */
+    SegmentTimeline update(1000);
+    update.addElement(0, 1000, 0, 0);    /* already known */
+    update.addElement(1, 1000, 4, 3000); /* 3000-7000: 6-8 are new */
+    update.addElement(6, 1000, 0, 10000);
+    update.addElement(7, 500, 1, 11000);
+    timeline.mergeWith(update);
+
+    assert(timeline.minElementNumber() == 1);
+    assert(timeline.maxElementNumber() == 11);
+    CheckSegment(&timeline, 5, 4000, 1000);
+    CheckSegment(&timeline, 6, 5000, 1000); /* extends the run */
+    CheckSegment(&timeline, 8, 7000, 1000);
+    CheckSegment(&timeline, 9, 10000, 1000); /* after the gap */
+    CheckSegment(&timeline, 10, 11000, 500);
+    CheckSegment(&timeline, 11, 11500, 500);
+    assert(timeline.end() == 12 * CLOCK_FREQ);
+
+    /* Merging the same refresh again adds nothing */
+    SegmentTimeline same(1000);
+    same.addElement(7, 500, 1, 11000);
+    timeline.mergeWith(same);
+    assert(timeline.maxElementNumber() == 11);
+
+    /* An empty timeline takes everything */
+    SegmentTimeline empty(1000);
+    empty.mergeWith(timeline);
+    assert(empty.minElementNumber() == 1);
+    assert(empty.maxElementNumber() == 11);
+}
+
+static void TestPruneBySequenceNumber()
+{
+    SegmentTimeline timeline(1000);
+    Fill(&timeline);
+
+    assert(timeline.pruneBySequenceNumber(10) == 0);
+    assert(timeline.minElementNumber() == 10);
+
+    /* within a run */
+    assert(timeline.pruneBySequenceNumber(12) == 2);
+    assert(timeline.minElementNumber() == 12);
+    CheckSegment(&timeline, 12, 2000, 1000);
+
+    /* on a run boundary */
+    assert(timeline.pruneBySequenceNumber(13) == 1);
+    assert(timeline.minElementNumber() == 13);
+    CheckSegment(&timeline, 13, 3000, 500);
+
+    /* across a gap, into a repeated run */
+    assert(timeline.pruneBySequenceNumber(16) == 3);
+    assert(timeline.minElementNumber() == 16);
+    assert(timeline.maxElementNumber() == 17);
+    CheckSegment(&timeline, 16, 6000, 1000);
+    assert(timeline.start() == 6 * CLOCK_FREQ);
+
+    /* past the end */
+    assert(timeline.pruneBySequenceNumber(100) == 2);
+    assert(timeline.minElementNumber() == 0);
+    assert(timeline.maxElementNumber() == 0);
+}
+
+int main(void)
+{
+    TestFindByNumber();
+    TestFindByScaledTime();
+    TestMergeWith();
+    TestPruneBySequenceNumber();
+    return 0;
+}
@@ -26,6 +26,10 @@
 #endif
 
 #include "Helper.h"
+
+#include <vlc_common.h>
+#include <vlc_md5.h>
+
 #include <algorithm>
 using namespace adaptive;
 
@@ -90,3 +94,20 @@ std::list<std::string> Helper::tokenize(const std::string &str, char c)
     ret.push_back(str.substr(prev));
     return ret;
 }
+
+std::string Helper::md5(const void *data, std::size_t size)
+{
+    struct md5_s md5;
+    InitMD5(&md5);
+    AddMD5(&md5, data, size);
+    EndMD5(&md5);
+
+    std::string ret;
+    char *psz_hash = psz_md5_hash(&md5);
+    if(psz_hash)
+    {
+        ret = psz_hash;
+        free(psz_hash);
+    }
+    return ret;
+}
@@ -27,6 +27,7 @@
 
 #include <string>
 #include <list>
+#include <cstddef>
 
 namespace adaptive
 {
@@ -38,6 +39,7 @@ namespace adaptive
             static std::string getFileExtension (const std::string &uri);
             static bool        ifind            (std::string haystack, std::string needle);
             static std::list<std::string> tokenize(const std::string &, char);
+            static std::string md5              (const void *, std::size_t);
     };
 }
 
@@ -107,6 +107,14 @@ bool DASHManager::updatePlaylist()
         if(!p_block)
             return false;
 
+        /* Live MPD are often fetched again before anything changed */
+        const std::string digest = Helper::md5(p_block->p_buffer, p_block->i_buffer);
+        if(!digest.empty() && digest == mpdDigest)
+        {
+            block_Release(p_block);
+            return true;
+        }
+
         stream_t *mpdstream = vlc_stream_MemoryNew(p_demux, p_block->p_buffer, p_block->i_buffer, true);
         if(!mpdstream)
         {
@@ -138,6 +146,7 @@ bool DASHManager::updatePlaylist()
         {
             playlist->mergeWith(newmpd, minsegmentTime);
             delete newmpd;
+            mpdDigest = digest;
         }
         vlc_stream_Delete(mpdstream);
         block_Release(p_block);
@@ -44,6 +44,7 @@
 #include "../adaptive/tools/Debug.hpp"
 #include "../adaptive/tools/Conversions.hpp"
 #include <vlc_stream.h>
+#include <vlc_charset.h>
 #include <cstdio>
 
 using namespace dash::mpd;
@@ -155,6 +156,19 @@ void IsoffMainParser::parsePeriods(MPD *mpd, Node *root)
     }
 }
 
+/* Seconds, possibly "INF", clamped to the mtime_t range */
+static mtime_t parseAvailabilityTimeOffset(const std::string &value)
+{
+    if(value == "INF")
+        return INT64_MAX;
+    const double seconds = us_strtod(value.c_str(), NULL);
+    if(!(seconds > 0.0)) /* also NaN */
+        return 0;
+    if(seconds >= (double) INT64_MAX / CLOCK_FREQ)
+        return INT64_MAX;
+    return seconds * CLOCK_FREQ;
+}
+
 size_t IsoffMainParser::parseSegmentTemplate(Node *templateNode, SegmentInformation *info)
 {
     size_t total = 0;
@@ -176,6 +190,20 @@ size_t IsoffMainParser::parseSegmentTemplate(Node *templateNode, SegmentInformat
     if(templateNode->hasAttribute("duration"))
         mediaTemplate->duration.Set(Integer<stime_t>(templateNode->getAttributeValue("duration")));
 
+    if(templateNode->hasAttribute("availabilityTimeOffset"))
+    {
+        /* segments become available that much before their end, as they
+           are sent using chunked transfer while produced */
+        const mtime_t offset = parseAvailabilityTimeOffset(
+                    templateNode->getAttributeValue("availabilityTimeOffset"));
+        if(offset > 0)
+        {
+            mediaTemplate->availabilityTimeOffset.Set(offset);
+            if(info->getPlaylist()->isLive())
+                info->getPlaylist()->lowLatency.Set(true);
+        }
+    }
+
     InitSegmentTemplate *initTemplate = NULL;
 
     if(templateNode->hasAttribute("initialization"))
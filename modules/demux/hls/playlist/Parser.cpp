@@ -163,6 +163,15 @@ bool M3U8Parser::appendSegmentsFromPlaylistURI(vlc_object_t *p_obj, Representati
     block_t *p_block = Retrieve::HTTP(p_obj, rep->getPlaylistUrl().toString());
     if(p_block)
     {
+        /* Nothing to parse again if the playlist was not updated yet */
+        const std::string digest = Helper::md5(p_block->p_buffer, p_block->i_buffer);
+        if(rep->b_loaded && !digest.empty() && digest == rep->playlistDigest)
+        {
+            block_Release(p_block);
+            return true;
+        }
+        rep->playlistDigest = digest;
+
         stream_t *substream = vlc_stream_MemoryNew(p_obj, p_block->p_buffer, p_block->i_buffer, true);
         if(substream)
         {
@@ -183,6 +192,8 @@ void M3U8Parser::parseSegments(vlc_object_t *, Representation *rep, const std::l
 {
     SegmentList *segmentList = new (std::nothrow) SegmentList(rep);
 
+    /* On refresh, don't create the segments we already have again */
+    const bool b_refresh = rep->b_loaded;
     rep->setTimescale(100);
     rep->b_loaded = true;
 
@@ -225,6 +236,32 @@ void M3U8Parser::parseSegments(vlc_object_t *, Representation *rep, const std::l
                     break;
                 }
 
+                if(b_refresh && sequenceNumber <= rep->knownSequenceNumber)
+                {
+                    /* only keep the context going for the next ones */
+                    sequenceNumber++;
+                    const Attribute *attribute = ctx_extinf ? ctx_extinf->getAttributeByName("DURATION") : NULL;
+                    if(attribute)
+                    {
+                        const mtime_t nzDuration = CLOCK_FREQ * attribute->floatingPoint();
+                        nzStartTime += nzDuration;
+                        totalduration += nzDuration;
+                        if(absReferenceTime > VLC_TS_INVALID)
+                            absReferenceTime += nzDuration;
+                    }
+                    if(ctx_byterange)
+                    {
+                        std::pair<std::size_t,std::size_t> range = ctx_byterange->getValue().getByteRange();
+                        if(range.first == 0)
+                            range.first = prevbyterangeoffset;
+                        prevbyterangeoffset = range.first + range.second;
+                    }
+                    ctx_extinf = NULL;
+                    ctx_byterange = NULL;
+                    discontinuity = false;
+                    break;
+                }
+
                 HLSSegment *segment = new (std::nothrow) HLSSegment(rep, sequenceNumber++);
                 if(!segment)
                     break;
@@ -363,6 +400,9 @@ void M3U8Parser::parseSegments(vlc_object_t *, Representation *rep, const std::l
         }
     }
 
+    if(sequenceNumber > 0 && sequenceNumber - 1 > rep->knownSequenceNumber)
+        rep->knownSequenceNumber = sequenceNumber - 1;
+
     if(rep->isLive())
     {
         rep->getPlaylist()->duration.Set(0);
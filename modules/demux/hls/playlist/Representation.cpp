@@ -45,6 +45,7 @@ Representation::Representation  ( BaseAdaptationSet *set ) :
     switchpolicy = SegmentInformation::SWITCH_SEGMENT_ALIGNED; /* FIXME: based on streamformat */
     nextUpdateTime = 0;
     targetDuration = 0;
+    knownSequenceNumber = 0;
     streamFormat = StreamFormat::UNKNOWN;
 }
 
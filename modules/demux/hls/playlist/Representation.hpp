@@ -60,6 +60,8 @@ namespace hls
                 time_t nextUpdateTime;
                 time_t targetDuration;
                 Url playlistUrl;
+                std::string playlistDigest;
+                uint64_t knownSequenceNumber; /* highest parsed, valid once b_loaded */
         };
     }
 }
@@ -0,0 +1,157 @@
+/*****************************************************************************
+ * metadata_importer.cpp : Batch preparser helper for the Extended Metadata
+ * Manager
+ ****************************************************************************
+ * Copyright (C) 2017 Asier Santos Valcárcel
+ * Authors: Asier Santos Valcárcel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "qt.hpp"
+#include "adapters/metadata_importer.hpp"
+
+#include <QApplication>
+
+/* Rows are inserted at most this many at a time... */
+#define IMPORT_BATCH_SIZE 256
+/* ...or after this delay (ms), whichever comes first */
+#define IMPORT_FLUSH_DELAY 100
+
+const QEvent::Type MetadataImporterEvent::PreparsedEvent =
+        (QEvent::Type)QEvent::registerEventType();
+
+MetadataImporter::MetadataImporter( intf_thread_t *_p_intf, QObject *parent )
+    : QObject( parent ), p_intf( _p_intf )
+{
+    Q_ASSERT( p_intf );
+    flushTimer.setSingleShot( true );
+    flushTimer.setInterval( IMPORT_FLUSH_DELAY );
+    CONNECT( &flushTimer, timeout(), this, flush() );
+}
+
+MetadataImporter::~MetadataImporter()
+{
+    cancel();
+}
+
+/* Creates one item per URI and pushes all of them to the preparser. Returns
+ * the number of items actually submitted */
+int MetadataImporter::enqueue( const QStringList &uris )
+{
+    int i_submitted = 0;
+
+    foreach( const QString &uri, uris )
+    {
+        input_item_t *p_item = input_item_New( qtu( uri ), "" );
+        if( unlikely( p_item == NULL ) )
+            continue;
+
+        /* Listen before requesting: skipped/failed items are signalled from
+         * within libvlc_MetadataRequest itself */
+        if( vlc_event_attach( &p_item->event_manager, vlc_InputItemPreparseEnded,
+                              preparseEnded, this ) != VLC_SUCCESS )
+        {
+            input_item_Release( p_item );
+            continue;
+        }
+        pending.append( p_item );
+
+        if( libvlc_MetadataRequest( p_intf->obj.libvlc, p_item,
+                                    META_REQUEST_OPTION_SCOPE_ANY, -1,
+                                    this ) != VLC_SUCCESS )
+        {
+            pending.removeOne( p_item );
+            detach( p_item );
+            input_item_Release( p_item );
+            continue;
+        }
+        i_submitted++;
+    }
+
+    return i_submitted;
+}
+
+/* Drops every request still in flight, and any result not delivered yet */
+void MetadataImporter::cancel()
+{
+    flushTimer.stop();
+
+    libvlc_MetadataCancel( p_intf->obj.libvlc, this );
+
+    foreach( input_item_t *p_item, pending )
+    {
+        detach( p_item );
+        input_item_Release( p_item );
+    }
+    pending.clear();
+
+    foreach( input_item_t *p_item, ready )
+        input_item_Release( p_item );
+    ready.clear();
+}
+
+/* Called from the preparser thread: only hand the item over to the GUI */
+void MetadataImporter::preparseEnded( const vlc_event_t *p_event, void *param )
+{
+    MetadataImporter *me = (MetadataImporter *) param;
+    input_item_t *p_item = (input_item_t *) p_event->p_obj;
+    QApplication::postEvent( me, new MetadataImporterEvent( p_item ) );
+}
+
+void MetadataImporter::customEvent( QEvent *event )
+{
+    if( event->type() != MetadataImporterEvent::PreparsedEvent )
+        return;
+
+    MetadataImporterEvent *ev = static_cast<MetadataImporterEvent *>( event );
+    input_item_t *p_item = ev->item();
+
+    /* Stale event, posted before a cancel() */
+    if( !pending.removeOne( p_item ) )
+        return;
+
+    detach( p_item );
+    ready.append( p_item );
+
+    if( ready.count() >= IMPORT_BATCH_SIZE || pending.isEmpty() )
+        flush();
+    else if( !flushTimer.isActive() )
+        flushTimer.start();
+}
+
+void MetadataImporter::flush()
+{
+    flushTimer.stop();
+
+    if( !ready.isEmpty() )
+    {
+        QVector<input_item_t *> batch;
+        batch.swap( ready );
+        emit itemsReady( batch );
+    }
+
+    if( pending.isEmpty() )
+        emit finished();
+}
+
+void MetadataImporter::detach( input_item_t *p_item )
+{
+    vlc_event_detach( &p_item->event_manager, vlc_InputItemPreparseEnded,
+                      preparseEnded, this );
+}
@@ -0,0 +1,99 @@
+/*****************************************************************************
+ * metadata_importer.hpp : Batch preparser helper for the Extended Metadata
+ * Manager
+ ****************************************************************************
+ * Copyright (C) 2017 Asier Santos Valcárcel
+ * Authors: Asier Santos Valcárcel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+#ifndef METADATA_IMPORTER_HPP
+#define METADATA_IMPORTER_HPP
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <QObject>
+#include <QEvent>
+#include <QList>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+
+#include <vlc_common.h>
+#include <vlc_events.h>
+#include <vlc_input_item.h>
+#include <vlc_interface.h>
+
+/* Posted from the preparser thread to the GUI thread when an item is done */
+class MetadataImporterEvent : public QEvent
+{
+public:
+    static const QEvent::Type PreparsedEvent;
+
+    MetadataImporterEvent( input_item_t *_p_item )
+        : QEvent( PreparsedEvent ), p_item( _p_item )
+    {
+        input_item_Hold( p_item );
+    }
+    virtual ~MetadataImporterEvent()
+    {
+        input_item_Release( p_item );
+    }
+
+    input_item_t *item() const { return p_item; }
+
+private:
+    input_item_t *p_item;
+};
+
+/* Submits a whole set of URIs to the core preparser at once and hands the
+ * preparsed items back in batches, so the caller can insert many rows at a
+ * time without ever blocking the GUI thread. */
+class MetadataImporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    MetadataImporter( intf_thread_t *p_intf, QObject *parent = NULL );
+    virtual ~MetadataImporter();
+
+    int enqueue( const QStringList &uris );
+    void cancel();
+    int pendingCount() const { return pending.count(); }
+
+    static void preparseEnded( const vlc_event_t *p_event, void *param );
+
+signals:
+    /* The receiver takes ownership of the items' references */
+    void itemsReady( const QVector<input_item_t *> &items );
+    void finished();
+
+protected:
+    void customEvent( QEvent * ) Q_DECL_OVERRIDE;
+
+private slots:
+    void flush();
+
+private:
+    void detach( input_item_t *p_item );
+
+    intf_thread_t *p_intf;
+    QList<input_item_t *> pending;   /* submitted, not yet preparsed */
+    QVector<input_item_t *> ready;   /* preparsed, not yet delivered */
+    QTimer flushTimer;
+};
+
+#endif // METADATA_IMPORTER_HPP
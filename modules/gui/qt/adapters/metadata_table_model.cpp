@@ -0,0 +1,322 @@
+/*****************************************************************************
+ * metadata_table_model.cpp : Table model and delegate for the Extended
+ * Metadata Manager
+ ****************************************************************************
+ * Copyright (C) 2017 Asier Santos Valcárcel
+ * Authors: Asier Santos Valcárcel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "qt.hpp"
+#include "adapters/metadata_table_model.hpp"
+
+#include <QApplication>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QStyle>
+#include <QStyleOptionButton>
+
+/* Meta shown on a column, for the columns where isMetaColumn is true */
+static vlc_meta_type_t columnMeta( int column )
+{
+    switch( column )
+    {
+    case COL_ARTIST:    return vlc_meta_Artist;
+    case COL_ALBUM:     return vlc_meta_Album;
+    case COL_GENRE:     return vlc_meta_Genre;
+    case COL_TRACKNUM:  return vlc_meta_TrackNumber;
+    case COL_PUBLISHER: return vlc_meta_Publisher;
+    case COL_COPYRIGHT: return vlc_meta_Copyright;
+    default:            return vlc_meta_Title;
+    }
+}
+
+MetadataTableModel::MetadataTableModel( vlc_array_t *_workspace, QObject *parent )
+    : QAbstractTableModel( parent ), workspace( _workspace )
+{
+}
+
+bool MetadataTableModel::isMetaColumn( int column )
+{
+    return column >= COL_TITLE && column <= COL_COPYRIGHT;
+}
+
+int MetadataTableModel::rowCount( const QModelIndex &parent ) const
+{
+    if( parent.isValid() )
+        return 0;
+    return vlc_array_count( workspace );
+}
+
+int MetadataTableModel::columnCount( const QModelIndex &parent ) const
+{
+    if( parent.isValid() )
+        return 0;
+    return COL_COUNT;
+}
+
+input_item_t *MetadataTableModel::item( int row ) const
+{
+    return (input_item_t *) vlc_array_item_at_index( workspace, row );
+}
+
+QVariant MetadataTableModel::data( const QModelIndex &index, int role ) const
+{
+    if( !index.isValid() )
+        return QVariant();
+
+    int row = index.row();
+    int column = index.column();
+
+    switch( role )
+    {
+    case Qt::CheckStateRole:
+        if( column == COL_CHECKBOX )
+            return isChecked( row ) ? Qt::Checked : Qt::Unchecked;
+        break;
+
+    case Qt::ToolTipRole:
+        if( !toolTips[column].isEmpty() )
+            return toolTips[column];
+        break;
+
+    case Qt::DisplayRole:
+    case Qt::EditRole:
+        if( isMetaColumn( column ) )
+        {
+            QHash<int, QMap<int, QString> >::const_iterator it = edits.find( row );
+            if( it != edits.end() && it->contains( column ) )
+                return it->value( column );
+
+            char *psz_meta = input_item_GetMeta( item( row ), columnMeta( column ) );
+            QString text = qfu( psz_meta );
+            free( psz_meta );
+            return text;
+        }
+        if( column == COL_PATH )
+        {
+            char *psz_uri = input_item_GetURI( item( row ) );
+            QString uri = qfu( psz_uri );
+            free( psz_uri );
+            return uri;
+        }
+        if( column == COL_ARTWORK && role == Qt::DisplayRole )
+            return qtr( "Change" );
+        break;
+    }
+    return QVariant();
+}
+
+QVariant MetadataTableModel::headerData( int section, Qt::Orientation orientation,
+                                         int role ) const
+{
+    if( orientation != Qt::Horizontal || role != Qt::DisplayRole )
+        return QAbstractTableModel::headerData( section, orientation, role );
+
+    switch( section )
+    {
+    case COL_TITLE:     return qtr( "Title" );
+    case COL_ARTIST:    return qtr( "Artist" );
+    case COL_ALBUM:     return qtr( "Album" );
+    case COL_GENRE:     return qtr( "Genre" );
+    case COL_TRACKNUM:  return qtr( "Track #" );
+    case COL_PUBLISHER: return qtr( "Publisher" );
+    case COL_COPYRIGHT: return qtr( "Copyright" );
+    case COL_ARTWORK:   return qtr( "Artwork" );
+    case COL_PATH:      return qtr( "Path" );
+    default:            return QString();
+    }
+}
+
+Qt::ItemFlags MetadataTableModel::flags( const QModelIndex &index ) const
+{
+    if( !index.isValid() )
+        return Qt::NoItemFlags;
+
+    switch( index.column() )
+    {
+    case COL_CHECKBOX:
+        return Qt::ItemIsEnabled | Qt::ItemIsUserCheckable;
+    case COL_ARTWORK:
+        return Qt::ItemIsEnabled;
+    case COL_PATH:
+        return Qt::NoItemFlags; // Make the path not selectable/editable
+    default:
+        return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsEditable;
+    }
+}
+
+bool MetadataTableModel::setData( const QModelIndex &index, const QVariant &value,
+                                  int role )
+{
+    if( !index.isValid() )
+        return false;
+
+    if( role == Qt::CheckStateRole && index.column() == COL_CHECKBOX )
+    {
+        checked.setBit( index.row(), value.toInt() == Qt::Checked );
+        emit dataChanged( index, index );
+        return true;
+    }
+
+    if( role == Qt::EditRole && isMetaColumn( index.column() ) )
+    {
+        setText( index, value.toString() );
+        emit edited( index );
+        return true;
+    }
+    return false;
+}
+
+/* Adds rows for the items, which the workspace takes over. New rows are
+ * checked */
+void MetadataTableModel::appendItems( const QVector<input_item_t *> &items )
+{
+    if( items.isEmpty() )
+        return;
+
+    int first = rowCount();
+    int last = first + items.count() - 1;
+
+    beginInsertRows( QModelIndex(), first, last );
+    foreach( input_item_t *p_item, items )
+        vlc_array_append( workspace, p_item );
+    checked.resize( last + 1 );
+    checked.fill( true, first, last + 1 );
+    endInsertRows();
+}
+
+/* Removes all the rows, releasing the workspace's items */
+void MetadataTableModel::clear()
+{
+    beginResetModel();
+    for( size_t i = 0; i < vlc_array_count( workspace ); i++ )
+        input_item_Release( (input_item_t *) vlc_array_item_at_index( workspace, i ) );
+    vlc_array_clear( workspace );
+    checked.clear();
+    edits.clear();
+    endResetModel();
+}
+
+/* Changes a cell's text, without notifying it as a user edit */
+void MetadataTableModel::setText( const QModelIndex &index, const QString &text )
+{
+    if( !index.isValid() || !isMetaColumn( index.column() ) )
+        return;
+
+    edits[index.row()].insert( index.column(), text );
+    emit dataChanged( index, index );
+}
+
+/* The row's fields whose text differs from the item's metadata */
+QMap<vlc_meta_type_t, QString> MetadataTableModel::editedFields( int row ) const
+{
+    QMap<vlc_meta_type_t, QString> fields;
+    QMap<int, QString> rowEdits = edits.value( row );
+
+    QMapIterator<int, QString> it( rowEdits );
+    while( it.hasNext() )
+    {
+        it.next();
+        vlc_meta_type_t type = columnMeta( it.key() );
+        char *psz_meta = input_item_GetMeta( item( row ), type );
+        if( it.value() != qfu( psz_meta ) )
+            fields.insert( type, it.value() );
+        free( psz_meta );
+    }
+    return fields;
+}
+
+/* Shows the item's metadata again on the row, e.g. once it changed */
+void MetadataTableModel::refreshRow( int row )
+{
+    edits.remove( row );
+    emit dataChanged( index( row, 0 ), index( row, COL_COUNT - 1 ) );
+}
+
+void MetadataTableModel::discardEdits()
+{
+    if( edits.isEmpty() )
+        return;
+
+    edits.clear();
+    emit dataChanged( index( 0, 0 ), index( rowCount() - 1, COL_COUNT - 1 ) );
+}
+
+void MetadataTableModel::setColumnToolTip( int column, const QString &tip )
+{
+    toolTips[column] = tip;
+}
+
+MetadataTableDelegate::MetadataTableDelegate( QObject *parent )
+    : QStyledItemDelegate( parent )
+{
+}
+
+void MetadataTableDelegate::paint( QPainter *painter,
+                                   const QStyleOptionViewItem &option,
+                                   const QModelIndex &index ) const
+{
+    if( index.column() != COL_ARTWORK )
+    {
+        QStyledItemDelegate::paint( painter, option, index );
+        return;
+    }
+
+    QStyleOptionButton button;
+    button.rect = option.rect;
+    button.text = index.data().toString();
+    button.state = QStyle::State_Enabled;
+    button.state |= ( index == pressed ) ? QStyle::State_Sunken
+                                         : QStyle::State_Raised;
+
+    const QWidget *widget = option.widget;
+    QStyle *style = widget ? widget->style() : QApplication::style();
+    style->drawControl( QStyle::CE_PushButton, &button, painter, widget );
+}
+
+bool MetadataTableDelegate::editorEvent( QEvent *event, QAbstractItemModel *model,
+                                         const QStyleOptionViewItem &option,
+                                         const QModelIndex &index )
+{
+    if( index.column() != COL_ARTWORK )
+        return QStyledItemDelegate::editorEvent( event, model, option, index );
+
+    switch( event->type() )
+    {
+    case QEvent::MouseButtonPress:
+    case QEvent::MouseButtonDblClick:
+        pressed = index;
+        return true;
+
+    case QEvent::MouseButtonRelease:
+    {
+        QMouseEvent *mouseEvent = static_cast<QMouseEvent *>( event );
+        bool b_clicked = ( index == pressed )
+                      && option.rect.contains( mouseEvent->pos() );
+        pressed = QPersistentModelIndex();
+        if( b_clicked )
+            emit buttonClicked( index.row() );
+        return true;
+    }
+
+    default:
+        return false;
+    }
+}
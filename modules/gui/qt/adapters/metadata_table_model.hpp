@@ -0,0 +1,125 @@
+/*****************************************************************************
+ * metadata_table_model.hpp : Table model and delegate for the Extended
+ * Metadata Manager
+ ****************************************************************************
+ * Copyright (C) 2017 Asier Santos Valcárcel
+ * Authors: Asier Santos Valcárcel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+#ifndef METADATA_TABLE_MODEL_HPP
+#define METADATA_TABLE_MODEL_HPP
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+//aliases for the table's columns' name
+#define COL_CHECKBOX 0
+#define COL_TITLE 1
+#define COL_ARTIST 2
+#define COL_ALBUM 3
+#define COL_GENRE 4
+#define COL_TRACKNUM 5
+#define COL_PUBLISHER 6
+#define COL_COPYRIGHT 7
+#define COL_ARTWORK 8
+#define COL_PATH 9
+#define COL_COUNT 10
+
+#include <QAbstractTableModel>
+#include <QStyledItemDelegate>
+#include <QBitArray>
+#include <QHash>
+#include <QMap>
+#include <QString>
+#include <QVector>
+
+#include <vlc_common.h>
+#include <vlc_arrays.h>
+#include <vlc_input_item.h>
+#include <vlc_meta.h>
+
+/* Rows of the metadata table, over the items of the workspace array (row X
+ * is the item at position X). Nothing is copied from the items: the cells
+ * are read from them when the view asks for them, and only the user's
+ * unsaved edits and the checkboxes are stored here. */
+class MetadataTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    MetadataTableModel( vlc_array_t *workspace, QObject *parent = NULL );
+
+    int rowCount( const QModelIndex &parent = QModelIndex() ) const Q_DECL_OVERRIDE;
+    int columnCount( const QModelIndex &parent = QModelIndex() ) const Q_DECL_OVERRIDE;
+    QVariant data( const QModelIndex &index, int role ) const Q_DECL_OVERRIDE;
+    QVariant headerData( int section, Qt::Orientation orientation,
+                         int role ) const Q_DECL_OVERRIDE;
+    Qt::ItemFlags flags( const QModelIndex &index ) const Q_DECL_OVERRIDE;
+    bool setData( const QModelIndex &index, const QVariant &value,
+                  int role ) Q_DECL_OVERRIDE;
+
+    void appendItems( const QVector<input_item_t *> &items );
+    void clear();
+    input_item_t *item( int row ) const;
+
+    bool isChecked( int row ) const { return checked.testBit( row ); }
+    int checkedCount() const { return checked.count( true ); }
+
+    void setText( const QModelIndex &index, const QString &text );
+    QMap<vlc_meta_type_t, QString> editedFields( int row ) const;
+    void refreshRow( int row );
+    void discardEdits();
+
+    void setColumnToolTip( int column, const QString &tip );
+
+    static bool isMetaColumn( int column );
+
+signals:
+    /* A cell was edited by the user, as opposed to setText */
+    void edited( const QModelIndex &index );
+
+private:
+    vlc_array_t *workspace;
+    QBitArray checked;
+    QHash<int, QMap<int, QString> > edits; /* unsaved text, by row and column */
+    QString toolTips[COL_COUNT];
+};
+
+/* Paints the artwork column as a push button, instead of creating a widget
+ * on each row. The checkboxes are painted by the base class. */
+class MetadataTableDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+
+public:
+    MetadataTableDelegate( QObject *parent = NULL );
+
+    void paint( QPainter *painter, const QStyleOptionViewItem &option,
+                const QModelIndex &index ) const Q_DECL_OVERRIDE;
+
+protected:
+    bool editorEvent( QEvent *event, QAbstractItemModel *model,
+                      const QStyleOptionViewItem &option,
+                      const QModelIndex &index ) Q_DECL_OVERRIDE;
+
+signals:
+    void buttonClicked( int row );
+
+private:
+    QPersistentModelIndex pressed;
+};
+
+#endif // METADATA_TABLE_MODEL_HPP
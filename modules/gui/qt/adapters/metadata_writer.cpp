@@ -0,0 +1,219 @@
+/*****************************************************************************
+ * metadata_writer.cpp : Bulk metadata writer for the Extended Metadata
+ * Manager
+ ****************************************************************************
+ * Copyright (C) 2017 Asier Santos Valcárcel
+ * Authors: Asier Santos Valcárcel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "qt.hpp"
+#include "adapters/metadata_writer.hpp"
+
+#include <QApplication>
+#include <QHash>
+
+const QEvent::Type MetadataWriterEvent::WrittenEvent =
+        (QEvent::Type)QEvent::registerEventType();
+
+MetadataWriter::MetadataWriter( intf_thread_t *_p_intf, QObject *parent )
+    : QObject( parent ), p_intf( _p_intf ), b_running( false ),
+      b_worker( false ), i_pending( 0 ), i_failures( 0 ),
+      i_written( 0 )
+{
+    Q_ASSERT( p_intf );
+    vlc_mutex_init( &lock );
+}
+
+MetadataWriter::~MetadataWriter()
+{
+    cancel();
+    vlc_mutex_destroy( &lock );
+}
+
+/* Queues the changes, one job per file, and starts the worker if needed.
+ * Returns the number of items queued */
+int MetadataWriter::write( const QVector<MetadataChange> &changes )
+{
+    QHash<QString, Job *> jobs;
+    QList<Job *> order;
+    int i_queued = 0;
+
+    foreach( const MetadataChange &change, changes )
+    {
+        char *psz_uri = input_item_GetURI( change.p_item );
+        if( unlikely( psz_uri == NULL ) )
+            continue;
+        QString uri = qfu( psz_uri );
+        free( psz_uri );
+
+        Job *job = jobs.value( uri );
+        if( !job )
+        {
+            job = new Job;
+            jobs.insert( uri, job );
+            order.append( job );
+        }
+        input_item_Hold( change.p_item );
+        job->append( change );
+        i_queued++;
+    }
+
+    if( order.isEmpty() )
+        return 0;
+    i_pending += i_queued;
+
+    vlc_mutex_lock( &lock );
+    queue.append( order );
+    bool b_start = !b_running;
+    b_running = true;
+    vlc_mutex_unlock( &lock );
+
+    if( b_start )
+    {
+        joinWorker(); /* the previous worker, if any, is done */
+        if( vlc_clone( &worker, Run, this, VLC_THREAD_PRIORITY_LOW ) )
+        {
+            msg_Err( p_intf, "cannot start the metadata writer thread" );
+
+            vlc_mutex_lock( &lock );
+            QList<Job *> failed;
+            failed.swap( queue );
+            b_running = false;
+            vlc_mutex_unlock( &lock );
+
+            /* Report every item as failed, rather than block the GUI */
+            foreach( Job *job, failed )
+            {
+                foreach( const MetadataChange &change, *job )
+                {
+                    QApplication::postEvent( this,
+                        new MetadataWriterEvent( change.p_item, false, 0 ) );
+                    input_item_Release( change.p_item );
+                }
+                delete job;
+            }
+        }
+        else
+            b_worker = true;
+    }
+
+    return i_queued;
+}
+
+/* Drops the changes not being written yet, waits for the files being
+ * written, and forgets about any result not delivered yet */
+void MetadataWriter::cancel()
+{
+    vlc_mutex_lock( &lock );
+    QList<Job *> dropped;
+    dropped.swap( queue );
+    vlc_mutex_unlock( &lock );
+
+    foreach( Job *job, dropped )
+    {
+        foreach( const MetadataChange &change, *job )
+            input_item_Release( change.p_item );
+        delete job;
+    }
+
+    joinWorker();
+    QCoreApplication::removePostedEvents( this, MetadataWriterEvent::WrittenEvent );
+    i_pending = 0;
+    i_failures = 0;
+    i_written = 0;
+}
+
+/* Called from the writer thread */
+void *MetadataWriter::Run( void *data )
+{
+    MetadataWriter *me = (MetadataWriter *) data;
+
+    for( ;; )
+    {
+        vlc_mutex_lock( &me->lock );
+        if( me->queue.isEmpty() )
+        {
+            me->b_running = false;
+            vlc_mutex_unlock( &me->lock );
+            return NULL;
+        }
+        Job *job = me->queue.takeFirst();
+        vlc_mutex_unlock( &me->lock );
+
+        me->process( job );
+        delete job;
+    }
+}
+
+void MetadataWriter::process( Job *job )
+{
+    foreach( const MetadataChange &change, *job )
+    {
+        input_item_t *p_item = change.p_item;
+
+        QMapIterator<vlc_meta_type_t, QString> it( change.fields );
+        while( it.hasNext() )
+        {
+            it.next();
+            input_item_SetMeta( p_item, it.key(), qtu( it.value() ) );
+        }
+
+        /* The meta writer opens the file once, for all the fields */
+        uint64_t i_item_written;
+        bool b_success = input_item_WriteMetaExt( VLC_OBJECT(p_intf), p_item,
+                                            &i_item_written ) == VLC_SUCCESS;
+        QApplication::postEvent( this, new MetadataWriterEvent( p_item,
+                                                b_success, i_item_written ) );
+        input_item_Release( p_item );
+    }
+}
+
+void MetadataWriter::customEvent( QEvent *event )
+{
+    if( event->type() != MetadataWriterEvent::WrittenEvent )
+        return;
+
+    MetadataWriterEvent *ev = static_cast<MetadataWriterEvent *>( event );
+
+    if( !ev->success() )
+        i_failures++;
+    else if( ev->written() != UINT64_MAX )
+        i_written += ev->written();
+    emit itemWritten( ev->item(), ev->success() );
+
+    if( --i_pending > 0 )
+        return;
+
+    /* The worker is done, or about to be */
+    joinWorker();
+    int i_total_failures = i_failures;
+    quint64 i_total_written = i_written;
+    i_failures = 0;
+    i_written = 0;
+    emit finished( i_total_failures, i_total_written );
+}
+
+void MetadataWriter::joinWorker()
+{
+    if( !b_worker )
+        return;
+    vlc_join( worker, NULL );
+    b_worker = false;
+}
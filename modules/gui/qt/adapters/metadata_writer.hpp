@@ -0,0 +1,121 @@
+/*****************************************************************************
+ * metadata_writer.hpp : Bulk metadata writer for the Extended Metadata
+ * Manager
+ ****************************************************************************
+ * Copyright (C) 2017 Asier Santos Valcárcel
+ * Authors: Asier Santos Valcárcel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+#ifndef METADATA_WRITER_HPP
+#define METADATA_WRITER_HPP
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <QObject>
+#include <QEvent>
+#include <QList>
+#include <QMap>
+#include <QString>
+#include <QVector>
+
+#include <vlc_common.h>
+#include <vlc_input_item.h>
+#include <vlc_interface.h>
+#include <vlc_meta.h>
+
+/* One item to save, with the new value of each field that was edited */
+struct MetadataChange
+{
+    input_item_t *p_item;
+    QMap<vlc_meta_type_t, QString> fields;
+};
+
+/* Posted from a writer thread to the GUI thread when an item is saved */
+class MetadataWriterEvent : public QEvent
+{
+public:
+    static const QEvent::Type WrittenEvent;
+
+    MetadataWriterEvent( input_item_t *_p_item, bool _b_success,
+                         uint64_t _i_written )
+        : QEvent( WrittenEvent ), p_item( _p_item ), b_success( _b_success ),
+          i_written( _i_written )
+    {
+        input_item_Hold( p_item );
+    }
+    virtual ~MetadataWriterEvent()
+    {
+        input_item_Release( p_item );
+    }
+
+    input_item_t *item() const { return p_item; }
+    bool success() const { return b_success; }
+    uint64_t written() const { return i_written; } /* UINT64_MAX if unknown */
+
+private:
+    input_item_t *p_item;
+    bool b_success;
+    uint64_t i_written;
+};
+
+/* Applies a batch of edits and writes the items back to their files from a
+ * worker thread, so that saving never blocks the GUI thread.
+ * All the edits of a file go through a single meta writer call.
+ * A single worker is enough: the TagLib meta writer serializes all the
+ * files behind one lock anyway. */
+class MetadataWriter : public QObject
+{
+    Q_OBJECT
+
+public:
+    MetadataWriter( intf_thread_t *p_intf, QObject *parent = NULL );
+    virtual ~MetadataWriter();
+
+    int write( const QVector<MetadataChange> &changes );
+    void cancel();
+    int pendingCount() const { return i_pending; }
+
+signals:
+    void itemWritten( input_item_t *p_item, bool success );
+    /* written: bytes written to the files, as far as the meta writer knows */
+    void finished( int failures, quint64 written );
+
+protected:
+    void customEvent( QEvent * ) Q_DECL_OVERRIDE;
+
+private:
+    /* The changes for one file */
+    typedef QVector<MetadataChange> Job;
+
+    static void *Run( void * );
+    void process( Job *job );
+    void joinWorker();
+
+    intf_thread_t *p_intf;
+
+    vlc_mutex_t lock;
+    QList<Job *> queue;       /* not picked by the worker yet (lock) */
+    bool b_running;           /* worker not done yet (lock) */
+
+    vlc_thread_t worker;
+    bool b_worker;            /* worker to join */
+    int i_pending;            /* items not reported yet */
+    int i_failures;
+    quint64 i_written;
+};
+
+#endif // METADATA_WRITER_HPP
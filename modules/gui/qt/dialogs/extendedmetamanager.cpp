@@ -26,6 +26,7 @@
 #include "components/interface_widgets.hpp"     // CoverArtLabelExt
 #include "dialogs/fingerprintdialog.hpp"        // fingerprinting dialog
 #include "adapters/chromaprint.hpp"             // fingerprinting adapter (no UI)
+#include "adapters/metadata_importer.hpp"       // asynchronous batch preparser
 
 #include <QMessageBox>
 
@@ -35,13 +36,35 @@ ExtMetaManagerDialog::ExtMetaManagerDialog( intf_thread_t *_p_intf)
                : QVLCDialog( (QWidget*)_p_intf->p_sys->p_mi, _p_intf )
 {
     msg_Dbg( p_intf, "[EMM_Dialog] Initializing" );
-    configureWindow();
+    vlc_mutex_init( &reaperLock );
+    vlc_cond_init( &reaperWait );
+    reaperStarted = reaperQuit = false;
     initializeWorkspace();
+    configureWindow();
     QVLCTools::restoreWidgetPosition( p_intf, "ExtMetaManagerDialog", this );
 }
 
 ExtMetaManagerDialog::~ExtMetaManagerDialog() {
     msg_Dbg( p_intf, "[EMM_Dialog] Destroying" );
+    /* Stops the importer, writer and search, and releases the items */
+    resetEnvironment();
+
+    /* Wait for the cancelled fingerprinters to be destroyed */
+    if (reaperStarted)
+    {
+        vlc_mutex_lock( &reaperLock );
+        reaperQuit = true;
+        vlc_cond_signal( &reaperWait );
+        vlc_mutex_unlock( &reaperLock );
+        vlc_join( reaper, NULL );
+    }
+    vlc_cond_destroy( &reaperWait );
+    vlc_mutex_destroy( &reaperLock );
+
+    /* The model reads the workspace: drop it first */
+    delete model;
+    vlc_array_clear( workspace );
+    delete workspace;
     QVLCTools::saveWidgetPosition( p_intf, "ExtMetaManagerDialog", this );
 }
 
@@ -72,50 +95,38 @@ void ExtMetaManagerDialog::close() {
 }
 
 /* Loads files into the table from the current playlist */
-void ExtMetaManagerDialog::getFromPlaylist() { //TODO: clean this method
+void ExtMetaManagerDialog::getFromPlaylist() {
     msg_Dbg( p_intf, "[EMM_Dialog] getFromPlaylist" );
     resetEnvironment();
 
-    /* Lock the playlist so we can work with it */
+    /* Copy everything needed from the playlist at once, so that the
+    playlist is locked only once however big it is */
     playlist_Lock(THEPL);
+    playlist_snapshot_t *p_snapshot = playlist_NodeSnapshot(THEPL, THEPL->p_playing);
+    playlist_Unlock(THEPL);
 
-    /* Get the size of the playlist and if no files selected, finish */
-    int size = THEPL->items.i_size;
-
-    if( size ==0 ) {
-        playlist_Unlock(THEPL);
+    if (p_snapshot == NULL)
         return;
-    }
 
-    input_item_t *p_item;  //This is where each item will be stored
-    int row; //This is where each item's position will be stored
-
-    for(int i = 4;  i <= size+3; i++) //the list starts at 4 because the first 3 are not files
+    QVector<input_item_t *> items;
+    items.reserve(p_snapshot->i_count);
+    for (size_t i = 0; i < p_snapshot->i_count; i++)
     {
-        p_item = playlist_ItemGetById(THEPL, i)->p_input; // Get the playlist_item's input_item_t
-
-        if (isAudioFile(input_item_GetURI(p_item)))
-        {
-            addTableEntry(p_item); //add item to the table
-
-            /*Now we get the size of the table and store the item on that position
-            on the workspace array, so item at row X on the table is also stored at
-            array position X*/
-            row = ui.tableWidget_metadata->rowCount();
-            vlc_array_insert(workspace, p_item, row-1);
-        }
+        const playlist_snapshot_entry_t *p_entry = &p_snapshot->p_entries[i];
+        if (p_entry->psz_uri && isAudioFile(p_entry->psz_uri))
+            items.append(input_item_Hold(p_entry->p_input));
     }
+    playlist_SnapshotRelease(p_snapshot);
 
+    /* Item at row X on the table is also stored at workspace position X */
+    model->appendItems(items);
 
     if (tableIsEmpty()) {
         launchEmptyPlaylistDialog();
     } else {
-        ui.tableWidget_metadata->setCurrentCell(0,1);
+        ui.tableView_metadata->setCurrentIndex(model->index(0, COL_TITLE));
         updateArtworkInUI(0,0);
     }
-
-    /* Always unlock the playlist */
-    playlist_Unlock(THEPL);
 }
 
 /* Loads files into the table from a file explorer window */
@@ -129,28 +140,15 @@ void ExtMetaManagerDialog::getFromFolder() { //TODO: clean this method
 
     resetEnvironment();
 
-    int row; //This is where each item's position will be stored
-
+    QStringList audioUris;
     foreach( const QString &uri, uris ) {
-        if (isAudioFile(uri.toLatin1().constData())) {
-            // Get the item from the URI
-            input_item_t *p_item = createItemFromURI(uri.toLatin1().constData());
-
-            addTableEntry(p_item); //Add the item to the table
-
-            /*Now we get the size of the table and store the item on that position
-            on the workspace array, so item at row X on the table is also stored at
-            array position X*/
-            row = ui.tableWidget_metadata->rowCount();
-            vlc_array_insert(workspace, p_item, row-1);
-        }
+        if (isAudioFile(uri.toLatin1().constData()))
+            audioUris << uri;
     }
 
-    if (!tableIsEmpty()) {
-        /* Select the first cell and update artwork label */
-        ui.tableWidget_metadata->setCurrentCell(0,1);
-        updateArtworkInUI(0,0);
-    }
+    /* All the files are preparsed at once in the background. Rows are added
+    by addImportedItems as the results come back, so the UI never blocks */
+    importer->enqueue(audioUris);
 }
 
 void ExtMetaManagerDialog::initiateMetadataSearch() {
@@ -167,29 +165,27 @@ void ExtMetaManagerDialog::saveChanges() {
     msg_Dbg( p_intf, "[EMM_Dialog] saveChanges" );
 
     input_item_t *temp_item;
+    QVector<MetadataChange> changes;
 
-    int rows = ui.tableWidget_metadata->rowCount();
+    int rows = model->rowCount();
     for(int row = 0;  row < rows; row++) {
         if (isRowSelected(row)) {
             temp_item = recoverItemFromRow(row);
-            saveItemChanges(temp_item, row);
+            changes.append(saveItemChanges(temp_item, row));
         }
     }
+
+    /* The files are written in the background; savingFinished tells how it
+    went once they are all done */
+    if (writer->write(changes) > 0)
+        ui.pushButton_saveAll->setEnabled(false);
 }
 
 void ExtMetaManagerDialog::discardUnsavedChanges() {
     msg_Dbg( p_intf, "[EMM_Dialog] discardUnsavedChanges" );
 
-    clearTable();
-
-    input_item_t *temp_item;
-
-    int workspaceSize = vlc_array_count(workspace);
-    for(int i = 0; i < workspaceSize; i++)
-    {
-        temp_item = (input_item_t*)vlc_array_item_at_index(workspace, i);
-        addTableEntry(temp_item);
-    }
+    /* The cells show the items' metadata again */
+    model->discardEdits();
 }
 
 /*----------------------------------------------------------------------------*/
@@ -203,41 +199,63 @@ void ExtMetaManagerDialog::fingerprintTable( bool isFastSearch ) { //TODO: clean
 
     input_item_t *temp_item; // This is where the current working item will be
 
-    int totalRowAmount = ui.tableWidget_metadata->rowCount();
+    int totalRowAmount = model->rowCount();
     int selectedRowsAmount = countSelectedRows();
 
     if (selectedRowsAmount == 0)
         return;
 
-    /* Calculate how much the progress bar will advance each step (progressBar
-    goes from 0 to 100). Then progress variable is set to 0 and the widget is
-    updated */
-    int progress_unit= 100/selectedRowsAmount;
-    int progress=0;
-    ui.progressBar_search->setValue(progress);
-
-    /* We dont want the table to mess things while we update it, so que block
-    its signals (this is caused because we edited "multipleItemsChanged"). */
-    ui.tableWidget_metadata->blockSignals(true);
+    ui.progressBar_search->setEnabled(true);
 
-    /* if fast search is activated, initilize custom fingerprinter */
+    /* In fast search mode, every selected item is handed to the fingerprinter
+    at once: they are processed in parallel, and fingerprintResultsAvailable
+    updates the rows and the progress bar as the results arrive */
     if (isFastSearch)
     {
-        t = new (std::nothrow) Chromaprint( p_intf );
-        if ( !t )
+        /* initilize custom fingerprinter, if not searching already */
+        if (!t)
+        {
+            t = new (std::nothrow) Chromaprint( p_intf );
+            if ( !t )
+                return; // Error
+            CONNECT( t, finished(), this, fingerprintResultsAvailable() );
+            fingerprintTotal = fingerprintDone = 0;
+        }
+
+        for(int row = 0; row < totalRowAmount; row++)
+        {
+            if (!isRowSelected(row))
+                continue;
+            temp_item = recoverItemFromRow(row);
+            fingerprintItem(temp_item, row, isFastSearch);
+        }
+
+        if (fingerprintPending.isEmpty())
         {
-            return; // Error
+            /* Nothing could be enqueued */
+            cancelFastSearch();
+            ui.progressBar_search->setEnabled(false);
         }
+        else
+            ui.progressBar_search->setValue(100 * fingerprintDone / fingerprintTotal);
+        return;
     }
 
+    /* Calculate how much the progress bar will advance each step (progressBar
+    goes from 0 to 100). Then progress variable is set to 0 and the widget is
+    updated */
+    int progress_unit= 100/selectedRowsAmount;
+    int progress=0;
+    ui.progressBar_search->setValue(progress);
+
     /* Iterate the table */
     for(int row = 0; row < totalRowAmount; row++)
     {
         if (isRowSelected(row))
         {
             temp_item = recoverItemFromRow(row);
-            fingerprintItem(temp_item, isFastSearch);
-            fillRowWithMetadata(temp_item, row);
+            fingerprintItem(temp_item, row, isFastSearch);
+            model->refreshRow(row);
 
             /* Update the progress bar */
             progress=progress+progress_unit; // Increase the progress
@@ -249,45 +267,115 @@ void ExtMetaManagerDialog::fingerprintTable( bool isFastSearch ) { //TODO: clean
     the fix */
     ui.progressBar_search->setValue(100); //
     ui.progressBar_search->setEnabled(false);
+}
+
+/* Initiates the fingerprint process just for one item. If "fast" is true, 1st
+entry is applied automatically, once fingerprintResultsAvailable gets it */
+void ExtMetaManagerDialog::fingerprintItem(input_item_t *p_item, int row, bool isFastSearch) {
+    msg_Dbg( p_intf, "[EMM_Dialog] fingerprint" );
 
-    /* If fast search is activated, delete the custom fingerprinter */
     if (isFastSearch)
     {
-        if ( t ) delete t;
-        if ( p_r ) fingerprint_request_Delete( p_r );
+        /* Add the item to the finperprinter's queue, only once even if it is
+        shown on several rows */
+        if (!fingerprintPending.contains(p_item))
+        {
+            if ( !t || !t->enqueue( p_item ) )
+                return;
+            fingerprintTotal++;
+        }
+        fingerprintPending.insert(p_item, row);
+    } else {
+        launchFingerprinterDialog(p_item);
     }
-
-    /* We have finished, so we unlock all the table's signals. */
-    ui.tableWidget_metadata->blockSignals(false);
 }
 
-/* Initiates the fingerprint process just for one item. If "fast" is true, 1st
-entry is applied automatically */
-void ExtMetaManagerDialog::fingerprintItem(input_item_t *p_item, bool isFastSearch) { //TODO: clean this method
-    msg_Dbg( p_intf, "[EMM_Dialog] fingerprint" );
+/* Called (queued, on the UI thread) each time the fingerprinter signals new
+results. Applies the 1st entry of every result ready and updates its rows */
+void ExtMetaManagerDialog::fingerprintResultsAvailable() {
+    if (!t)
+        return; // Search cancelled meanwhile
 
-    if (isFastSearch)
+    fingerprint_request_t *p_result;
+
+    while ((p_result = t->fetchResults()) != NULL)
     {
-        /* Add the item to the finperprinter's queue */
-        if ( t )
-            t->enqueue( p_item );
+        input_item_t *p_item = p_result->p_item;
+        QList<int> rows = fingerprintPending.values(p_item);
+        fingerprintPending.remove(p_item);
+
+        if (!rows.isEmpty())
+        {
+            /* Apply first option, if metadata was found */
+            if ( vlc_array_count( & p_result->results.metas_array ) > 0 )
+                t->apply( p_result, 0 );
+            foreach( int row, rows )
+                model->refreshRow(row);
+            fingerprintDone++;
+        }
+        fingerprint_request_Delete( p_result );
+    }
 
-        /* Wait for results */
-        p_r = t->fetchResults();
-        while (!p_r)
-            p_r = t->fetchResults();
+    if (fingerprintPending.isEmpty())
+    {
+        /* All done: the fingerprinter isn't needed anymore */
+        cancelFastSearch();
+        ui.progressBar_search->setValue(100);
+        ui.progressBar_search->setEnabled(false);
+    }
+    else
+        ui.progressBar_search->setValue(100 * fingerprintDone / fingerprintTotal);
+}
 
-        /* Check if metadata was found and if not, exit */
-        if ( vlc_array_count( & p_r->results.metas_array ) == 0 )
-            return;
+/* Drops the fast search fingerprinter, with any request still in flight. It
+is handed over to the reaper thread, which waits for its workers */
+void ExtMetaManagerDialog::cancelFastSearch() {
+    if (t)
+    {
+        /* No more results for this dialog, nor events for the UI thread */
+        t->disconnect(this);
+        t->moveToThread(NULL);
+
+        vlc_mutex_lock( &reaperLock );
+        if (!reaperStarted)
+            reaperStarted = !vlc_clone( &reaper, reap, this,
+                                        VLC_THREAD_PRIORITY_LOW );
+        if (reaperStarted)
+        {
+            reaperQueue.append(t);
+            vlc_cond_signal( &reaperWait );
+            t = NULL;
+        }
+        vlc_mutex_unlock( &reaperLock );
 
-        /* Apply first option */
-        t->apply( p_r, 0 );
-    } else {
-        launchFingerprinterDialog(p_item);
+        delete t; // No reaper thread: wait here instead
+        t = NULL;
     }
+    fingerprintPending.clear();
+    fingerprintTotal = fingerprintDone = 0;
 }
 
+/* Reaper thread: destroys the cancelled fingerprinters, until the dialog is
+destroyed and none is left */
+void *ExtMetaManagerDialog::reap(void *data) {
+    ExtMetaManagerDialog *dialog = static_cast<ExtMetaManagerDialog *>(data);
+
+    vlc_mutex_lock( &dialog->reaperLock );
+    for (;;)
+    {
+        while (dialog->reaperQueue.isEmpty() && !dialog->reaperQuit)
+            vlc_cond_wait( &dialog->reaperWait, &dialog->reaperLock );
+        if (dialog->reaperQueue.isEmpty())
+            break;
+
+        Chromaprint *p_fingerprinter = dialog->reaperQueue.takeFirst();
+        vlc_mutex_unlock( &dialog->reaperLock );
+        delete p_fingerprinter;
+        vlc_mutex_lock( &dialog->reaperLock );
+    }
+    vlc_mutex_unlock( &dialog->reaperLock );
+    return NULL;
+}
 
 void ExtMetaManagerDialog::launchFingerprinterDialog(input_item_t *p_item) {
     FingerprintDialog dialog(this, p_intf, p_item);
@@ -299,21 +387,24 @@ void ExtMetaManagerDialog::launchFingerprinterDialog(input_item_t *p_item) {
 
 input_item_t* ExtMetaManagerDialog::recoverItemFromRow(int row) {
     // Item at row X is stored at workspace postion X
-    input_item_t *p_item = (input_item_t*)vlc_array_item_at_index(workspace, row);
-    return p_item;
+    return model->item(row);
 }
 
-/* Gets an item from an URI and preparses it (gets it's metadata) */
-input_item_t* ExtMetaManagerDialog::createItemFromURI(const char* uri) {
-    msg_Dbg( p_intf, "[EMM_Dialog] createItemFromURI" );
+/* Receives a batch of already preparsed items from the importer. The
+workspace takes over the items' references */
+void ExtMetaManagerDialog::addImportedItems(const QVector<input_item_t *> &items) {
+    msg_Dbg( p_intf, "[EMM_Dialog] addImportedItems (%d)", items.count() );
 
-    input_item_t *p_item = input_item_New( uri, "" ); //The name is not relevant
+    bool wasEmpty = tableIsEmpty();
 
-    // Preparse the item (get the metadata)
-    libvlc_MetadataRequest(THEPL->obj.libvlc, p_item, META_REQUEST_OPTION_SCOPE_ANY,-1, NULL );
-    while (!input_item_IsPreparsed(p_item)) ;
+    /* Item at row X on the table is also stored at workspace position X */
+    model->appendItems(items);
 
-    return p_item;
+    if (wasEmpty && !tableIsEmpty()) {
+        /* Select the first cell and update artwork label */
+        ui.tableView_metadata->setCurrentIndex(model->index(0, COL_TITLE));
+        updateArtworkInUI(0,0);
+    }
 }
 
 bool ExtMetaManagerDialog::isAudioFile(const char* uri) { //TODO: clean this method
@@ -361,152 +452,83 @@ bool ExtMetaManagerDialog::isAudioFile(const char* uri) { //TODO: clean this met
     return false;
 }
 
-void ExtMetaManagerDialog::saveItemChanges( input_item_t *p_item, int rowFrom) {
-    const char *title_text;
-    const char *artist_text;
-    const char *album_text;
-    const char *genre_text;
-    const char *trackNum_text;
-    const char *publisher_text;
-    const char *copyright_text;
-
-    /* ---Extract information form the table---
-    getting the reference to one columns info is tricky, because the
-    pointer is only valid while the QString (got with text()) hasn't
-    changed. This means every time you get info from a new row, you
-    loose the pointers to the previous row. That's why here we get the
-    info and store it inmediately*/
-    title_text = ui.tableWidget_metadata->item(rowFrom,COL_TITLE)->text().toLocal8Bit().constData();
-    input_item_SetTitle(p_item, title_text);
-    artist_text = ui.tableWidget_metadata->item(rowFrom,COL_ARTIST)->text().toLocal8Bit().constData();
-    input_item_SetArtist(p_item, artist_text);
-    album_text = ui.tableWidget_metadata->item(rowFrom,COL_ALBUM)->text().toLocal8Bit().constData();
-    input_item_SetAlbum(p_item, album_text);
-    genre_text = ui.tableWidget_metadata->item(rowFrom,COL_GENRE)->text().toLocal8Bit().constData();
-    input_item_SetGenre(p_item, genre_text);
-    trackNum_text = ui.tableWidget_metadata->item(rowFrom,COL_TRACKNUM)->text().toLocal8Bit().constData();
-    input_item_SetTrackNum(p_item, trackNum_text);
-    publisher_text = ui.tableWidget_metadata->item(rowFrom,COL_PUBLISHER)->text().toLocal8Bit().constData();
-    input_item_SetPublisher(p_item, publisher_text);
-    copyright_text = ui.tableWidget_metadata->item(rowFrom,COL_COPYRIGHT)->text().toLocal8Bit().constData();
-    input_item_SetCopyright(p_item, copyright_text);
-
-    // Save the metas on the item
-    input_item_WriteMeta( VLC_OBJECT(THEPL), p_item );
-}
-
-/*----------------------------------------------------------------------------*/
-/*--------------------------Table management----------------------------------*/
-/*----------------------------------------------------------------------------*/
+/* Collects the fields of the row that differ from the item's metadata. The
+item itself is only updated and written by the writer threads */
+MetadataChange ExtMetaManagerDialog::saveItemChanges( input_item_t *p_item, int rowFrom) {
+    MetadataChange change;
+    change.p_item = p_item;
+    change.fields = model->editedFields(rowFrom);
 
-/* Modify the table's behavior so when multiple cells are selected, their text
- is changed all at once */
-void ExtMetaManagerDialog::multipleItemsChanged( QTableWidgetItem *item ) {
-    ui.tableWidget_metadata->blockSignals(true);
-    QList<QTableWidgetItem*> selectedItems = ui.tableWidget_metadata->selectedItems();
-    foreach(QTableWidgetItem* selectItem, selectedItems)
-    {
-        selectItem->setText(item->text());
-    }
-    ui.tableWidget_metadata->blockSignals(false);
+    /* Even without edits, the row is written: the artwork may have changed */
+    return change;
 }
 
-void ExtMetaManagerDialog::addTableEntry(input_item_t *p_item) {
-    msg_Dbg( p_intf, "[EMM_Dialog] addTableEntry" );
+/* Per file report from the writer */
+void ExtMetaManagerDialog::itemSaved(input_item_t *p_item, bool success) {
+    if (success)
+        return;
 
-    int newRowNumber = addNewRow();
+    char *psz_uri = input_item_GetURI(p_item);
+    msg_Err( p_intf, "[EMM_Dialog] could not save metadata to %s", psz_uri );
+    free(psz_uri);
+}
 
-    createCheckboxOnRow(newRowNumber);
+void ExtMetaManagerDialog::savingFinished(int failures, quint64 written) {
+    msg_Dbg( p_intf, "[EMM_Dialog] savingFinished (%d failures, "
+             "%llu bytes written)", failures, (unsigned long long) written );
 
-    createChangeartworkButtonOnRow(newRowNumber);
+    ui.pushButton_saveAll->setEnabled(true);
 
-    fillRowWithMetadata(p_item, newRowNumber);
+    if (failures > 0)
+        QMessageBox::warning(
+          this,
+          saveFailed_dialog_title,
+          saveFailed_dialog_text.arg(failures) );
 }
 
-void ExtMetaManagerDialog::fillRowWithMetadata(input_item_t *p_item, int row) {
-    msg_Dbg( p_intf, "[EMM_Dialog] fillRowWithMetadata" );
-
-    // Get metadata information from item
-    char *title_text = input_item_GetTitle(p_item);
-    char *artist_text = input_item_GetArtist(p_item);
-    char *album_text = input_item_GetAlbum(p_item);
-    char *genre_text = input_item_GetGenre(p_item);
-    char *trackNum_text = input_item_GetTrackNum(p_item);
-    char *publisher_text = input_item_GetPublisher(p_item);
-    char *copyright_text = input_item_GetCopyright(p_item);
-    char *uri_text = input_item_GetURI(p_item);
+/*----------------------------------------------------------------------------*/
+/*--------------------------Table management----------------------------------*/
+/*----------------------------------------------------------------------------*/
 
-    // Fill all the cells with the extracted info
-    ui.tableWidget_metadata->setItem(row, COL_TITLE, new QTableWidgetItem( title_text ));
-    ui.tableWidget_metadata->setItem(row, COL_ARTIST, new QTableWidgetItem( artist_text ));
-    ui.tableWidget_metadata->setItem(row, COL_ALBUM, new QTableWidgetItem( album_text ));
-    ui.tableWidget_metadata->setItem(row, COL_GENRE, new QTableWidgetItem( genre_text ));
-    ui.tableWidget_metadata->setItem(row, COL_TRACKNUM, new QTableWidgetItem( trackNum_text ));
-    ui.tableWidget_metadata->setItem(row, COL_PUBLISHER, new QTableWidgetItem( publisher_text ));
-    ui.tableWidget_metadata->setItem(row, COL_COPYRIGHT, new QTableWidgetItem( copyright_text ));
-    ui.tableWidget_metadata->setItem(row, COL_PATH, new QTableWidgetItem( uri_text ));
-    ui.tableWidget_metadata->item(row, COL_PATH)->setFlags(0); // Make the path not selectable/editable
+/* Modify the table's behavior so when multiple cells are selected, their text
+ is changed all at once */
+void ExtMetaManagerDialog::multipleItemsChanged( const QModelIndex &index ) {
+    QString text = model->data(index, Qt::EditRole).toString();
+    QModelIndexList selectedIndexes = ui.tableView_metadata->selectionModel()->selectedIndexes();
+    foreach(const QModelIndex &selectIndex, selectedIndexes)
+    {
+        if (selectIndex != index)
+            model->setText(selectIndex, text);
+    }
 }
 
 void ExtMetaManagerDialog::clearTable() {
     msg_Dbg( p_intf, "[EMM_Dialog] clearTable" );
 
-    ui.tableWidget_metadata->clearContents();
-    ui.tableWidget_metadata->setRowCount(0);
+    model->clear();
     art_cover->clear();
 }
 
 int ExtMetaManagerDialog::countSelectedRows() {
-    int totalRowAmount = ui.tableWidget_metadata->rowCount();
-    int selectedRowsCount=0;
-
-    for(int row = 0;  row < totalRowAmount; row++) {
-        if (isRowSelected(row)){
-            selectedRowsCount++;
-        }
-    }
-    return selectedRowsCount;
+    return model->checkedCount();
 }
 
 bool ExtMetaManagerDialog::tableIsEmpty() {
-    return (ui.tableWidget_metadata->rowCount()>0);
+    return (model->rowCount() == 0);
 }
 
 bool ExtMetaManagerDialog::isRowSelected(int row) {
-    QCheckBox *checkbox = (QCheckBox*) ui.tableWidget_metadata->cellWidget(row,COL_CHECKBOX);
-    return checkbox->isChecked();
-}
-
-void ExtMetaManagerDialog::createCheckboxOnRow(int row) {
-    QCheckBox *checkbox = new QCheckBox ();
-    checkbox->setChecked(true);
-    checkbox->setToolTip(checkbox_tip);
-    ui.tableWidget_metadata->setCellWidget(row, COL_CHECKBOX, checkbox);
-}
-
-int ExtMetaManagerDialog::addNewRow() {
-    int newRowNumber = ui.tableWidget_metadata->rowCount(); //Last row is always rowCount-1
-    ui.tableWidget_metadata->insertRow(newRowNumber);
-    return newRowNumber;
-}
-
-void ExtMetaManagerDialog::createChangeartworkButtonOnRow(int row) {
-    QPushButton *button_changeArtwork = new QPushButton( qtr("Change"), this);
-    button_changeArtwork->setToolTip(artworkButton_tip);
-
-    /* Prepare the mapper to be able to know from which row is the button is
-    being clicked */
-    ButtonSignalMapper.setMapping(button_changeArtwork, row);
-    connect(button_changeArtwork, SIGNAL(clicked()), &ButtonSignalMapper, SLOT(map()));
-
-    // Insert the button in the cell
-    ui.tableWidget_metadata->setCellWidget(row, COL_ARTWORK, button_changeArtwork );
+    return model->isChecked(row);
 }
 
 /*----------------------------------------------------------------------------*/
 /*----------------------------Artwork management------------------------------*/
 /*----------------------------------------------------------------------------*/
 
+void ExtMetaManagerDialog::cellClicked(const QModelIndex &index) {
+    updateArtworkInUI(index.row(), index.column());
+}
+
 /* When a cell on the table is selected, this function changes the Artwork
 label's content to the selected item's artwork */
 void ExtMetaManagerDialog::updateArtworkInUI(int row, int column) {
@@ -519,7 +541,7 @@ void ExtMetaManagerDialog::changeArtwork(int row) {
     msg_Dbg( p_intf, "[EMM_Dialog] changeArtwork" );
 
     // Fix to know the row the button is being clicked from and show it's cover
-    ui.tableWidget_metadata->setCurrentCell(row, COL_ARTWORK);
+    ui.tableView_metadata->setCurrentIndex(model->index(row, COL_ARTWORK));
     updateArtworkInUI(row, COL_ARTWORK);
 
     art_cover->setArtFromFile();
@@ -546,14 +568,16 @@ void ExtMetaManagerDialog::configureBasicUI() {
 }
 
 void ExtMetaManagerDialog::configureTable() {
-    setTableEvents();
-    setColumnSizes();
+    /* The cells are only read from the items when they are shown, and the
+    checkboxes and buttons are painted: no widget is created per row */
+    ui.tableView_metadata->setModel(model);
 
-    /* Set the mapper's connection to changeArtwork. This is used to be able
-    to know from which row the button (added later on each row) it's being
-    clicked */
-    connect(&ButtonSignalMapper, SIGNAL(mapped(int)), this, SLOT(changeArtwork(int)));
+    MetadataTableDelegate *delegate = new MetadataTableDelegate(ui.tableView_metadata);
+    ui.tableView_metadata->setItemDelegate(delegate);
+    CONNECT( delegate, buttonClicked(int), this, changeArtwork(int) );
 
+    setTableEvents();
+    setColumnSizes();
 }
 
 void ExtMetaManagerDialog::configureButtons() {
@@ -571,21 +595,21 @@ void ExtMetaManagerDialog::configureProgressBar() {
 }
 
 void ExtMetaManagerDialog::setTableEvents() {
-    CONNECT( ui.tableWidget_metadata, cellClicked(int, int), this, updateArtworkInUI(int, int) );
-    CONNECT( ui.tableWidget_metadata,  itemChanged(QTableWidgetItem*), this,  multipleItemsChanged(QTableWidgetItem*));
+    CONNECT( ui.tableView_metadata, clicked(const QModelIndex &), this, cellClicked(const QModelIndex &) );
+    CONNECT( model, edited(const QModelIndex &), this, multipleItemsChanged(const QModelIndex &) );
 }
 
 void ExtMetaManagerDialog::setColumnSizes() {
-    ui.tableWidget_metadata->setColumnWidth(COL_CHECKBOX, 30);
-    ui.tableWidget_metadata->setColumnWidth(COL_TITLE, 200);
-    ui.tableWidget_metadata->setColumnWidth(COL_ARTIST, 200);
-    ui.tableWidget_metadata->setColumnWidth(COL_ALBUM, 200);
-    ui.tableWidget_metadata->setColumnWidth(COL_GENRE, 120);
-    ui.tableWidget_metadata->setColumnWidth(COL_TRACKNUM, 70);
-    ui.tableWidget_metadata->setColumnWidth(COL_PUBLISHER, 120);
-    ui.tableWidget_metadata->setColumnWidth(COL_COPYRIGHT, 120);
-    ui.tableWidget_metadata->setColumnWidth(COL_ARTWORK, 70);
-    ui.tableWidget_metadata->setColumnWidth(COL_PATH, 50);
+    ui.tableView_metadata->setColumnWidth(COL_CHECKBOX, 30);
+    ui.tableView_metadata->setColumnWidth(COL_TITLE, 200);
+    ui.tableView_metadata->setColumnWidth(COL_ARTIST, 200);
+    ui.tableView_metadata->setColumnWidth(COL_ALBUM, 200);
+    ui.tableView_metadata->setColumnWidth(COL_GENRE, 120);
+    ui.tableView_metadata->setColumnWidth(COL_TRACKNUM, 70);
+    ui.tableView_metadata->setColumnWidth(COL_PUBLISHER, 120);
+    ui.tableView_metadata->setColumnWidth(COL_COPYRIGHT, 120);
+    ui.tableView_metadata->setColumnWidth(COL_ARTWORK, 70);
+    ui.tableView_metadata->setColumnWidth(COL_PATH, 50);
 }
 
 void ExtMetaManagerDialog::setButtonIcons() {
@@ -625,6 +649,8 @@ void ExtMetaManagerDialog::setToolTips() {
     ui.progressBar_search->setToolTip(progressBar_tip);
     ui.checkBox_disableFastSearch->setToolTip(disableFastSearch_tip);
     art_cover->setToolTip(artwork_tip);
+    model->setColumnToolTip(COL_CHECKBOX, checkbox_tip);
+    model->setColumnToolTip(COL_ARTWORK, artworkButton_tip);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -633,13 +659,36 @@ void ExtMetaManagerDialog::setToolTips() {
 
 void ExtMetaManagerDialog::resetEnvironment() {
     msg_Dbg( p_intf, "[EMM_Dialog] resetEnvironment" );
+
+    /* Forget about the files still being loaded or searched, if any. The
+    files being written are finished first */
+    importer->cancel();
+    writer->cancel();
+    ui.pushButton_saveAll->setEnabled(true);
+    cancelFastSearch();
+    ui.progressBar_search->setEnabled(false);
+
+    /* Also releases the workspace's items */
     clearTable();
-    vlc_array_clear(workspace);
 }
 
 void ExtMetaManagerDialog::initializeWorkspace(){
     workspace = new vlc_array_t();
     vlc_array_init(workspace);
+    model = new MetadataTableModel( workspace, this );
+
+    t = NULL;
+    fingerprintTotal = fingerprintDone = 0;
+
+    importer = new MetadataImporter( p_intf, this );
+    CONNECT( importer, itemsReady(const QVector<input_item_t *> &),
+             this, addImportedItems(const QVector<input_item_t *> &) );
+
+    writer = new MetadataWriter( p_intf, this );
+    CONNECT( writer, itemWritten(input_item_t *, bool),
+             this, itemSaved(input_item_t *, bool) );
+    CONNECT( writer, finished(int, quint64),
+             this, savingFinished(int, quint64) );
 }
 
 void ExtMetaManagerDialog::launchHelpDialog() {
@@ -21,29 +21,22 @@
 #ifndef QVLC_EXTMETAMANAGER_DIALOG_H_
 #define QVLC_EXTMETAMANAGER_DIALOG_H_ 1
 
-//aliases for the table's columns' name
-#define COL_CHECKBOX 0
-#define COL_TITLE 1
-#define COL_ARTIST 2
-#define COL_ALBUM 3
-#define COL_GENRE 4
-#define COL_TRACKNUM 5
-#define COL_PUBLISHER 6
-#define COL_COPYRIGHT 7
-#define COL_ARTWORK 8
-#define COL_PATH 9
-
 #include "util/qvlcframe.hpp"
 #include "util/singleton.hpp"
 
 #include "vlc_fingerprinter.h" //VLC's fingerprinting api
+#include "adapters/metadata_writer.hpp" // MetadataChange
+#include "adapters/metadata_table_model.hpp" // COL_*, table model
 
 #include "ui/extmetamanager.h" // Include the precompiled version of extmetamanager.ui
 
-#include <QSignalMapper> /* for the Help and About popups */
+#include <QList>
+#include <QVector>
+#include <QMultiHash>
 
 class CoverArtLabelExt;
 class Chromaprint;
+class MetadataImporter;
 
 class ExtMetaManagerDialog : public QVLCDialog, public Singleton<ExtMetaManagerDialog>
 {
@@ -100,6 +93,10 @@ private:
     QString emptyPlaylist_dialog_text = qtr("There were no items to be loaded on the "
     "current playlist.");
 
+    QString saveFailed_dialog_title = qtr("Saving failed - Extended Metadata Manager");
+    QString saveFailed_dialog_text = qtr("The metadata of %1 file(s) could not be "
+    "saved. See the messages for details.");
+
     /* Text for the "tips" */
     QString getFromPlaylist_tip = qtr("Load files into the table from the current playlist.ONLY THE AUDIO FILES.");
     QString getFromFolder_tip = qtr("Load files into the table from a file/folder. ONLY THE AUDIO FILES.");
@@ -125,7 +122,28 @@ private:
 
     /* Declarations for the fingerprinter */
     Chromaprint *t;
-    fingerprint_request_t *p_r;
+
+    /* Fast search: rows waiting for a fingerprint result, by item. Results
+    are delivered by fingerprintResultsAvailable as they come */
+    QMultiHash<input_item_t *, int> fingerprintPending;
+    int fingerprintTotal;
+    int fingerprintDone;
+
+    /* Cancelled fingerprinters, destroyed by a background thread as waiting
+    for their workers would block the UI */
+    QList<Chromaprint *> reaperQueue;
+    vlc_mutex_t reaperLock;
+    vlc_cond_t reaperWait;
+    vlc_thread_t reaper;
+    bool reaperStarted;
+    bool reaperQuit;
+    static void *reap(void *);
+
+    /* Asynchronous preparser used to load files from a folder */
+    MetadataImporter *importer;
+
+    /* Background writer used to save the selected rows */
+    MetadataWriter *writer;
 
     /* The widget used to show the artwork */
     CoverArtLabelExt *art_cover;
@@ -133,13 +151,12 @@ private:
     /* An array with the items the window is working at a the moment */
     vlc_array_t *workspace;
 
+    /* The table's rows, over the workspace */
+    MetadataTableModel *model;
+
     /* The User interface (UI) made in QT */
     Ui::ExtMetaManagerWidget ui;
 
-    /* Mapper used on the buttons on the table to know from which row is the
-    call being made */
-    QSignalMapper ButtonSignalMapper;
-
 private slots:
     void closeEvent(QCloseEvent *event);
 
@@ -159,7 +176,9 @@ private slots:
 /*----------------------------------------------------------------------------*/
 
     void fingerprintTable(bool isFastSearch);
-    void fingerprintItem(input_item_t *p_item, bool isFastSearch);
+    void fingerprintItem(input_item_t *p_item, int row, bool isFastSearch);
+    void fingerprintResultsAvailable();
+    void cancelFastSearch();
     void launchFingerprinterDialog(input_item_t *p_item);
 
 /*----------------------------------------------------------------------------*/
@@ -167,29 +186,27 @@ private slots:
 /*----------------------------------------------------------------------------*/
 
     input_item_t* recoverItemFromRow(int row);
-    input_item_t* createItemFromURI(const char* uri);
+    void addImportedItems(const QVector<input_item_t *> &items);
     bool isAudioFile(const char* uri);
-    void saveItemChanges( input_item_t *p_item, int rowFrom);
+    MetadataChange saveItemChanges( input_item_t *p_item, int rowFrom);
+    void itemSaved(input_item_t *p_item, bool success);
+    void savingFinished(int failures, quint64 written);
 
 /*----------------------------------------------------------------------------*/
 /*--------------------------Table management----------------------------------*/
 /*----------------------------------------------------------------------------*/
 
-    void multipleItemsChanged( QTableWidgetItem *item );
-    void addTableEntry(input_item_t *p_item);
-    void fillRowWithMetadata(input_item_t *p_item, int row);
+    void multipleItemsChanged( const QModelIndex &index );
     void clearTable();
     int countSelectedRows();
     bool tableIsEmpty();
     bool isRowSelected(int row);
-    void createCheckboxOnRow(int row);
-    int addNewRow();
-    void createChangeartworkButtonOnRow(int row);
 
 /*----------------------------------------------------------------------------*/
 /*----------------------------Artwork management------------------------------*/
 /*----------------------------------------------------------------------------*/
 
+    void cellClicked(const QModelIndex &index);
     void updateArtworkInUI(int row, int column);
     void changeArtwork(int row);
 
@@ -66,6 +66,8 @@
 #if TAGLIB_VERSION >= TAGLIB_VERSION_1_11
 # include <vlc_access.h>
 # include <tiostream.h>
+# include <tfilestream.h>
+# include <memory>
 #endif
 
 #include <apefile.h>
@@ -88,6 +90,8 @@
 #include <vorbisfile.h>
 #include <wavpackfile.h>
 
+#include <id3v2tag.h>
+#include <id3v2header.h>
 #include <attachedpictureframe.h>
 #include <textidentificationframe.h>
 #include <uniquefileidentifierframe.h>
@@ -149,12 +153,19 @@ static vlc_mutex_t taglib_lock = VLC_STATIC_MUTEX;
 static int ReadMeta    ( vlc_object_t * );
 static int WriteMeta   ( vlc_object_t * );
 
+#define PADDING_TEXT N_("Tag padding")
+#define PADDING_LONGTEXT N_("Room (in bytes) reserved after an ID3v2 tag " \
+    "when it has to grow, so that later edits can be written in place " \
+    "instead of rewriting the whole file.")
+
 vlc_module_begin ()
     set_capability( "meta reader", 1000 )
     set_callbacks( ReadMeta, NULL )
     add_submodule ()
         set_capability( "meta writer", 50 )
         set_callbacks( WriteMeta, NULL )
+        add_integer( "taglib-padding", 4096, PADDING_TEXT, PADDING_LONGTEXT, true )
+            change_integer_range( 0, 1 << 20 )
 vlc_module_end ()
 
 #if TAGLIB_VERSION >= TAGLIB_VERSION_1_11
@@ -255,6 +266,58 @@ private:
     stream_t* m_stream;
     int64_t m_previousPos;
 };
+
+/* Local file, keeping track of how much data TagLib writes into it */
+class VlcCountingFileStream : public FileStream
+{
+public:
+    VlcCountingFileStream(FileName fileName)
+        : FileStream( fileName, false )
+        , m_written( 0 )
+        , m_nested( false )
+    {
+    }
+
+    void writeBlock(const ByteVector &data)
+    {
+        FileStream::writeBlock( data );
+        if (!m_nested)
+            m_written += data.size();
+    }
+
+    void insert(const ByteVector &data, ulong start, ulong replace)
+    {
+        /* Unless the size is unchanged, everything after is moved */
+        long i_tail = length() - (long)(start + replace);
+        if (data.size() != replace && i_tail > 0)
+            m_written += i_tail;
+        m_written += data.size();
+
+        m_nested = true;
+        FileStream::insert( data, start, replace );
+        m_nested = false;
+    }
+
+    void removeBlock(ulong start, ulong len)
+    {
+        long i_tail = length() - (long)(start + len);
+        if (i_tail > 0)
+            m_written += i_tail;
+
+        m_nested = true;
+        FileStream::removeBlock( start, len );
+        m_nested = false;
+    }
+
+    uint64_t written() const
+    {
+        return m_written;
+    }
+
+private:
+    uint64_t m_written;
+    bool m_nested;
+};
 #endif /* TAGLIB_VERSION_1_11 */
 
 static int ExtractCoupleNumberValues( vlc_meta_t* p_meta, const char *psz_value,
@@ -1179,6 +1242,81 @@ static void WriteMetaToXiph( Ogg::XiphComment* tag, input_item_t* p_item )
 }
 
 
+/**
+ * Get the ID3v2 tag WriteMeta would update, if any
+ * @param file: the TagLib file
+ * @param pb_leading: set if the tag is at the start of the file, where its
+ *                    growth moves all the file
+ */
+static ID3v2::Tag* GetId3v2Tag( File* file, bool *pb_leading )
+{
+    *pb_leading = true;
+    if( MPEG::File* mpeg = dynamic_cast<MPEG::File*>(file) )
+        return mpeg->ID3v2Tag();
+    if( FLAC::File* flac = dynamic_cast<FLAC::File*>(file) )
+        return flac->ID3v2Tag();
+    if( TrueAudio::File* trueaudio = dynamic_cast<TrueAudio::File*>(file) )
+        return trueaudio->ID3v2Tag();
+
+    *pb_leading = false;
+    if( RIFF::AIFF::File* riff_aiff = dynamic_cast<RIFF::AIFF::File*>(file) )
+        return riff_aiff->tag();
+    if( RIFF::WAV::File* riff_wav = dynamic_cast<RIFF::WAV::File*>(file) )
+        return riff_wav->tag();
+    return NULL;
+}
+
+/**
+ * Take a snapshot of everything WriteMeta may change in a file
+ * @param file: the TagLib file
+ * @param snapshot: the snapshot
+ * @return false if the file tags can't be fully compared (MP4, ASF...)
+ */
+static bool GetTagSnapshot( File* file, ByteVector& snapshot )
+{
+    bool b_leading;
+    ID3v2::Tag* id3 = GetId3v2Tag( file, &b_leading );
+
+    if( !id3 && !dynamic_cast<Ogg::File*>(file) &&
+        !dynamic_cast<APE::File*>(file) && !dynamic_cast<MPC::File*>(file) &&
+        !dynamic_cast<WavPack::File*>(file) )
+        return false;
+
+    snapshot = file->properties().toString().data( String::UTF8 );
+
+    /* Pictures are not part of the properties */
+    if( id3 )
+    {
+        ID3v2::FrameList pictures = id3->frameList( "APIC" );
+        for( ID3v2::FrameList::Iterator iter = pictures.begin();
+             iter != pictures.end(); iter++ )
+            snapshot.append( (*iter)->render() );
+    }
+    return true;
+}
+
+/**
+ * Reserve some padding when a leading ID3v2 tag grows, so that the next
+ * edits fit in place. TagLib pads the tag up to its header's size.
+ * @param tag: the ID3v2 tag, once edited
+ * @param i_padding: the padding to reserve
+ */
+static void ReserveId3v2Padding( ID3v2::Tag* tag, unsigned i_padding )
+{
+    ID3v2::Header* header = tag->header();
+    if( i_padding == 0 || header->footerPresent() )
+        return;
+
+    unsigned i_original = header->tagSize();
+    /* render() updates the header: size it with the new frames */
+    unsigned i_needed = tag->render().size() - ID3v2::Header::size();
+
+    if( i_needed > i_original )
+        header->setTagSize( i_needed + i_padding );
+    else
+        header->setTagSize( i_original );
+}
+
 /**
  * Set the tags to the file using TagLib
  * @param p_this: the demux object
@@ -1190,6 +1328,10 @@ static int WriteMeta( vlc_object_t *p_this )
     vlc_mutex_locker locker (&taglib_lock);
     meta_export_t *p_export = (meta_export_t *)p_this;
     input_item_t *p_item = p_export->p_item;
+#if TAGLIB_VERSION >= TAGLIB_VERSION_1_11
+    /* must outlive f */
+    std::unique_ptr<VlcCountingFileStream> p_stream;
+#endif
     FileRef f;
 
     if( !p_item )
@@ -1202,11 +1344,21 @@ static int WriteMeta( vlc_object_t *p_this )
     wchar_t *wpath = ToWide( p_export->psz_file );
     if( wpath == NULL )
         return VLC_EGENERIC;
+# if TAGLIB_VERSION >= TAGLIB_VERSION_1_11
+    p_stream.reset( new VlcCountingFileStream( wpath ) );
+# else
     f = FileRef( wpath, false );
+# endif
     free( wpath );
+#elif TAGLIB_VERSION >= TAGLIB_VERSION_1_11
+    p_stream.reset( new VlcCountingFileStream( p_export->psz_file ) );
 #else
     f = FileRef( p_export->psz_file, false );
 #endif
+#if TAGLIB_VERSION >= TAGLIB_VERSION_1_11
+    if( p_stream->isOpen() )
+        f = FileRef( p_stream.get(), false );
+#endif
 
     if( f.isNull() || !f.tag() || f.file()->readOnly() )
     {
@@ -1217,6 +1369,10 @@ static int WriteMeta( vlc_object_t *p_this )
 
     msg_Dbg( p_this, "Writing metadata for %s", p_export->psz_file );
 
+    /* To tell whether the file needs to be written at all */
+    ByteVector original;
+    bool b_comparable = GetTagSnapshot( f.file(), original );
+
     Tag *p_tag = f.tag();
 
     char *psz_meta;
@@ -1308,8 +1464,32 @@ static int WriteMeta( vlc_object_t *p_this )
             WriteMetaToAPE( wavpack->APETag(), p_item );
     }
 
+    ByteVector edited;
+    if( b_comparable && GetTagSnapshot( f.file(), edited ) && edited == original )
+    {
+        msg_Dbg( p_this, "Metadata of %s unchanged, nothing written",
+                 p_export->psz_file );
+        p_export->i_written = 0;
+        return VLC_SUCCESS;
+    }
+
+    bool b_leading;
+    ID3v2::Tag* id3 = GetId3v2Tag( f.file(), &b_leading );
+    if( id3 && b_leading )
+        ReserveId3v2Padding( id3, var_InheritInteger( p_this, "taglib-padding" ) );
+
     // Save the meta data
-    f.save();
+    if( !f.save() )
+    {
+        msg_Err( p_this, "Could not save metadata to %s", p_export->psz_file );
+        return VLC_EGENERIC;
+    }
 
+#if TAGLIB_VERSION >= TAGLIB_VERSION_1_11
+    /* Older versions cannot write through our stream to count */
+    p_export->i_written = p_stream->written();
+    msg_Dbg( p_this, "%" PRIu64 " bytes written to %s", p_export->i_written,
+             p_export->psz_file );
+#endif
     return VLC_SUCCESS;
 }
@@ -35,44 +35,92 @@
 #include <vlc_fingerprinter.h>
 #include "webservices/acoustid.h"
 #include "../stream_out/chromaprint_data.h"
+#include "fingerprinter_cache.h"
+#ifdef HAVE_CHROMAPRINT
+# include "fingerprinter_extract.h"
+#endif
 
 /*****************************************************************************
  * Local prototypes
  *****************************************************************************/
 
+/* A request travelling from the fingerprinting workers to the lookup thread */
+struct fingerprinter_job_t
+{
+    fingerprint_request_t  *p_request;
+    acoustid_fingerprint_t  fingerprint;
+    char                   *psz_uri;
+};
+typedef struct fingerprinter_job_t fingerprinter_job_t;
+
 struct fingerprinter_sys_t
 {
-    vlc_thread_t thread;
+    vlc_thread_t *p_workers;
+    unsigned      i_workers;
+    vlc_thread_t  lookup_thread;
+    unsigned      i_batch;
+
+    fingerprinter_cache_t *p_cache;
 
+    /* incoming: requests waiting to be fingerprinted,
+     * lookup: fingerprinted jobs waiting for their AcoustID query */
     struct
     {
         vlc_array_t         queue;
         vlc_mutex_t         lock;
-    } incoming, results;
+        vlc_cond_t          cond;
+    } incoming, lookup;
 
     struct
     {
         vlc_array_t         queue;
         vlc_mutex_t         lock;
-        vlc_cond_t          cond;
-        bool                b_working;
-    } processing;
+    } results;
+};
+
+/* State of one running fingerprinting input */
+struct fingerprint_session_t
+{
+    vlc_mutex_t lock;
+    vlc_cond_t  cond;
+    bool        b_working;
 };
+typedef struct fingerprint_session_t fingerprint_session_t;
 
 static int  Open            (vlc_object_t *);
 static void Close           (vlc_object_t *);
 static void CleanSys        (fingerprinter_sys_t *);
 static void *Run(void *);
+static void *RunLookup(void *);
 
 /*****************************************************************************
  * Module descriptor
  ****************************************************************************/
+#define THREADS_TEXT N_("Fingerprinting threads")
+#define THREADS_LONGTEXT N_("Number of tracks fingerprinted in parallel. " \
+    "0 means one per CPU core.")
+#define CACHE_TEXT N_("Cache fingerprints")
+#define CACHE_LONGTEXT N_("Keep the fingerprints and AcoustID results of " \
+    "local files on disk, so that unchanged files are not processed again.")
+#define BATCH_TEXT N_("Fingerprints per lookup")
+#define BATCH_LONGTEXT N_("Maximum number of fingerprints sent to the " \
+    "AcoustID service in a single request.")
+#define SERVER_TEXT N_("AcoustID server")
+#define SERVER_LONGTEXT N_("Address of the AcoustID lookup service.")
+
 vlc_module_begin ()
     set_category(CAT_ADVANCED)
     set_subcategory(SUBCAT_ADVANCED_MISC)
     set_shortname(N_("acoustid"))
     set_description(N_("Track fingerprinter (based on Acoustid)"))
     set_capability("fingerprinter", 10)
+    add_integer("fingerprinter-threads", 0, THREADS_TEXT, THREADS_LONGTEXT, true)
+        change_integer_range(0, 64)
+    add_bool("fingerprinter-cache", true, CACHE_TEXT, CACHE_LONGTEXT, true)
+    add_integer("fingerprinter-batch", 8, BATCH_TEXT, BATCH_LONGTEXT, true)
+        change_integer_range(1, ACOUSTID_MAX_BATCH)
+    add_string("acoustid-server", ACOUSTID_DEFAULT_SERVER, SERVER_TEXT,
+               SERVER_LONGTEXT, true)
     set_callbacks(Open, Close)
 vlc_module_end ()
 
@@ -85,21 +133,10 @@ static void EnqueueRequest( fingerprinter_thread_t *f, fingerprint_request_t *r
     fingerprinter_sys_t *p_sys = f->p_sys;
     vlc_mutex_lock( &p_sys->incoming.lock );
     vlc_array_append( &p_sys->incoming.queue, r );
+    vlc_cond_signal( &p_sys->incoming.cond );
     vlc_mutex_unlock( &p_sys->incoming.lock );
 }
 
-static void QueueIncomingRequests( fingerprinter_sys_t *p_sys )
-{
-    vlc_mutex_lock( &p_sys->incoming.lock );
-    size_t i = vlc_array_count( &p_sys->incoming.queue );
-
-    while( i )
-        vlc_array_append( &p_sys->processing.queue,
-                          vlc_array_item_at_index( &p_sys->incoming.queue, --i ) );
-    vlc_array_clear( &p_sys->incoming.queue );
-    vlc_mutex_unlock(&p_sys->incoming.lock);
-}
-
 static fingerprint_request_t * GetResult( fingerprinter_thread_t *f )
 {
     fingerprint_request_t *r = NULL;
@@ -126,6 +163,23 @@ static void ApplyResult( fingerprint_request_t *p_r, size_t i_resultid )
     vlc_mutex_unlock( &p_item->lock );
 }
 
+static void CleanFingerprint( acoustid_fingerprint_t *p_fp )
+{
+    for( unsigned j = 0; j < p_fp->results.count; j++ )
+         free_acoustid_result_t( &p_fp->results.p_results[j] );
+    if( p_fp->results.count )
+        free( p_fp->results.p_results );
+    free( p_fp->psz_fingerprint );
+}
+
+static void DeleteJob( fingerprinter_job_t *p_job )
+{
+    free( p_job->psz_uri );
+    CleanFingerprint( &p_job->fingerprint );
+    fingerprint_request_Delete( p_job->p_request );
+    free( p_job );
+}
+
 static int InputEventHandler( vlc_object_t *p_this, char const *psz_cmd,
                               vlc_value_t oldval, vlc_value_t newval,
                               void *p_data )
@@ -133,15 +187,15 @@ static int InputEventHandler( vlc_object_t *p_this, char const *psz_cmd,
     VLC_UNUSED( psz_cmd );
     VLC_UNUSED( oldval );
     input_thread_t *p_input = (input_thread_t *) p_this;
-    fingerprinter_sys_t *p_sys = (fingerprinter_sys_t *) p_data;
+    fingerprint_session_t *p_session = (fingerprint_session_t *) p_data;
     if( newval.i_int == INPUT_EVENT_STATE )
     {
         if( var_GetInteger( p_input, "state" ) >= PAUSE_S )
         {
-            vlc_mutex_lock( &p_sys->processing.lock );
-            p_sys->processing.b_working = false;
-            vlc_cond_signal( &p_sys->processing.cond );
-            vlc_mutex_unlock( &p_sys->processing.lock );
+            vlc_mutex_lock( &p_session->lock );
+            p_session->b_working = false;
+            vlc_cond_signal( &p_session->cond );
+            vlc_mutex_unlock( &p_session->lock );
         }
     }
     return VLC_SUCCESS;
@@ -197,22 +251,26 @@ static void DoFingerprint( fingerprinter_thread_t *p_fingerprinter,
     var_Create( p_input, "fingerprint-data", VLC_VAR_ADDRESS );
     var_SetAddress( p_input, "fingerprint-data", &chroma_fingerprint );
 
-    var_AddCallback( p_input, "intf-event", InputEventHandler, p_fingerprinter->p_sys );
+    fingerprint_session_t session;
+    vlc_mutex_init( &session.lock );
+    vlc_cond_init( &session.cond );
+    session.b_working = true;
+
+    var_AddCallback( p_input, "intf-event", InputEventHandler, &session );
 
     if( input_Start( p_input ) != VLC_SUCCESS )
     {
-        var_DelCallback( p_input, "intf-event", InputEventHandler, p_fingerprinter->p_sys );
+        var_DelCallback( p_input, "intf-event", InputEventHandler, &session );
         input_Close( p_input );
     }
     else
     {
-        p_fingerprinter->p_sys->processing.b_working = true;
-        while( p_fingerprinter->p_sys->processing.b_working )
-        {
-            vlc_cond_wait( &p_fingerprinter->p_sys->processing.cond,
-                           &p_fingerprinter->p_sys->processing.lock );
-        }
-        var_DelCallback( p_input, "intf-event", InputEventHandler, p_fingerprinter->p_sys );
+        vlc_mutex_lock( &session.lock );
+        while( session.b_working )
+            vlc_cond_wait( &session.cond, &session.lock );
+        vlc_mutex_unlock( &session.lock );
+
+        var_DelCallback( p_input, "intf-event", InputEventHandler, &session );
         input_Stop( p_input );
         input_Close( p_input );
 
@@ -220,6 +278,9 @@ static void DoFingerprint( fingerprinter_thread_t *p_fingerprinter,
         if( !fp->i_duration ) /* had not given hint */
             fp->i_duration = chroma_fingerprint.i_duration;
     }
+
+    vlc_cond_destroy( &session.cond );
+    vlc_mutex_destroy( &session.lock );
 }
 
 /*****************************************************************************
@@ -237,10 +298,11 @@ static int Open(vlc_object_t *p_this)
 
     vlc_array_init( &p_sys->incoming.queue );
     vlc_mutex_init( &p_sys->incoming.lock );
+    vlc_cond_init( &p_sys->incoming.cond );
 
-    vlc_array_init( &p_sys->processing.queue );
-    vlc_mutex_init( &p_sys->processing.lock );
-    vlc_cond_init( &p_sys->processing.cond );
+    vlc_array_init( &p_sys->lookup.queue );
+    vlc_mutex_init( &p_sys->lookup.lock );
+    vlc_cond_init( &p_sys->lookup.cond );
 
     vlc_array_init( &p_sys->results.queue );
     vlc_mutex_init( &p_sys->results.lock );
@@ -249,13 +311,47 @@ static int Open(vlc_object_t *p_this)
     p_fingerprinter->pf_getresults = GetResult;
     p_fingerprinter->pf_apply = ApplyResult;
 
+    unsigned i_workers = var_InheritInteger( p_fingerprinter, "fingerprinter-threads" );
+    if( i_workers == 0 )
+        i_workers = vlc_GetCPUCount();
+    if( i_workers == 0 )
+        i_workers = 1;
+
+    p_sys->i_batch = var_InheritInteger( p_fingerprinter, "fingerprinter-batch" );
+    if( p_sys->i_batch == 0 || p_sys->i_batch > ACOUSTID_MAX_BATCH )
+        p_sys->i_batch = ACOUSTID_MAX_BATCH;
+
+    p_sys->p_workers = malloc( i_workers * sizeof(*p_sys->p_workers) );
+    if( !p_sys->p_workers )
+        goto error;
+
     var_Create( p_fingerprinter, "results-available", VLC_VAR_BOOL );
-    if( vlc_clone( &p_sys->thread, Run, p_fingerprinter,
+
+    if( var_InheritBool( p_fingerprinter, "fingerprinter-cache" ) )
+        p_sys->p_cache = fingerprinter_cache_Open( VLC_OBJECT(p_fingerprinter) );
+
+    if( vlc_clone( &p_sys->lookup_thread, RunLookup, p_fingerprinter,
                    VLC_THREAD_PRIORITY_LOW ) )
+    {
+        msg_Err( p_fingerprinter, "cannot spawn fingerprinter lookup thread" );
+        goto error;
+    }
+
+    for( ; p_sys->i_workers < i_workers; p_sys->i_workers++ )
+    {
+        if( vlc_clone( &p_sys->p_workers[p_sys->i_workers], Run,
+                       p_fingerprinter, VLC_THREAD_PRIORITY_LOW ) )
+            break;
+    }
+
+    if( p_sys->i_workers == 0 )
     {
         msg_Err( p_fingerprinter, "cannot spawn fingerprinter thread" );
+        vlc_cancel( p_sys->lookup_thread );
+        vlc_join( p_sys->lookup_thread, NULL );
         goto error;
     }
+    msg_Dbg( p_fingerprinter, "fingerprinting with %u threads", p_sys->i_workers );
 
     return VLC_SUCCESS;
 
@@ -273,8 +369,13 @@ static void Close(vlc_object_t *p_this)
     fingerprinter_thread_t   *p_fingerprinter = (fingerprinter_thread_t*) p_this;
     fingerprinter_sys_t *p_sys = p_fingerprinter->p_sys;
 
-    vlc_cancel( p_sys->thread );
-    vlc_join( p_sys->thread, NULL );
+    for( unsigned i = 0; i < p_sys->i_workers; i++ )
+        vlc_cancel( p_sys->p_workers[i] );
+    vlc_cancel( p_sys->lookup_thread );
+
+    for( unsigned i = 0; i < p_sys->i_workers; i++ )
+        vlc_join( p_sys->p_workers[i], NULL );
+    vlc_join( p_sys->lookup_thread, NULL );
 
     CleanSys( p_sys );
     free( p_sys );
@@ -286,17 +387,23 @@ static void CleanSys( fingerprinter_sys_t *p_sys )
         fingerprint_request_Delete( vlc_array_item_at_index( &p_sys->incoming.queue, i ) );
     vlc_array_clear( &p_sys->incoming.queue );
     vlc_mutex_destroy( &p_sys->incoming.lock );
+    vlc_cond_destroy( &p_sys->incoming.cond );
 
-    for ( size_t i = 0; i < vlc_array_count( &p_sys->processing.queue ); i++ )
-        fingerprint_request_Delete( vlc_array_item_at_index( &p_sys->processing.queue, i ) );
-    vlc_array_clear( &p_sys->processing.queue );
-    vlc_mutex_destroy( &p_sys->processing.lock );
-    vlc_cond_destroy( &p_sys->processing.cond );
+    for ( size_t i = 0; i < vlc_array_count( &p_sys->lookup.queue ); i++ )
+        DeleteJob( vlc_array_item_at_index( &p_sys->lookup.queue, i ) );
+    vlc_array_clear( &p_sys->lookup.queue );
+    vlc_mutex_destroy( &p_sys->lookup.lock );
+    vlc_cond_destroy( &p_sys->lookup.cond );
 
     for ( size_t i = 0; i < vlc_array_count( &p_sys->results.queue ); i++ )
         fingerprint_request_Delete( vlc_array_item_at_index( &p_sys->results.queue, i ) );
     vlc_array_clear( &p_sys->results.queue );
     vlc_mutex_destroy( &p_sys->results.lock );
+
+    free( p_sys->p_workers );
+
+    if( p_sys->p_cache )
+        fingerprinter_cache_Close( p_sys->p_cache );
 }
 
 static void fill_metas_with_results( fingerprint_request_t *p_r, acoustid_fingerprint_t *p_f )
@@ -319,70 +426,178 @@ static void fill_metas_with_results( fingerprint_request_t *p_r, acoustid_finger
     }
 }
 
+/* Publishes the job's results, and disposes of the job */
+static void PostResult( fingerprinter_thread_t *p_fingerprinter,
+                        fingerprinter_job_t *p_job )
+{
+    fingerprinter_sys_t *p_sys = p_fingerprinter->p_sys;
+    fingerprint_request_t *p_data = p_job->p_request;
+
+    fill_metas_with_results( p_data, &p_job->fingerprint );
+
+    p_job->p_request = NULL;
+    free( p_job->psz_uri );
+    CleanFingerprint( &p_job->fingerprint );
+    free( p_job );
+
+    /* copy results */
+    vlc_mutex_lock( &p_sys->results.lock );
+    vlc_array_append( &p_sys->results.queue, p_data );
+    vlc_mutex_unlock( &p_sys->results.lock );
+
+    var_TriggerCallback( p_fingerprinter, "results-available" );
+}
+
+/* Pops the oldest entry of a queue, waiting for one if needed.
+ * This is a cancellation point. */
+static void *WaitQueue( vlc_array_t *p_queue, vlc_mutex_t *p_lock,
+                        vlc_cond_t *p_cond )
+{
+    void *p_entry;
+
+    vlc_mutex_lock( p_lock );
+    mutex_cleanup_push( p_lock );
+    while( vlc_array_count( p_queue ) == 0 )
+        vlc_cond_wait( p_cond, p_lock );
+    p_entry = vlc_array_item_at_index( p_queue, 0 );
+    vlc_array_remove( p_queue, 0 );
+    vlc_cleanup_pop();
+    vlc_mutex_unlock( p_lock );
+
+    return p_entry;
+}
+
 /*****************************************************************************
- * Run :
+ * Run : fingerprinting worker, one per thread of the pool
  *****************************************************************************/
 static void *Run( void *opaque )
 {
     fingerprinter_thread_t *p_fingerprinter = opaque;
     fingerprinter_sys_t *p_sys = p_fingerprinter->p_sys;
 
-    vlc_mutex_lock( &p_sys->processing.lock );
-    mutex_cleanup_push( &p_sys->processing.lock );
-
     /* main loop */
     for (;;)
     {
-        msleep( CLOCK_FREQ );
-
-        QueueIncomingRequests( p_sys );
+        fingerprint_request_t *p_data =
+            WaitQueue( &p_sys->incoming.queue, &p_sys->incoming.lock,
+                       &p_sys->incoming.cond );
 
-        vlc_testcancel();
+        int canc = vlc_savecancel();
 
-        for ( size_t i = 0 ; i < vlc_array_count( &p_sys->processing.queue ); i++ )
+        fingerprinter_job_t *p_job = calloc( 1, sizeof(*p_job) );
+        if( unlikely(p_job == NULL) )
         {
-            int canc = vlc_savecancel();
-            fingerprint_request_t *p_data = vlc_array_item_at_index( &p_sys->processing.queue, i );
+            fingerprint_request_Delete( p_data );
+            vlc_restorecancel( canc );
+            continue;
+        }
+        p_job->p_request = p_data;
 
-            char *psz_uri = input_item_GetURI( p_data->p_item );
-            if ( psz_uri != NULL )
+        /* overwrite with hint, as in this case, fingerprint's session will be truncated */
+        if ( p_data->i_duration )
+            p_job->fingerprint.i_duration = p_data->i_duration;
+
+        p_job->psz_uri = input_item_GetURI( p_data->p_item );
+        if ( p_job->psz_uri != NULL )
+        {
+            /* Unchanged file: neither decode nor query again */
+            if( p_sys->p_cache &&
+                fingerprinter_cache_Get( p_sys->p_cache, p_job->psz_uri,
+                                         &p_job->fingerprint ) )
             {
-                 acoustid_fingerprint_t acoustid_print;
+                msg_Dbg( p_fingerprinter, "%s found in cache", p_job->psz_uri );
+                PostResult( p_fingerprinter, p_job );
+                vlc_restorecancel( canc );
+                continue;
+            }
 
-                 memset( &acoustid_print , 0, sizeof (acoustid_print) );
-                /* overwrite with hint, as in this case, fingerprint's session will be truncated */
-                if ( p_data->i_duration )
-                     acoustid_print.i_duration = p_data->i_duration;
+#ifdef HAVE_CHROMAPRINT
+            /* Decode only, as fast as possible; fall back to a full input
+             * and chromaprint stream output if that can't be done */
+            if( fingerprinter_Extract( VLC_OBJECT(p_fingerprinter), p_job->psz_uri,
+                                       &p_job->fingerprint ) != VLC_SUCCESS )
+#endif
+                DoFingerprint( p_fingerprinter, &p_job->fingerprint, p_job->psz_uri );
+        }
 
-                DoFingerprint( p_fingerprinter, &acoustid_print, psz_uri );
-                free( psz_uri );
+        /* hand over to the lookup thread, and go on with the next decode */
+        vlc_mutex_lock( &p_sys->lookup.lock );
+        vlc_array_append( &p_sys->lookup.queue, p_job );
+        vlc_cond_signal( &p_sys->lookup.cond );
+        vlc_mutex_unlock( &p_sys->lookup.lock );
 
-                DoAcoustIdWebRequest( VLC_OBJECT(p_fingerprinter), &acoustid_print );
-                fill_metas_with_results( p_data, &acoustid_print );
+        vlc_restorecancel( canc );
+    }
 
-                for( unsigned j = 0; j < acoustid_print.results.count; j++ )
-                     free_acoustid_result_t( &acoustid_print.results.p_results[j] );
-                if( acoustid_print.results.count )
-                    free( acoustid_print.results.p_results );
-                free( acoustid_print.psz_fingerprint );
-            }
-            vlc_restorecancel(canc);
+    vlc_assert_unreachable();
+}
 
-            /* copy results */
-            vlc_mutex_lock( &p_sys->results.lock );
-            vlc_array_append( &p_sys->results.queue, p_data );
-            vlc_mutex_unlock( &p_sys->results.lock );
+/*****************************************************************************
+ * RunLookup : AcoustID queries, overlapped with the workers' decoding
+ *****************************************************************************/
+static void Lookup( fingerprinter_thread_t *p_fingerprinter,
+                    fingerprinter_job_t **pp_jobs, size_t i_jobs )
+{
+    fingerprinter_sys_t *p_sys = p_fingerprinter->p_sys;
+    acoustid_fingerprint_t *pp_fps[ACOUSTID_MAX_BATCH];
+    bool pb_answered[ACOUSTID_MAX_BATCH];
+    size_t i_fps = 0;
 
-            vlc_testcancel();
-        }
+    for( size_t i = 0; i < i_jobs; i++ )
+    {
+        /* nothing to query for failed fingerprints */
+        if( pp_jobs[i]->fingerprint.psz_fingerprint == NULL )
+            PostResult( p_fingerprinter, pp_jobs[i] );
+        else
+            pp_jobs[i_fps++] = pp_jobs[i];
+    }
+    for( size_t i = 0; i < i_fps; i++ )
+        pp_fps[i] = &pp_jobs[i]->fingerprint;
+
+    if( i_fps > 0 &&
+        DoAcoustIdWebRequests( VLC_OBJECT(p_fingerprinter), pp_fps,
+                               pb_answered, i_fps ) == VLC_SUCCESS &&
+        p_sys->p_cache )
+    {
+        for( size_t i = 0; i < i_fps; i++ )
+            if( pb_answered[i] && pp_jobs[i]->psz_uri )
+                fingerprinter_cache_Put( p_sys->p_cache, pp_jobs[i]->psz_uri,
+                                         &pp_jobs[i]->fingerprint );
+    }
+
+    for( size_t i = 0; i < i_fps; i++ )
+        PostResult( p_fingerprinter, pp_jobs[i] );
+}
 
-        if ( vlc_array_count( &p_sys->processing.queue ) )
+static void *RunLookup( void *opaque )
+{
+    fingerprinter_thread_t *p_fingerprinter = opaque;
+    fingerprinter_sys_t *p_sys = p_fingerprinter->p_sys;
+    fingerprinter_job_t *pp_jobs[ACOUSTID_MAX_BATCH];
+
+    for (;;)
+    {
+        pp_jobs[0] = WaitQueue( &p_sys->lookup.queue, &p_sys->lookup.lock,
+                                &p_sys->lookup.cond );
+
+        int canc = vlc_savecancel();
+
+        /* Don't wait for a full batch: only group the jobs that piled up
+         * while the previous request was in flight */
+        size_t i_jobs = 1;
+        vlc_mutex_lock( &p_sys->lookup.lock );
+        while( i_jobs < p_sys->i_batch &&
+               vlc_array_count( &p_sys->lookup.queue ) > 0 )
         {
-            var_TriggerCallback( p_fingerprinter, "results-available" );
-            vlc_array_clear( &p_sys->processing.queue );
+            pp_jobs[i_jobs++] = vlc_array_item_at_index( &p_sys->lookup.queue, 0 );
+            vlc_array_remove( &p_sys->lookup.queue, 0 );
         }
+        vlc_mutex_unlock( &p_sys->lookup.lock );
+
+        Lookup( p_fingerprinter, pp_jobs, i_jobs );
+
+        vlc_restorecancel( canc );
     }
 
-    vlc_cleanup_pop();
     vlc_assert_unreachable();
 }
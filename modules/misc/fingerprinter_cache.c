@@ -0,0 +1,641 @@
+/*****************************************************************************
+ * fingerprinter_cache.c: On-disk cache of fingerprints and AcoustID results
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef HAVE_FLOCK
+# include <sys/file.h>
+#endif
+#ifdef HAVE_MMAP
+# include <sys/mman.h>
+#endif
+
+#include <vlc_common.h>
+#include <vlc_arrays.h>
+#include <vlc_configuration.h>
+#include <vlc_fs.h>
+#include <vlc_memstream.h>
+#include <vlc_url.h>
+
+#include "webservices/acoustid.h"
+#include "fingerprinter_cache.h"
+
+/*
+ * The cache file is a magic header followed by records appended one after
+ * the other, each prefixed by its length:
+ *
+ *  u64 file size, i64 file mtime, str path,
+ *  u32 duration, str fingerprint,
+ *  u32 result count, { f64 score, str id,
+ *                      u32 recording count, { str artist, str title,
+ *                                             str musicbrainz id } }
+ *
+ * where str is a u32 length followed by the bytes (no terminating nul, and
+ * a 0 length for NULL). Numbers are in host byte order: the file is a local
+ * cache, not meant to be shared between machines. A newer record for the
+ * same path supersedes the older ones.
+ *
+ * Several processes may use the file: it is locked while being appended to.
+ * When superseded records take most of it, the live ones are written to a
+ * new file that replaces it, so that the existing mappings remain valid.
+ */
+#define CACHE_FILENAME "fingerprints.dat"
+#define CACHE_MAGIC    "VLCFPC01"
+#define CACHE_MAGIC_SIZE 8
+#define CACHE_COMPACT_MIN (64 * 1024) /* superseded bytes */
+
+typedef struct
+{
+    uint64_t       i_size;
+    int64_t        i_mtime;
+    const uint8_t *p_record;     /* record payload, after the length */
+    size_t         i_record;
+    bool           b_owned;      /* appended during this session */
+} cache_entry_t;
+
+struct fingerprinter_cache_t
+{
+    vlc_object_t    *p_obj;
+    vlc_mutex_t      lock;
+    char            *psz_file;
+    int              fd;
+
+    const uint8_t   *p_map;
+    size_t           i_map;
+
+    vlc_dictionary_t entries;    /* path -> cache_entry_t */
+};
+
+/*****************************************************************************
+ * Record reading
+ *****************************************************************************/
+typedef struct
+{
+    const uint8_t *p;
+    size_t         i_left;
+    bool           b_error;
+} reader_t;
+
+static void Read( reader_t *r, void *p_dst, size_t i_size )
+{
+    if( r->b_error || r->i_left < i_size )
+    {
+        r->b_error = true;
+        memset( p_dst, 0, i_size );
+        return;
+    }
+    memcpy( p_dst, r->p, i_size );
+    r->p += i_size;
+    r->i_left -= i_size;
+}
+
+static uint32_t ReadU32( reader_t *r )
+{
+    uint32_t i_val;
+    Read( r, &i_val, sizeof(i_val) );
+    return i_val;
+}
+
+/* Returns a pointer inside the record, and its length */
+static const char *ReadStringRef( reader_t *r, uint32_t *pi_len )
+{
+    *pi_len = ReadU32( r );
+    if( r->b_error || r->i_left < *pi_len )
+    {
+        r->b_error = true;
+        return NULL;
+    }
+    const char *psz = (const char *) r->p;
+    r->p += *pi_len;
+    r->i_left -= *pi_len;
+    return psz;
+}
+
+static char *ReadString( reader_t *r )
+{
+    uint32_t i_len;
+    const char *psz = ReadStringRef( r, &i_len );
+    if( psz == NULL || i_len == 0 )
+        return NULL;
+    return strndup( psz, i_len );
+}
+
+/*****************************************************************************
+ * Record writing
+ *****************************************************************************/
+static void WriteString( struct vlc_memstream *ms, const char *psz )
+{
+    uint32_t i_len = psz ? strlen( psz ) : 0;
+    vlc_memstream_write( ms, &i_len, sizeof(i_len) );
+    vlc_memstream_write( ms, psz, i_len );
+}
+
+static void WriteU32( struct vlc_memstream *ms, uint32_t i_val )
+{
+    vlc_memstream_write( ms, &i_val, sizeof(i_val) );
+}
+
+/*****************************************************************************
+ * Index
+ *****************************************************************************/
+static void FreeEntry( void *p_data, void *p_obj )
+{
+    VLC_UNUSED( p_obj );
+    cache_entry_t *p_entry = p_data;
+    if( p_entry->b_owned )
+        free( (void *) p_entry->p_record );
+    free( p_entry );
+}
+
+static void Index( fingerprinter_cache_t *p_cache, const uint8_t *p_record,
+                   size_t i_record, bool b_owned )
+{
+    reader_t r = { p_record, i_record, false };
+    uint64_t i_size;
+    int64_t i_mtime;
+    uint32_t i_path;
+
+    Read( &r, &i_size, sizeof(i_size) );
+    Read( &r, &i_mtime, sizeof(i_mtime) );
+    const char *psz_path = ReadStringRef( &r, &i_path );
+    if( r.b_error || i_path == 0 )
+        goto error;
+
+    char *psz_key = strndup( psz_path, i_path );
+    cache_entry_t *p_entry = malloc( sizeof(*p_entry) );
+    if( unlikely(psz_key == NULL || p_entry == NULL) )
+    {
+        free( psz_key );
+        free( p_entry );
+        goto error;
+    }
+    p_entry->i_size = i_size;
+    p_entry->i_mtime = i_mtime;
+    p_entry->p_record = p_record;
+    p_entry->i_record = i_record;
+    p_entry->b_owned = b_owned;
+
+    vlc_dictionary_remove_value_for_key( &p_cache->entries, psz_key,
+                                         FreeEntry, NULL );
+    vlc_dictionary_insert( &p_cache->entries, psz_key, p_entry );
+    free( psz_key );
+    return;
+
+error:
+    if( b_owned )
+        free( (void *) p_record );
+}
+
+/* Walks the records of the mapped file. Returns the offset of the end of the
+ * last complete record */
+static size_t Load( fingerprinter_cache_t *p_cache )
+{
+    size_t i_offset = CACHE_MAGIC_SIZE;
+
+    while( p_cache->i_map - i_offset >= sizeof(uint32_t) )
+    {
+        uint32_t i_record;
+        memcpy( &i_record, &p_cache->p_map[i_offset], sizeof(i_record) );
+        if( i_record > p_cache->i_map - i_offset - sizeof(i_record) )
+            break; /* truncated by a crash while appending */
+
+        Index( p_cache, &p_cache->p_map[i_offset + sizeof(i_record)],
+               i_record, false );
+        i_offset += sizeof(i_record) + i_record;
+    }
+    return i_offset;
+}
+
+static char *GetKey( const char *psz_uri, uint64_t *pi_size, int64_t *pi_mtime )
+{
+    char *psz_path = vlc_uri2path( psz_uri );
+    if( psz_path == NULL )
+        return NULL; /* not a local file */
+
+    struct stat st;
+    if( vlc_stat( psz_path, &st ) || !S_ISREG( st.st_mode ) )
+    {
+        free( psz_path );
+        return NULL;
+    }
+    *pi_size = st.st_size;
+    *pi_mtime = st.st_mtime;
+    return psz_path;
+}
+
+/*****************************************************************************
+ * Inter-process locking
+ *****************************************************************************/
+static int LockFd( int fd, bool b_lock )
+{
+#ifdef HAVE_FLOCK
+    return flock( fd, b_lock ? LOCK_EX : LOCK_UN );
+#elif defined (HAVE_FCNTL) && defined (F_SETLKW)
+    struct flock lock = {
+        .l_type = b_lock ? F_WRLCK : F_UNLCK,
+        .l_whence = SEEK_SET,
+    };
+    return fcntl( fd, F_SETLKW, &lock );
+#else
+    VLC_UNUSED( fd ); VLC_UNUSED( b_lock );
+    return 0;
+#endif
+}
+
+/* Locks the cache file. The lock is bound to the file, not its name: if
+ * another process replaced it meanwhile, the new one is opened and locked. */
+static int Lock( fingerprinter_cache_t *p_cache )
+{
+    for( ;; )
+    {
+        if( LockFd( p_cache->fd, true ) )
+            return -1;
+
+        struct stat st_fd, st_file;
+        if( fstat( p_cache->fd, &st_fd ) == 0 &&
+            vlc_stat( p_cache->psz_file, &st_file ) == 0 &&
+            st_fd.st_dev == st_file.st_dev && st_fd.st_ino == st_file.st_ino )
+            return 0;
+
+        int fd = vlc_open( p_cache->psz_file, O_RDWR | O_CREAT, 0600 );
+        if( fd == -1 )
+        {
+            LockFd( p_cache->fd, false );
+            return -1;
+        }
+        vlc_close( p_cache->fd ); /* also unlocks */
+        p_cache->fd = fd;
+    }
+}
+
+static void Unlock( fingerprinter_cache_t *p_cache )
+{
+    LockFd( p_cache->fd, false );
+}
+
+static int WriteRecord( int fd, const cache_entry_t *p_entry )
+{
+    uint32_t i_record = p_entry->i_record;
+    if( write( fd, &i_record, sizeof(i_record) ) != sizeof(i_record) ||
+        write( fd, p_entry->p_record, i_record ) != (ssize_t) i_record )
+        return -1;
+    return 0;
+}
+
+/* Replaces the cache file with its live records, if superseded ones take
+ * most of it. Called with the file locked, before anything is appended. */
+static void Compact( fingerprinter_cache_t *p_cache, size_t i_valid )
+{
+    char **ppsz_keys = vlc_dictionary_all_keys( &p_cache->entries );
+    if( ppsz_keys == NULL )
+        return;
+
+    size_t i_live = CACHE_MAGIC_SIZE;
+    for( char **ppsz = ppsz_keys; *ppsz != NULL; ppsz++ )
+    {
+        const cache_entry_t *p_entry =
+                vlc_dictionary_value_for_key( &p_cache->entries, *ppsz );
+        i_live += sizeof(uint32_t) + p_entry->i_record;
+    }
+
+    if( i_valid - i_live < CACHE_COMPACT_MIN || i_valid - i_live < i_live )
+        goto out;
+
+    char *psz_tmp;
+    if( asprintf( &psz_tmp, "%s.tmp", p_cache->psz_file ) == -1 )
+        goto out;
+
+    int fd = vlc_open( psz_tmp, O_RDWR | O_CREAT | O_TRUNC, 0600 );
+    if( fd == -1 )
+    {
+        free( psz_tmp );
+        goto out;
+    }
+
+    bool b_error = write( fd, CACHE_MAGIC, CACHE_MAGIC_SIZE ) != CACHE_MAGIC_SIZE;
+    for( char **ppsz = ppsz_keys; *ppsz != NULL && !b_error; ppsz++ )
+        b_error = WriteRecord( fd, vlc_dictionary_value_for_key(
+                                            &p_cache->entries, *ppsz ) );
+
+    if( b_error || vlc_rename( psz_tmp, p_cache->psz_file ) )
+    {
+        msg_Warn( p_cache->p_obj, "cannot compact fingerprints cache: %s",
+                  vlc_strerror_c( errno ) );
+        vlc_close( fd );
+        vlc_unlink( psz_tmp );
+    }
+    else
+    {
+        msg_Dbg( p_cache->p_obj, "compacted fingerprints cache from %zu to "
+                 "%zu bytes", i_valid, i_live );
+        vlc_close( p_cache->fd ); /* also unlocks */
+        p_cache->fd = fd;
+    }
+    free( psz_tmp );
+out:
+    for( char **ppsz = ppsz_keys; *ppsz != NULL; ppsz++ )
+        free( *ppsz );
+    free( ppsz_keys );
+}
+
+/*****************************************************************************
+ * Public API
+ *****************************************************************************/
+fingerprinter_cache_t *fingerprinter_cache_Open( vlc_object_t *p_obj )
+{
+    char *psz_dir = config_GetUserDir( VLC_CACHE_DIR );
+    if( psz_dir == NULL )
+        return NULL;
+
+    char *psz_file;
+    if( vlc_mkdir( psz_dir, 0700 ) && errno != EEXIST )
+    {
+        free( psz_dir );
+        return NULL;
+    }
+    if( asprintf( &psz_file, "%s"DIR_SEP CACHE_FILENAME, psz_dir ) == -1 )
+    {
+        free( psz_dir );
+        return NULL;
+    }
+    free( psz_dir );
+
+    fingerprinter_cache_t *p_cache = calloc( 1, sizeof(*p_cache) );
+    if( unlikely(p_cache == NULL) )
+    {
+        free( psz_file );
+        return NULL;
+    }
+    p_cache->p_obj = p_obj;
+    p_cache->psz_file = psz_file;
+    vlc_mutex_init( &p_cache->lock );
+    vlc_dictionary_init( &p_cache->entries, 1024 );
+
+    p_cache->fd = vlc_open( psz_file, O_RDWR | O_CREAT, 0600 );
+    if( p_cache->fd == -1 )
+    {
+        msg_Warn( p_obj, "cannot open fingerprints cache %s: %s", psz_file,
+                  vlc_strerror_c( errno ) );
+        goto error;
+    }
+    msg_Dbg( p_obj, "using fingerprints cache %s", psz_file );
+
+    if( Lock( p_cache ) )
+        goto error;
+
+    struct stat st;
+    if( fstat( p_cache->fd, &st ) )
+        goto error_unlock;
+
+    size_t i_valid = 0;
+    if( st.st_size >= CACHE_MAGIC_SIZE && (uint64_t) st.st_size <= SIZE_MAX )
+    {
+        p_cache->i_map = st.st_size;
+#ifdef HAVE_MMAP
+        void *p_map = mmap( NULL, p_cache->i_map, PROT_READ, MAP_PRIVATE,
+                            p_cache->fd, 0 );
+        p_cache->p_map = ( p_map != MAP_FAILED ) ? p_map : NULL;
+#else
+        uint8_t *p_map = malloc( p_cache->i_map );
+        if( p_map && pread( p_cache->fd, p_map, p_cache->i_map, 0 )
+                     != (ssize_t) p_cache->i_map )
+        {
+            free( p_map );
+            p_map = NULL;
+        }
+        p_cache->p_map = p_map;
+#endif
+        if( p_cache->p_map == NULL )
+            p_cache->i_map = 0;
+        else if( !memcmp( p_cache->p_map, CACHE_MAGIC, CACHE_MAGIC_SIZE ) )
+            i_valid = Load( p_cache );
+    }
+
+    /* Start over on a bad header, and drop any partially written tail */
+    if( i_valid == 0 )
+    {
+        if( ftruncate( p_cache->fd, 0 ) ||
+            write( p_cache->fd, CACHE_MAGIC, CACHE_MAGIC_SIZE ) != CACHE_MAGIC_SIZE )
+            goto error_unlock;
+        i_valid = CACHE_MAGIC_SIZE;
+    }
+    else if( i_valid < (size_t) st.st_size && ftruncate( p_cache->fd, i_valid ) )
+        goto error_unlock;
+    else
+        Compact( p_cache, i_valid );
+    Unlock( p_cache );
+
+    msg_Dbg( p_obj, "%d cached fingerprints",
+             vlc_dictionary_keys_count( &p_cache->entries ) );
+    return p_cache;
+
+error_unlock:
+    Unlock( p_cache );
+error:
+    fingerprinter_cache_Close( p_cache );
+    return NULL;
+}
+
+void fingerprinter_cache_Close( fingerprinter_cache_t *p_cache )
+{
+    vlc_dictionary_clear( &p_cache->entries, FreeEntry, NULL );
+    if( p_cache->p_map )
+#ifdef HAVE_MMAP
+        munmap( (void *) p_cache->p_map, p_cache->i_map );
+#else
+        free( (void *) p_cache->p_map );
+#endif
+    if( p_cache->fd != -1 )
+        vlc_close( p_cache->fd );
+    vlc_mutex_destroy( &p_cache->lock );
+    free( p_cache->psz_file );
+    free( p_cache );
+}
+
+bool fingerprinter_cache_Get( fingerprinter_cache_t *p_cache,
+                              const char *psz_uri,
+                              acoustid_fingerprint_t *fp )
+{
+    uint64_t i_size;
+    int64_t i_mtime;
+    char *psz_key = GetKey( psz_uri, &i_size, &i_mtime );
+    if( psz_key == NULL )
+        return false;
+
+    vlc_mutex_lock( &p_cache->lock );
+
+    cache_entry_t *p_entry =
+            vlc_dictionary_value_for_key( &p_cache->entries, psz_key );
+    free( psz_key );
+    if( p_entry == kVLCDictionaryNotFound ||
+        p_entry->i_size != i_size || p_entry->i_mtime != i_mtime )
+    {
+        vlc_mutex_unlock( &p_cache->lock );
+        return false;
+    }
+
+    reader_t r = { p_entry->p_record, p_entry->i_record, false };
+    uint32_t i_skip;
+
+    /* size, mtime and path were checked already */
+    r.p += 16; r.i_left -= 16;
+    ReadStringRef( &r, &i_skip );
+
+    uint32_t i_duration = ReadU32( &r );
+    fp->psz_fingerprint = ReadString( &r );
+
+    uint32_t i_results = ReadU32( &r );
+    if( !r.b_error && i_results > 0 && i_results <= r.i_left )
+    {
+        fp->results.p_results = calloc( i_results, sizeof(acoustid_result_t) );
+        if( fp->results.p_results )
+            fp->results.count = i_results;
+    }
+    for( unsigned i = 0; i < fp->results.count; i++ )
+    {
+        acoustid_result_t *p_result = &fp->results.p_results[i];
+        Read( &r, &p_result->d_score, sizeof(p_result->d_score) );
+        p_result->psz_id = ReadString( &r );
+
+        uint32_t i_recordings = ReadU32( &r );
+        if( r.b_error || i_recordings == 0 || i_recordings > r.i_left )
+            continue;
+        p_result->recordings.p_recordings =
+                calloc( i_recordings, sizeof(musicbrainz_recording_t) );
+        if( !p_result->recordings.p_recordings )
+            continue;
+        p_result->recordings.count = i_recordings;
+
+        for( unsigned j = 0; j < i_recordings; j++ )
+        {
+            musicbrainz_recording_t *p_record =
+                    &p_result->recordings.p_recordings[j];
+            uint32_t i_len;
+            p_record->psz_artist = ReadString( &r );
+            p_record->psz_title = ReadString( &r );
+            const char *psz_mbid = ReadStringRef( &r, &i_len );
+            if( psz_mbid )
+                memcpy( p_record->s_musicbrainz_id, psz_mbid,
+                        __MIN( i_len, MB_ID_SIZE ) );
+        }
+    }
+
+    vlc_mutex_unlock( &p_cache->lock );
+
+    if( r.b_error || fp->psz_fingerprint == NULL )
+    {
+        msg_Warn( p_cache->p_obj, "corrupted fingerprints cache entry" );
+        for( unsigned i = 0; i < fp->results.count; i++ )
+            free_acoustid_result_t( &fp->results.p_results[i] );
+        free( fp->results.p_results );
+        free( fp->psz_fingerprint );
+        /* keep the caller duration hint */
+        fp->psz_fingerprint = NULL;
+        fp->results.p_results = NULL;
+        fp->results.count = 0;
+        return false;
+    }
+    fp->i_duration = i_duration;
+    return true;
+}
+
+void fingerprinter_cache_Put( fingerprinter_cache_t *p_cache,
+                              const char *psz_uri,
+                              const acoustid_fingerprint_t *fp )
+{
+    uint64_t i_size;
+    int64_t i_mtime;
+    char *psz_key = GetKey( psz_uri, &i_size, &i_mtime );
+    if( psz_key == NULL )
+        return;
+
+    struct vlc_memstream ms;
+    if( vlc_memstream_open( &ms ) )
+    {
+        free( psz_key );
+        return;
+    }
+
+    WriteU32( &ms, 0 ); /* record length, patched below */
+    vlc_memstream_write( &ms, &i_size, sizeof(i_size) );
+    vlc_memstream_write( &ms, &i_mtime, sizeof(i_mtime) );
+    WriteString( &ms, psz_key );
+    WriteU32( &ms, fp->i_duration );
+    WriteString( &ms, fp->psz_fingerprint );
+    WriteU32( &ms, fp->results.count );
+    for( unsigned i = 0; i < fp->results.count; i++ )
+    {
+        const acoustid_result_t *p_result = &fp->results.p_results[i];
+        vlc_memstream_write( &ms, &p_result->d_score, sizeof(p_result->d_score) );
+        WriteString( &ms, p_result->psz_id );
+        WriteU32( &ms, p_result->recordings.count );
+        for( unsigned j = 0; j < p_result->recordings.count; j++ )
+        {
+            const musicbrainz_recording_t *p_record =
+                    &p_result->recordings.p_recordings[j];
+            WriteString( &ms, p_record->psz_artist );
+            WriteString( &ms, p_record->psz_title );
+            WriteU32( &ms, strnlen( p_record->s_musicbrainz_id, MB_ID_SIZE ) );
+            vlc_memstream_write( &ms, p_record->s_musicbrainz_id,
+                                 strnlen( p_record->s_musicbrainz_id, MB_ID_SIZE ) );
+        }
+    }
+    free( psz_key );
+
+    if( vlc_memstream_close( &ms ) )
+        return;
+
+    uint32_t i_record = ms.length - sizeof(i_record);
+    memcpy( ms.ptr, &i_record, sizeof(i_record) );
+
+    vlc_mutex_lock( &p_cache->lock );
+    if( Lock( p_cache ) )
+    {
+        vlc_mutex_unlock( &p_cache->lock );
+        free( ms.ptr );
+        return;
+    }
+
+    /* Other processes may have appended, or recreated an empty file */
+    off_t i_end = lseek( p_cache->fd, 0, SEEK_END );
+    if( i_end == (off_t) -1 ||
+        ( i_end == 0 && write( p_cache->fd, CACHE_MAGIC, CACHE_MAGIC_SIZE )
+                        != CACHE_MAGIC_SIZE ) ||
+        write( p_cache->fd, ms.ptr, ms.length ) != (ssize_t) ms.length )
+    {
+        msg_Warn( p_cache->p_obj, "cannot write fingerprints cache: %s",
+                  vlc_strerror_c( errno ) );
+        Unlock( p_cache );
+        vlc_mutex_unlock( &p_cache->lock );
+        free( ms.ptr );
+        return;
+    }
+    Unlock( p_cache );
+
+    /* Keep the payload in memory, so the entry is usable right away */
+    memmove( ms.ptr, ms.ptr + sizeof(i_record), i_record );
+    Index( p_cache, (uint8_t *) ms.ptr, i_record, true );
+    vlc_mutex_unlock( &p_cache->lock );
+}
@@ -0,0 +1,43 @@
+/*****************************************************************************
+ * fingerprinter_cache.h: On-disk cache of fingerprints and AcoustID results
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef FINGERPRINTER_CACHE_H
+# define FINGERPRINTER_CACHE_H
+
+struct acoustid_fingerprint_t;
+
+typedef struct fingerprinter_cache_t fingerprinter_cache_t;
+
+/* Maps the cache file from the user cache directory. Entries are keyed by
+ * local path, and only valid while the file size and mtime are unchanged. */
+fingerprinter_cache_t *fingerprinter_cache_Open( vlc_object_t *p_obj );
+void fingerprinter_cache_Close( fingerprinter_cache_t *p_cache );
+
+/* Fills an empty fp (fingerprint, duration and results) on a hit, and leaves
+ * it unchanged otherwise */
+bool fingerprinter_cache_Get( fingerprinter_cache_t *p_cache,
+                              const char *psz_uri,
+                              struct acoustid_fingerprint_t *fp );
+/* Stores a fingerprint and its AcoustID results, replacing any older entry */
+void fingerprinter_cache_Put( fingerprinter_cache_t *p_cache,
+                              const char *psz_uri,
+                              const struct acoustid_fingerprint_t *fp );
+
+#endif
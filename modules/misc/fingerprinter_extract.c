@@ -0,0 +1,439 @@
+/*****************************************************************************
+ * fingerprinter_extract.c: Direct (decode only) chromaprint extraction
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_modules.h>
+#include <vlc_stream.h>
+#include <vlc_demux.h>
+#include <vlc_es_out.h>
+#include <vlc_codec.h>
+#include <vlc_aout.h>
+#include <vlc_input.h>
+
+#ifdef _WIN32
+# define CHROMAPRINT_NODLL
+#endif
+
+#include <chromaprint.h> /* chromaprint lib */
+#include "webservices/acoustid.h"
+#include "fingerprinter_extract.h"
+
+/* Same default as the chromaprint stream output */
+#define DEFAULT_DURATION 90
+
+/*****************************************************************************
+ * Local prototypes
+ *****************************************************************************/
+struct es_out_id_t
+{
+    bool b_selected;
+};
+
+struct es_out_sys_t
+{
+    vlc_object_t        *p_obj;
+
+    es_out_id_t         *p_selected;        /* the one audio track we decode */
+    es_format_t          fmt_selected;
+    decoder_t           *p_packetizer;
+    decoder_t           *p_decoder;
+
+    aout_filters_t      *p_filters;         /* to s16n, at most 2 channels */
+    audio_sample_format_t fmt_filtered;
+
+    ChromaprintContext  *p_chromaprint_ctx;
+    uint64_t             i_samples_left;
+    bool                 b_started;
+    bool                 b_done;
+    bool                 b_failed;
+};
+
+/*****************************************************************************
+ * Chromaprint feeding
+ *****************************************************************************/
+static void Feed( es_out_sys_t *p_sys, block_t *p_block )
+{
+    const unsigned i_channels = aout_FormatNbChannels( &p_sys->fmt_filtered );
+    uint64_t i_samples = p_block->i_buffer / (2 * i_channels);
+
+    if( i_samples > p_sys->i_samples_left )
+        i_samples = p_sys->i_samples_left;
+
+    if( i_samples > 0 &&
+        !chromaprint_feed( p_sys->p_chromaprint_ctx, p_block->p_buffer,
+                           i_samples * i_channels ) )
+        msg_Warn( p_sys->p_obj, "feed error" );
+
+    p_sys->i_samples_left -= i_samples;
+    if( p_sys->i_samples_left == 0 )
+        p_sys->b_done = true;
+
+    block_Release( p_block );
+}
+
+static int StartFilters( es_out_sys_t *p_sys, decoder_t *p_dec )
+{
+    audio_sample_format_t fmt_in = p_dec->fmt_out.audio;
+
+    /* decoders don't set audio.i_format, but audio filters use it */
+    fmt_in.i_format = p_dec->fmt_out.i_codec;
+    aout_FormatPrepare( &fmt_in );
+
+    if( !p_sys->b_started )
+    {
+        /* chromaprint resamples by itself: keep the source rate, and only
+         * downmix to what it accepts */
+        p_sys->fmt_filtered = fmt_in;
+        p_sys->fmt_filtered.i_format = VLC_CODEC_S16N;
+        p_sys->fmt_filtered.i_physical_channels =
+            ( aout_FormatNbChannels( &fmt_in ) == 1 ) ? AOUT_CHAN_CENTER
+                                                      : AOUT_CHANS_STEREO;
+        p_sys->fmt_filtered.i_chan_mode = 0;
+        aout_FormatPrepare( &p_sys->fmt_filtered );
+    }
+    else if( fmt_in.i_rate != p_sys->fmt_filtered.i_rate )
+    {
+        /* chromaprint cannot change rates midway, and a fingerprint of the
+         * remainder alone would not match the track */
+        msg_Err( p_sys->p_obj, "sample rate changed from %uHz to %uHz",
+                 p_sys->fmt_filtered.i_rate, fmt_in.i_rate );
+        return VLC_EGENERIC;
+    }
+
+    if( p_sys->p_filters )
+        aout_FiltersDelete( p_sys->p_obj, p_sys->p_filters );
+    p_sys->p_filters = aout_FiltersNew( p_sys->p_obj, &fmt_in,
+                                        &p_sys->fmt_filtered, NULL, NULL );
+    if( !p_sys->p_filters )
+    {
+        msg_Err( p_sys->p_obj, "cannot convert %4.4s to s16n",
+                 (const char *) &fmt_in.i_format );
+        return VLC_EGENERIC;
+    }
+
+    if( !p_sys->b_started )
+    {
+        const unsigned i_channels = aout_FormatNbChannels( &p_sys->fmt_filtered );
+        if( !chromaprint_start( p_sys->p_chromaprint_ctx,
+                                p_sys->fmt_filtered.i_rate, i_channels ) )
+        {
+            msg_Err( p_sys->p_obj, "Failed starting chromaprint on %uHz %uch samples",
+                     p_sys->fmt_filtered.i_rate, i_channels );
+            return VLC_EGENERIC;
+        }
+        p_sys->i_samples_left *= p_sys->fmt_filtered.i_rate;
+        p_sys->b_started = true;
+        msg_Dbg( p_sys->p_obj, "Starting chromaprint on %uHz %uch samples",
+                 p_sys->fmt_filtered.i_rate, i_channels );
+    }
+    return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * Decoder owner callbacks
+ *****************************************************************************/
+static int DecoderFormatUpdate( decoder_t *p_dec )
+{
+    es_out_sys_t *p_sys = p_dec->p_queue_ctx;
+
+    aout_FormatPrepare( &p_dec->fmt_out.audio );
+    if( p_dec->fmt_out.audio.i_bitspersample == 0 )
+        return -1;
+
+    /* Rebuilt lazily by the next queued buffer */
+    if( p_sys->p_filters )
+    {
+        aout_FiltersDelete( p_sys->p_obj, p_sys->p_filters );
+        p_sys->p_filters = NULL;
+    }
+    return 0;
+}
+
+static int DecoderQueueAudio( decoder_t *p_dec, block_t *p_block )
+{
+    es_out_sys_t *p_sys = p_dec->p_queue_ctx;
+
+    if( p_sys->b_done ||
+        ( !p_sys->p_filters && StartFilters( p_sys, p_dec ) != VLC_SUCCESS ) )
+    {
+        if( !p_sys->b_done )
+            p_sys->b_failed = true;
+        p_sys->b_done = true;
+        block_Release( p_block );
+        return -1;
+    }
+
+    p_block = aout_FiltersPlay( p_sys->p_filters, p_block, INPUT_RATE_DEFAULT );
+    if( p_block )
+        Feed( p_sys, p_block );
+    return 0;
+}
+
+static decoder_t *CreateDecoder( es_out_sys_t *p_sys, const es_format_t *p_fmt,
+                                 bool b_packetizer )
+{
+    decoder_t *p_dec = vlc_object_create( p_sys->p_obj, sizeof(*p_dec) );
+    if( unlikely(p_dec == NULL) )
+        return NULL;
+
+    es_format_Copy( &p_dec->fmt_in, p_fmt );
+    es_format_Init( &p_dec->fmt_out, p_fmt->i_cat, 0 );
+    p_dec->pf_aout_format_update = DecoderFormatUpdate;
+    p_dec->pf_queue_audio = DecoderQueueAudio;
+    p_dec->p_queue_ctx = p_sys;
+
+    if( b_packetizer )
+        p_dec->p_module = module_need( p_dec, "packetizer", "$packetizer", false );
+    else
+        p_dec->p_module = module_need( p_dec, "audio decoder", "$codec", false );
+
+    if( !p_dec->p_module )
+    {
+        es_format_Clean( &p_dec->fmt_in );
+        es_format_Clean( &p_dec->fmt_out );
+        vlc_object_release( p_dec );
+        return NULL;
+    }
+    return p_dec;
+}
+
+static void DeleteDecoder( decoder_t *p_dec )
+{
+    if( !p_dec )
+        return;
+    module_unneed( p_dec, p_dec->p_module );
+    if( p_dec->p_description )
+        vlc_meta_Delete( p_dec->p_description );
+    es_format_Clean( &p_dec->fmt_in );
+    es_format_Clean( &p_dec->fmt_out );
+    vlc_object_release( p_dec );
+}
+
+static void Decode( es_out_sys_t *p_sys, block_t *p_block )
+{
+    if( !p_sys->p_decoder )
+    {
+        /* Created late so that packetizers had a chance to fill in the
+         * format from the first frames */
+        p_sys->p_decoder = CreateDecoder( p_sys, p_sys->p_packetizer
+                                               ? &p_sys->p_packetizer->fmt_out
+                                               : &p_sys->fmt_selected, false );
+        if( !p_sys->p_decoder )
+        {
+            msg_Warn( p_sys->p_obj, "cannot find audio decoder for %4.4s",
+                      (const char *) &p_sys->fmt_selected.i_codec );
+            p_sys->b_done = true;
+            block_Release( p_block );
+            return;
+        }
+    }
+
+    if( p_sys->p_decoder->pf_decode( p_sys->p_decoder, p_block ) != VLCDEC_SUCCESS )
+        p_sys->b_done = true;
+}
+
+/*****************************************************************************
+ * es_out callbacks: only the first audio track is decoded, the rest dropped
+ *****************************************************************************/
+static es_out_id_t *EsOutAdd( es_out_t *out, const es_format_t *p_fmt )
+{
+    es_out_sys_t *p_sys = out->p_sys;
+    es_out_id_t *id = malloc( sizeof(*id) );
+    if( unlikely(id == NULL) )
+        return NULL;
+    id->b_selected = false;
+
+    if( p_fmt->i_cat != AUDIO_ES || p_sys->p_selected )
+        return id;
+
+    if( es_format_Copy( &p_sys->fmt_selected, p_fmt ) != VLC_SUCCESS )
+        return id;
+
+    if( !p_fmt->b_packetized )
+    {
+        p_sys->p_packetizer = CreateDecoder( p_sys, p_fmt, true );
+        if( p_sys->p_packetizer )
+            p_sys->p_packetizer->fmt_out.b_packetized = true;
+    }
+
+    id->b_selected = true;
+    p_sys->p_selected = id;
+    return id;
+}
+
+static int EsOutSend( es_out_t *out, es_out_id_t *id, block_t *p_block )
+{
+    es_out_sys_t *p_sys = out->p_sys;
+
+    if( !id->b_selected || p_sys->b_done )
+    {
+        block_Release( p_block );
+        return VLC_SUCCESS;
+    }
+
+    if( p_sys->p_packetizer )
+    {
+        block_t *p_packet;
+        while( ( p_packet = p_sys->p_packetizer->pf_packetize(
+                                p_sys->p_packetizer, &p_block ) ) != NULL )
+        {
+            while( p_packet )
+            {
+                block_t *p_next = p_packet->p_next;
+                p_packet->p_next = NULL;
+                if( p_sys->b_done )
+                    block_Release( p_packet );
+                else
+                    Decode( p_sys, p_packet );
+                p_packet = p_next;
+            }
+        }
+    }
+    else
+        Decode( p_sys, p_block );
+
+    return VLC_SUCCESS;
+}
+
+static void EsOutDel( es_out_t *out, es_out_id_t *id )
+{
+    es_out_sys_t *p_sys = out->p_sys;
+
+    if( id == p_sys->p_selected )
+    {
+        /* drain whatever the decoder still holds */
+        if( !p_sys->b_done && p_sys->p_decoder )
+            p_sys->p_decoder->pf_decode( p_sys->p_decoder, NULL );
+        p_sys->p_selected = NULL;
+    }
+    free( id );
+}
+
+static int EsOutControl( es_out_t *out, int i_query, va_list args )
+{
+    VLC_UNUSED( out );
+
+    switch( i_query )
+    {
+        case ES_OUT_GET_ES_STATE:
+        {
+            es_out_id_t *id = va_arg( args, es_out_id_t * );
+            bool *pb = va_arg( args, bool * );
+            *pb = id->b_selected;
+            return VLC_SUCCESS;
+        }
+        case ES_OUT_SET_PCR:
+        case ES_OUT_SET_GROUP_PCR:
+        case ES_OUT_RESET_PCR:
+        case ES_OUT_SET_ES_FMT:
+        case ES_OUT_SET_NEXT_DISPLAY_TIME:
+        case ES_OUT_SET_META:
+        case ES_OUT_SET_GROUP_META:
+            return VLC_SUCCESS;
+        default:
+            return VLC_EGENERIC;
+    }
+}
+
+/*****************************************************************************
+ * fingerprinter_Extract
+ *****************************************************************************/
+int fingerprinter_Extract( vlc_object_t *p_obj, const char *psz_uri,
+                           acoustid_fingerprint_t *fp )
+{
+    int i_ret = VLC_EGENERIC;
+
+    es_out_sys_t sys;
+    memset( &sys, 0, sizeof(sys) );
+    sys.p_obj = p_obj;
+    es_format_Init( &sys.fmt_selected, UNKNOWN_ES, 0 );
+    sys.i_samples_left = fp->i_duration ? fp->i_duration : DEFAULT_DURATION;
+    sys.p_chromaprint_ctx = chromaprint_new( CHROMAPRINT_ALGORITHM_DEFAULT );
+    if( !sys.p_chromaprint_ctx )
+        return VLC_ENOMEM;
+
+    es_out_t out = {
+        .pf_add = EsOutAdd,
+        .pf_send = EsOutSend,
+        .pf_del = EsOutDel,
+        .pf_control = EsOutControl,
+        .pf_destroy = NULL,
+        .p_sys = &sys,
+    };
+
+    stream_t *p_stream = vlc_stream_NewURL( p_obj, psz_uri );
+    if( !p_stream )
+        goto end;
+
+    const char *psz_location = strstr( psz_uri, "://" );
+    psz_location = psz_location ? psz_location + 3 : psz_uri;
+
+    demux_t *p_demux = demux_New( p_obj, "any", psz_location, p_stream, &out );
+    if( !p_demux )
+    {
+        vlc_stream_Delete( p_stream );
+        goto end;
+    }
+
+    while( !sys.b_done && demux_Demux( p_demux ) == VLC_DEMUXER_SUCCESS );
+
+    /* AcoustID wants the whole track length, not the fingerprinted part.
+     * It is only stored on success: otherwise the caller would take it for
+     * a duration hint on its next attempt. */
+    unsigned i_duration = fp->i_duration;
+    if( !i_duration )
+    {
+        int64_t i_length;
+        if( demux_Control( p_demux, DEMUX_GET_LENGTH, &i_length ) == VLC_SUCCESS )
+            i_duration = i_length / CLOCK_FREQ;
+    }
+
+    demux_Delete( p_demux );
+
+    if( sys.b_started && !sys.b_failed &&
+        chromaprint_finish( sys.p_chromaprint_ctx ) )
+    {
+        char *psz_fingerprint;
+        if( chromaprint_get_fingerprint( sys.p_chromaprint_ctx, &psz_fingerprint ) )
+        {
+            fp->psz_fingerprint = strdup( psz_fingerprint );
+            chromaprint_dealloc( psz_fingerprint );
+            if( fp->psz_fingerprint )
+            {
+                fp->i_duration = i_duration;
+                i_ret = VLC_SUCCESS;
+            }
+        }
+    }
+
+end:
+    if( sys.p_filters )
+        aout_FiltersDelete( p_obj, sys.p_filters );
+    DeleteDecoder( sys.p_decoder );
+    DeleteDecoder( sys.p_packetizer );
+    es_format_Clean( &sys.fmt_selected );
+    chromaprint_free( sys.p_chromaprint_ctx );
+    return i_ret;
+}
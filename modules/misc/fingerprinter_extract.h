@@ -0,0 +1,36 @@
+/*****************************************************************************
+ * fingerprinter_extract.h: Direct (decode only) chromaprint extraction
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef FINGERPRINTER_EXTRACT_H
+# define FINGERPRINTER_EXTRACT_H
+
+struct acoustid_fingerprint_t;
+
+/* Computes the chromaprint fingerprint of psz_uri's first audio track by
+ * driving a demuxer and an audio decoder directly, as fast as the CPU allows
+ * (no input thread, no clock, no stream output chain).
+ *
+ * fp->i_duration is the number of seconds to fingerprint (0 for the default
+ * length). On success, fp->psz_fingerprint is set and, if it was 0,
+ * fp->i_duration is set to the track length. */
+int fingerprinter_Extract( vlc_object_t *p_obj, const char *psz_uri,
+                           struct acoustid_fingerprint_t *fp );
+
+#endif
@@ -22,10 +22,14 @@
 # include "config.h"
 #endif
 
+#include <assert.h>
+
 #include <vlc_common.h>
-#include <vlc_stream.h>
+#include <vlc_tls.h>
+#include <vlc_url.h>
 #include <limits.h>
 #include <vlc_memory.h>
+#include <vlc_memstream.h>
 
 #include <vlc/vlc.h>
 #include "acoustid.h"
@@ -91,7 +95,56 @@ static void parse_recordings( vlc_object_t *p_obj, json_value *node, acoustid_re
     }
 }
 
-static bool ParseJson( vlc_object_t *p_obj, char *psz_buffer, acoustid_results_t *p_results )
+static void parse_results( vlc_object_t *p_obj, json_value *node, acoustid_results_t *p_results )
+{
+    if ( !node || node->type != json_array || node->u.array.length == 0 ) return;
+    p_results->p_results = calloc( node->u.array.length, sizeof(acoustid_result_t) );
+    if ( ! p_results->p_results ) return;
+    p_results->count = node->u.array.length;
+    for( unsigned int i=0; i<node->u.array.length; i++ )
+    {
+        json_value *resultnode = node->u.array.values[i];
+        if ( resultnode && resultnode->type == json_object )
+        {
+            acoustid_result_t *p_result = & p_results->p_results[i];
+            json_value *value = jsongetbyname( resultnode, "score" );
+            if ( value && value->type == json_double )
+                p_result->d_score = value->u.dbl;
+            value = jsongetbyname( resultnode, "id" );
+            if ( value && value->type == json_string )
+                p_result->psz_id = strdup( value->u.string.ptr );
+            parse_recordings( p_obj, jsongetbyname( resultnode, "recordings" ), p_result );
+        }
+    }
+}
+
+/* Index of a batch reply entry; the service sends it as a string */
+static bool parse_index( json_value *node, size_t *pi_index )
+{
+    if ( !node ) return false;
+    if ( node->type == json_integer && node->u.integer >= 0 )
+    {
+        *pi_index = node->u.integer;
+        return true;
+    }
+    if ( node->type == json_string )
+    {
+        char *psz_end;
+        unsigned long i_index = strtoul( node->u.string.ptr, &psz_end, 10 );
+        if ( psz_end == node->u.string.ptr || *psz_end != '\0' )
+            return false;
+        *pi_index = i_index;
+        return true;
+    }
+    return false;
+}
+
+/* Parses either a single lookup reply ("results" array), or a batch reply
+ * ("fingerprints" array of { "index", "results" }) into pp_data.
+ * pb_answered tells which fingerprints were present in the reply. */
+static bool ParseJson( vlc_object_t *p_obj, char *psz_buffer,
+                       acoustid_fingerprint_t **pp_data, bool *pb_answered,
+                       size_t i_count )
 {
     json_settings settings;
     char psz_error[128];
@@ -118,28 +171,40 @@ static bool ParseJson( vlc_object_t *p_obj, char *psz_buffer, acoustid_results_t
         msg_Warn( p_obj, "Bad request status" );
         goto error;
     }
-    node = jsongetbyname( root, "results" );
-    if ( !node || node->type != json_array )
+
+    if ( i_count == 1 )
     {
-        msg_Warn( p_obj, "Bad results array or no results" );
-        goto error;
+        node = jsongetbyname( root, "results" );
+        if ( !node || node->type != json_array )
+        {
+            msg_Warn( p_obj, "Bad results array or no results" );
+            goto error;
+        }
+        parse_results( p_obj, node, & pp_data[0]->results );
+        pb_answered[0] = true;
     }
-    p_results->p_results = calloc( node->u.array.length, sizeof(acoustid_result_t) );
-    if ( ! p_results->p_results ) goto error;
-    p_results->count = node->u.array.length;
-    for( unsigned int i=0; i<node->u.array.length; i++ )
+    else
     {
-        json_value *resultnode = node->u.array.values[i];
-        if ( resultnode && resultnode->type == json_object )
+        node = jsongetbyname( root, "fingerprints" );
+        if ( !node || node->type != json_array )
         {
-            acoustid_result_t *p_result = & p_results->p_results[i];
-            json_value *value = jsongetbyname( resultnode, "score" );
-            if ( value && value->type == json_double )
-                p_result->d_score = value->u.dbl;
-            value = jsongetbyname( resultnode, "id" );
-            if ( value && value->type == json_string )
-                p_result->psz_id = strdup( value->u.string.ptr );
-            parse_recordings( p_obj, jsongetbyname( resultnode, "recordings" ), p_result );
+            msg_Warn( p_obj, "Bad fingerprints array or no results" );
+            goto error;
+        }
+        for( unsigned int i=0; i<node->u.array.length; i++ )
+        {
+            json_value *fpnode = node->u.array.values[i];
+            size_t i_index;
+            if ( !fpnode || fpnode->type != json_object ||
+                 !parse_index( jsongetbyname( fpnode, "index" ), &i_index ) ||
+                 i_index >= i_count || pb_answered[i_index] )
+            {
+                msg_Warn( p_obj, "skipping invalid fingerprint reply %u", i );
+                continue;
+            }
+            parse_results( p_obj, jsongetbyname( fpnode, "results" ),
+                           & pp_data[i_index]->results );
+            pb_answered[i_index] = true;
         }
     }
     json_value_free( root );
@@ -150,34 +215,97 @@ error:
     return false;
 }
 
-int DoAcoustIdWebRequest( vlc_object_t *p_obj, acoustid_fingerprint_t *p_data )
+/* Posts a form to psz_url, and fetches the whole answer.
+ * The stream layer only sends GET requests, which bound the lookup data to
+ * what fits in a URL. */
+static char * Post( vlc_object_t *p_obj, const char *psz_url,
+                    const char *psz_form, size_t i_form )
 {
-    if ( !p_data->psz_fingerprint ) return VLC_SUCCESS;
+    vlc_url_t url;
+    vlc_tls_creds_t *p_creds = NULL;
+    vlc_tls_t *p_tls = NULL;
+    char *p_buffer = NULL;
 
-    char *psz_url;
-    if( unlikely(asprintf( &psz_url, "https://fingerprint.videolan.org/"
-                           "acoustid.php?meta=recordings+tracks+usermeta+"
-                           "releases&duration=%d&fingerprint=%s",
-                           p_data->i_duration, p_data->psz_fingerprint ) < 1 ) )
-         return VLC_EGENERIC;
+    msg_Dbg( p_obj, "Querying AcoustID from %s (%zu bytes)", psz_url, i_form );
+    if ( vlc_UrlParse( &url, psz_url ) || url.psz_protocol == NULL ||
+         url.psz_host == NULL )
+    {
+        msg_Err( p_obj, "invalid AcoustID server URL %s", psz_url );
+        goto out;
+    }
 
-    msg_Dbg( p_obj, "Querying AcoustID from %s", psz_url );
-    int i_saved_flags = p_obj->obj.flags;
-    p_obj->obj.flags |= OBJECT_FLAGS_NOINTERACT;
+    bool b_https = !strcasecmp( url.psz_protocol, "https" );
+    if ( !b_https && strcasecmp( url.psz_protocol, "http" ) )
+    {
+        msg_Err( p_obj, "unsupported AcoustID server scheme %s",
+                 url.psz_protocol );
+        goto out;
+    }
+    unsigned i_port = url.i_port ? url.i_port : ( b_https ? 443 : 80 );
 
-    stream_t *p_stream = vlc_stream_NewURL( p_obj, psz_url );
+    if ( b_https )
+    {
+        p_creds = vlc_tls_ClientCreate( p_obj );
+        if ( p_creds != NULL )
+            p_tls = vlc_tls_SocketOpenTLS( p_creds, url.psz_host, i_port,
+                                           "https", NULL, NULL );
+    }
+    else
+        p_tls = vlc_tls_SocketOpenTCP( p_obj, url.psz_host, i_port );
+    if ( p_tls == NULL )
+    {
+        msg_Err( p_obj, "cannot connect to %s", url.psz_host );
+        goto out;
+    }
 
-    free( psz_url );
-    p_obj->obj.flags = i_saved_flags;
-    if ( p_stream == NULL )
-        return VLC_EGENERIC;
+    /* HTTP/1.0: the answer is neither chunked nor kept alive */
+    struct vlc_memstream req;
+    if ( vlc_memstream_open( &req ) )
+        goto out;
+    vlc_memstream_printf( &req, "POST %s%s%s HTTP/1.0\r\n"
+                          "Host: %s\r\n"
+                          "User-Agent: "PACKAGE_NAME"/"PACKAGE_VERSION"\r\n"
+                          "Content-Type: application/x-www-form-urlencoded\r\n"
+                          "Content-Length: %zu\r\n"
+                          "\r\n",
+                          url.psz_path ? url.psz_path : "/",
+                          url.psz_option ? "?" : "",
+                          url.psz_option ? url.psz_option : "",
+                          url.psz_host, i_form );
+    vlc_memstream_write( &req, psz_form, i_form );
+    if ( vlc_memstream_close( &req ) )
+        goto out;
 
-    stream_t *p_chain = vlc_stream_FilterNew( p_stream, "inflate" );
-    if( p_chain )
-        p_stream = p_chain;
+    ssize_t i_sent = vlc_tls_Write( p_tls, req.ptr, req.length );
+    bool b_sent = i_sent >= 0 && (size_t)i_sent == req.length;
+    free( req.ptr );
+    if ( !b_sent )
+    {
+        msg_Err( p_obj, "cannot send request" );
+        goto out;
+    }
+
+    char *psz_line = vlc_tls_GetLine( p_tls );
+    int i_status;
+    if ( psz_line == NULL ||
+         sscanf( psz_line, "HTTP/%*u.%*u %3d", &i_status ) != 1 ||
+         i_status != 200 )
+    {
+        msg_Warn( p_obj, "bad answer: %s", psz_line ? psz_line : "none" );
+        free( psz_line );
+        goto out;
+    }
+    free( psz_line );
+
+    /* skip headers */
+    while ( ( psz_line = vlc_tls_GetLine( p_tls ) ) != NULL &&
+            psz_line[0] != '\0' )
+        free( psz_line );
+    if ( psz_line == NULL )
+        goto out;
+    free( psz_line );
 
     /* read answer */
-    char *p_buffer = NULL;
     int i_ret = 0;
     for( ;; )
     {
@@ -188,24 +316,109 @@ int DoAcoustIdWebRequest( vlc_object_t *p_obj, acoustid_fingerprint_t *p_data )
 
         p_buffer = realloc_or_free( p_buffer, 1 + i_ret + i_read );
         if( unlikely(p_buffer == NULL) )
-        {
-            vlc_stream_Delete( p_stream );
-            return VLC_ENOMEM;
-        }
+            goto out;
 
-        i_read = vlc_stream_Read( p_stream, &p_buffer[i_ret], i_read );
+        i_read = vlc_tls_Read( p_tls, &p_buffer[i_ret], i_read, false );
         if( i_read <= 0 )
             break;
 
         i_ret += i_read;
     }
-    vlc_stream_Delete( p_stream );
     p_buffer[i_ret] = 0;
 
-    if ( ParseJson( p_obj, p_buffer, & p_data->results ) )
-        msg_Dbg( p_obj, "results count == %d", p_data->results.count );
+out:
+    if ( p_tls != NULL )
+        vlc_tls_Close( p_tls );
+    if ( p_creds != NULL )
+        vlc_tls_Delete( p_creds );
+    vlc_UrlClean( &url );
+    return p_buffer;
+}
+
+/* Looks up i_count fingerprints with a single POST request */
+static int DoAcoustIdWebRequestsOnce( vlc_object_t *p_obj, const char *psz_server,
+                                      acoustid_fingerprint_t **pp_data,
+                                      bool *pb_answered, size_t i_count )
+{
+    struct vlc_memstream form;
+    if ( vlc_memstream_open( &form ) )
+        return VLC_ENOMEM;
+    vlc_memstream_puts( &form, "meta=recordings+tracks+usermeta+releases" );
+
+    if ( i_count == 1 )
+        vlc_memstream_printf( &form, "&duration=%u&fingerprint=%s",
+                              pp_data[0]->i_duration,
+                              pp_data[0]->psz_fingerprint );
     else
+        for ( size_t i = 0; i < i_count; i++ )
+            vlc_memstream_printf( &form, "&duration.%zu=%u&fingerprint.%zu=%s",
+                                  i, pp_data[i]->i_duration,
+                                  i, pp_data[i]->psz_fingerprint );
+
+    if ( vlc_memstream_close( &form ) )
+        return VLC_ENOMEM;
+
+    char *p_buffer = Post( p_obj, psz_server, form.ptr, form.length );
+    free( form.ptr );
+    if ( p_buffer == NULL )
+        return VLC_EGENERIC;
+
+    bool b_parsed = ParseJson( p_obj, p_buffer, pp_data, pb_answered, i_count );
+    free( p_buffer );
+
+    if ( !b_parsed )
+    {
         msg_Dbg( p_obj, "No results" );
+        return VLC_EGENERIC;
+    }
 
+    for ( size_t i = 0; i < i_count; i++ )
+        msg_Dbg( p_obj, "fingerprint %zu: results count == %d", i,
+                 pp_data[i]->results.count );
     return VLC_SUCCESS;
 }
+
+int DoAcoustIdWebRequests( vlc_object_t *p_obj, acoustid_fingerprint_t **pp_data,
+                           bool *pb_answered, size_t i_count )
+{
+    for ( size_t i = 0; i < i_count; i++ )
+    {
+        assert( pp_data[i]->psz_fingerprint );
+        pb_answered[i] = false;
+    }
+    if ( i_count == 0 ) return VLC_SUCCESS;
+
+    char *psz_server = var_InheritString( p_obj, "acoustid-server" );
+    const char *psz_base = psz_server ? psz_server : ACOUSTID_DEFAULT_SERVER;
+    int i_ret = VLC_EGENERIC;
+
+    /* Fingerprints are several KiB each: split the batch so that each
+     * request body stays reasonably small, and so that a failed request
+     * does not lose too many lookups. */
+    for ( size_t i_first = 0, i_next; i_first < i_count; i_first = i_next )
+    {
+        size_t i_length = 64;
+
+        i_next = i_first;
+        do
+            i_length += strlen( pp_data[i_next++]->psz_fingerprint ) + 48;
+        while ( i_next < i_count && i_next - i_first < ACOUSTID_MAX_BATCH &&
+                i_length + strlen( pp_data[i_next]->psz_fingerprint ) + 48
+                    <= ACOUSTID_MAX_BODY );
+
+        if ( DoAcoustIdWebRequestsOnce( p_obj, psz_base, &pp_data[i_first],
+                                        &pb_answered[i_first],
+                                        i_next - i_first ) == VLC_SUCCESS )
+            i_ret = VLC_SUCCESS;
+    }
+    free( psz_server );
+    return i_ret;
+}
+
+int DoAcoustIdWebRequest( vlc_object_t *p_obj, acoustid_fingerprint_t *p_data )
+{
+    if ( !p_data->psz_fingerprint ) return VLC_SUCCESS;
+
+    bool b_answered;
+    return DoAcoustIdWebRequests( p_obj, &p_data, &b_answered, 1 );
+}
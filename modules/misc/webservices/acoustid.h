@@ -19,6 +19,12 @@
  *****************************************************************************/
 
 #define MB_ID_SIZE 36
+#define ACOUSTID_DEFAULT_SERVER "https://fingerprint.videolan.org/acoustid.php"
+
+/* Upper bound of fingerprints per lookup */
+#define ACOUSTID_MAX_BATCH 32
+/* Lookups are split into requests with bodies no larger than this */
+#define ACOUSTID_MAX_BODY (512 * 1024)
 
 struct musicbrainz_recording_t
 {
@@ -56,4 +62,9 @@ struct acoustid_fingerprint_t
 typedef struct acoustid_fingerprint_t acoustid_fingerprint_t;
 
 int DoAcoustIdWebRequest( vlc_object_t *p_obj, acoustid_fingerprint_t *p_data );
+/* Looks up i_count fingerprints with as few requests as the body size
+ * allows. Succeeds if any request did, and pb_answered[i] tells whether a
+ * reply had an entry for pp_data[i]. */
+int DoAcoustIdWebRequests( vlc_object_t *p_obj, acoustid_fingerprint_t **pp_data,
+                           bool *pb_answered, size_t i_count );
 void free_acoustid_result_t( acoustid_result_t * r );
@@ -35,6 +35,24 @@
 #include <vlc_fs.h>
 #include <vlc_interrupt.h>
 
+/**
+ * A buffered range of the source stream.
+ *
+ * Each range is a circular buffer of stream_sys_t.buffer_size bytes, indexed
+ * by stream offset modulo that size. Only the first range is allocated up
+ * front: the others are allocated once the stream is read out of order, so
+ * that sequential reading gets the whole buffer size for the same memory.
+ */
+struct prefetch_range
+{
+    uint64_t     offset; /**< stream offset of the oldest buffered byte */
+    uint64_t     read_offset; /**< where the reader left the range */
+    size_t       length; /**< buffered bytes */
+    uint64_t     last_use; /**< reader switch count at last use (LRU) */
+    bool         eof;
+    char        *buffer; /**< NULL until the range is first used */
+};
+
 struct stream_sys_t
 {
     vlc_mutex_t  lock;
@@ -43,7 +61,6 @@ struct stream_sys_t
     vlc_thread_t thread;
     vlc_interrupt_t *interrupt;
 
-    bool         eof;
     bool         error;
     bool         paused;
 
@@ -54,13 +71,20 @@ struct stream_sys_t
     int64_t      pts_delay;
     char        *content_type;
 
-    uint64_t     buffer_offset;
     uint64_t     stream_offset;
-    size_t       buffer_length;
-    size_t       buffer_size;
-    char        *buffer;
+    uint64_t     upstream_offset;
+    struct prefetch_range *ranges;
+    struct prefetch_range *current; /**< range last read from */
+    unsigned     range_count;
+    size_t       buffer_size; /**< per range */
     size_t       read_size;
     size_t       seek_threshold;
+
+    uint64_t     switches; /**< reader switches between ranges */
+    /* Also published as the prefetch-hits, -misses and -seeks variables */
+    uint64_t     hits;
+    uint64_t     misses;
+    uint64_t     seeks;
 };
 
 static ssize_t ThreadRead(stream_t *stream, void *buf, size_t length)
@@ -92,7 +116,12 @@ static int ThreadSeek(stream_t *stream, uint64_t seek_offset)
     vlc_mutex_lock(&sys->lock);
     vlc_restorecancel(canc);
 
-    return (val == VLC_SUCCESS) ? 0 : -1;
+    if (val != VLC_SUCCESS)
+        return -1;
+    sys->upstream_offset = seek_offset;
+    sys->seeks++;
+    var_SetInteger(stream, "prefetch-seeks", sys->seeks);
+    return 0;
 }
 
 static int ThreadControl(stream_t *stream, int query, ...)
@@ -117,6 +146,116 @@ static int ThreadControl(stream_t *stream, int query, ...)
 #define MAX_READ 65536
 #define SEEK_THRESHOLD MAX_READ
 
+static uint64_t RangeEnd(const struct prefetch_range *r)
+{
+    return r->offset + r->length;
+}
+
+/**
+ * Finds the range that holds, or would be extended to, a given offset.
+ *
+ * A range matches if the offset is within it, or no more than ahead bytes
+ * past its end. Ranges holding data at the offset are preferred.
+ */
+static struct prefetch_range *FindRange(stream_sys_t *sys, uint64_t offset,
+                                        uint64_t ahead)
+{
+    struct prefetch_range *found = NULL;
+
+    for (unsigned i = 0; i < sys->range_count; i++)
+    {
+        struct prefetch_range *r = &sys->ranges[i];
+        uint64_t end = RangeEnd(r);
+
+        if (r->last_use == 0 || offset < r->offset)
+            continue;
+        if (offset < end)
+            return r;
+        if (offset == end || offset - end < ahead)
+            found = r;
+    }
+    return found;
+}
+
+/**
+ * Picks a range to top up while the reader is busy with buffered data.
+ *
+ * Only ranges the reader went back to recently are kept filled: with badly
+ * interleaved streams, those are the ranges it alternates between. To avoid
+ * seeking upstream for every read, the range that upstream is positioned at
+ * is filled up completely, while the others are only refilled once they are
+ * half empty.
+ */
+static struct prefetch_range *RefillRange(stream_sys_t *sys)
+{
+    struct prefetch_range *best = NULL;
+    uint64_t best_unread = UINT64_MAX;
+
+    for (unsigned i = 0; i < sys->range_count; i++)
+    {
+        struct prefetch_range *r = &sys->ranges[i];
+        uint64_t end = RangeEnd(r);
+
+        if (r->last_use == 0 || r->eof
+         || sys->switches - r->last_use >= sys->range_count
+         || r->read_offset > end)
+            continue;
+
+        uint64_t unread = end - r->read_offset;
+        if (unread >= sys->buffer_size)
+            continue; /* full */
+
+        /* Do not duplicate data already buffered in another range */
+        if (FindRange(sys, end, 0) != r)
+            continue;
+
+        if (end == sys->upstream_offset)
+            return r;
+        if (unread < sys->buffer_size / 2 && unread < best_unread)
+        {
+            best = r;
+            best_unread = unread;
+        }
+    }
+    return best;
+}
+
+/**
+ * Picks the range to start buffering a new offset in: the least recently
+ * used one, or the least recently used allocated one if memory is short.
+ */
+static struct prefetch_range *OldestRange(stream_sys_t *sys)
+{
+    struct prefetch_range *oldest = &sys->ranges[0];
+
+    for (unsigned i = 1; i < sys->range_count; i++)
+        if (sys->ranges[i].last_use < oldest->last_use)
+            oldest = &sys->ranges[i];
+
+    if (oldest->buffer == NULL)
+    {
+        oldest->buffer = malloc(sys->buffer_size);
+        if (unlikely(oldest->buffer == NULL))
+        {
+            oldest = &sys->ranges[0];
+            for (unsigned i = 1; i < sys->range_count; i++)
+                if (sys->ranges[i].buffer != NULL
+                 && sys->ranges[i].last_use < oldest->last_use)
+                    oldest = &sys->ranges[i];
+        }
+    }
+    return oldest;
+}
+
+static void FreeRanges(stream_sys_t *sys)
+{
+    if (sys->ranges == NULL)
+        return;
+    for (unsigned i = 0; i < sys->range_count; i++)
+        free(sys->ranges[i].buffer);
+    free(sys->ranges);
+}
+
 static void *Thread(void *data)
 {
     stream_t *stream = data;
@@ -144,51 +283,28 @@ static void *Thread(void *data)
         }
 
         uint_fast64_t stream_offset = sys->stream_offset;
-
-        if (stream_offset < sys->buffer_offset)
-        {   /* Need to seek backward */
-            if (ThreadSeek(stream, stream_offset) == 0)
-            {
-                sys->buffer_offset = stream_offset;
-                sys->buffer_length = 0;
-                assert(!sys->error);
-                sys->eof = false;
-            }
-            else
-            {
-                sys->error = true;
-                vlc_cond_signal(&sys->wait_data);
-            }
-            continue;
-        }
-
-        if (sys->eof)
-        {   /* Do not attempt to read at EOF - would busy loop */
-            vlc_cond_wait(&sys->wait_space, &sys->lock);
-            continue;
-        }
-
-        assert(stream_offset >= sys->buffer_offset);
-
-        /* As long as there is space, the buffer will retain already read
-         * ("historical") data. The data can be used if/when seeking backward.
-         * Unread data is however given precedence if the buffer is full. */
-        uint64_t history = stream_offset - sys->buffer_offset;
+        uint64_t ahead = sys->can_seek ? sys->seek_threshold : UINT64_MAX;
+        struct prefetch_range *r = FindRange(sys, stream_offset, ahead);
 
         /* If upstream supports seeking and if the downstream offset is far
-         * beyond the upstream offset, then attempt to skip forward.
+         * from any buffered range, then start a new range there, in place of
+         * the least recently used one.
          * If it fails, assume upstream is well-behaved such that the failed
-         * seek is a no-op, and continue as if seeking was not supported.
+         * seek is a no-op, and keep the buffered data.
          * WARNING: Except problems with misbehaving access plug-ins. */
-        if (sys->can_seek
-         && history >= (sys->buffer_length + sys->seek_threshold))
+        if (r == NULL)
         {
             if (ThreadSeek(stream, stream_offset) == 0)
             {
-                sys->buffer_offset = stream_offset;
-                sys->buffer_length = 0;
+                r = OldestRange(sys);
+                r->offset = stream_offset;
+                r->read_offset = stream_offset;
+                r->length = 0;
+                r->last_use = ++sys->switches;
+                r->eof = false;
+                /* The reader resumes from this range: no further switch */
+                sys->current = r;
                 assert(!sys->error);
-                assert(!sys->eof);
             }
             else
             {   /* Seek failure is not necessarily fatal here. We could read
@@ -202,25 +318,57 @@ static void *Thread(void *data)
             continue;
         }
 
-        assert(sys->buffer_size >= sys->buffer_length);
-
-        size_t len = sys->buffer_size - sys->buffer_length;
-        if (len == 0)
-        {   /* Buffer is full */
-            if (history == 0)
+        if (stream_offset >= RangeEnd(r))
+        {   /* The reader is waiting for this range */
+            if (r->eof)
+            {   /* Do not attempt to read at EOF - would busy loop */
+                vlc_cond_wait(&sys->wait_space, &sys->lock);
+                continue;
+            }
+            r->read_offset = stream_offset;
+        }
+        else
+        {   /* The reader has data: fill another range in the mean time */
+            r = RefillRange(sys);
+            if (r == NULL)
             {   /* Wait for data to be read */
                 vlc_cond_wait(&sys->wait_space, &sys->lock);
                 continue;
             }
+        }
+
+        if (RangeEnd(r) != sys->upstream_offset)
+        {   /* Resume filling the range where it was left */
+            if (ThreadSeek(stream, RangeEnd(r)))
+            {
+                sys->error = true;
+                vlc_cond_signal(&sys->wait_data);
+            }
+            continue;
+        }
+
+        assert(r->read_offset >= r->offset);
+
+        /* As long as there is space, the buffer will retain already read
+         * ("historical") data. The data can be used if/when seeking backward.
+         * Unread data is however given precedence if the buffer is full. */
+        uint64_t history = r->read_offset - r->offset;
+
+        assert(sys->buffer_size >= r->length);
+
+        size_t len = sys->buffer_size - r->length;
+        if (len == 0)
+        {   /* Buffer is full */
+            assert(history > 0);
 
             /* Discard some historical data to make room. */
             len = history;
             if (len > sys->read_size)
                 len = sys->read_size;
 
-            assert(len <= sys->buffer_length);
-            sys->buffer_offset += len;
-            sys->buffer_length -= len;
+            assert(len <= r->length);
+            r->offset += len;
+            r->length -= len;
         }
         else
         {   /* Some streams cannot return a short data count and just wait for
@@ -231,27 +379,26 @@ static void *Thread(void *data)
                 len = sys->read_size;
         }
 
-        size_t offset = (sys->buffer_offset + sys->buffer_length)
-                        % sys->buffer_size;
+        size_t offset = RangeEnd(r) % sys->buffer_size;
          /* Do not step past the sharp edge of the circular buffer */
         if (offset + len > sys->buffer_size)
             len = sys->buffer_size - offset;
 
-        ssize_t val = ThreadRead(stream, sys->buffer + offset, len);
+        ssize_t val = ThreadRead(stream, r->buffer + offset, len);
         if (val < 0)
             continue;
         if (val == 0)
         {
             assert(len > 0);
             msg_Dbg(stream, "end of stream");
-            sys->eof = true;
+            r->eof = true;
         }
 
         assert((size_t)val <= len);
-        sys->buffer_length += val;
-        assert(sys->buffer_length <= sys->buffer_size);
-        //msg_Dbg(stream, "buffer: %zu/%zu", sys->buffer_length,
-        //        sys->buffer_size);
+        sys->upstream_offset += val;
+        r->length += val;
+        assert(r->length <= sys->buffer_size);
+        //msg_Dbg(stream, "buffer: %zu/%zu", r->length, sys->buffer_size);
         vlc_cond_signal(&sys->wait_data);
     }
     vlc_assert_unreachable();
@@ -271,20 +418,27 @@ static int Seek(stream_t *stream, uint64_t offset)
     return 0;
 }
 
-static size_t BufferLevel(const stream_t *stream, bool *eof)
+static size_t BufferLevel(stream_t *stream, bool *eof)
 {
     stream_sys_t *sys = stream->p_sys;
+    struct prefetch_range *r = FindRange(sys, sys->stream_offset, 0);
 
     *eof = false;
 
-    if (sys->stream_offset < sys->buffer_offset)
+    if (r == NULL)
         return 0;
-    if ((sys->stream_offset - sys->buffer_offset) >= sys->buffer_length)
+    if (sys->stream_offset >= RangeEnd(r))
     {
-        *eof = sys->eof;
+        *eof = r->eof;
         return 0;
     }
-    return sys->buffer_offset + sys->buffer_length - sys->stream_offset;
+
+    if (r != sys->current)
+    {   /* Switching ranges: the stream is being read out of order */
+        sys->current = r;
+        r->last_use = ++sys->switches;
+    }
+    return RangeEnd(r) - sys->stream_offset;
 }
 
 static ssize_t Read(stream_t *stream, void *buf, size_t buflen)
@@ -304,7 +458,19 @@ static ssize_t Read(stream_t *stream, void *buf, size_t buflen)
         vlc_cond_signal(&sys->wait_space);
     }
 
-    while ((copy = BufferLevel(stream, &eof)) == 0 && !eof)
+    if ((copy = BufferLevel(stream, &eof)) > 0 || eof)
+    {
+        /* Hits are frequent: publish them only every so often */
+        if ((++sys->hits % 64) == 0)
+            var_SetInteger(stream, "prefetch-hits", sys->hits);
+    }
+    else
+    {
+        var_SetInteger(stream, "prefetch-hits", sys->hits);
+        var_SetInteger(stream, "prefetch-misses", ++sys->misses);
+    }
+
+    while (copy == 0 && !eof)
     {
         void *data[2];
 
@@ -317,8 +483,17 @@ static ssize_t Read(stream_t *stream, void *buf, size_t buflen)
         vlc_interrupt_forward_start(sys->interrupt, data);
         vlc_cond_wait(&sys->wait_data, &sys->lock);
         vlc_interrupt_forward_stop(data);
+        copy = BufferLevel(stream, &eof);
+    }
+
+    if (eof)
+    {
+        vlc_mutex_unlock(&sys->lock);
+        return 0;
     }
 
+    struct prefetch_range *r = sys->current;
+
     offset = sys->stream_offset % sys->buffer_size;
     if (copy > buflen)
         copy = buflen;
@@ -326,8 +501,9 @@ static ssize_t Read(stream_t *stream, void *buf, size_t buflen)
     if (offset + copy > sys->buffer_size)
         copy = sys->buffer_size - offset;
 
-    memcpy(buf, sys->buffer + offset, copy);
+    memcpy(buf, r->buffer + offset, copy);
     sys->stream_offset += copy;
+    r->read_offset = sys->stream_offset;
     vlc_cond_signal(&sys->wait_space);
     vlc_mutex_unlock(&sys->lock);
     return copy;
@@ -443,15 +619,20 @@ static int Open(vlc_object_t *obj)
                            &sys->content_type))
         sys->content_type = NULL;
 
-    sys->eof = false;
     sys->error = false;
     sys->paused = false;
-    sys->buffer_offset = 0;
     sys->stream_offset = 0;
-    sys->buffer_length = 0;
+    sys->upstream_offset = 0;
+    /* Without seeking, only one range can be filled */
+    sys->range_count = sys->can_seek
+                     ? var_InheritInteger(obj, "prefetch-ranges") : 1;
     sys->buffer_size = var_InheritInteger(obj, "prefetch-buffer-size") << 10u;
     sys->read_size = var_InheritInteger(obj, "prefetch-read-size");
     sys->seek_threshold = var_InheritInteger(obj, "prefetch-seek-threshold");
+    sys->switches = 1;
+    sys->hits = 0;
+    sys->misses = 0;
+    sys->seeks = 0;
 
     uint64_t size = stream_Size(stream->p_source);
     if (size > 0)
@@ -464,14 +645,37 @@ static int Open(vlc_object_t *obj)
     if (sys->buffer_size < sys->read_size)
         sys->buffer_size = sys->read_size;
 
-    sys->buffer = malloc(sys->buffer_size);
-    if (sys->buffer == NULL)
+    sys->ranges = malloc(sys->range_count * sizeof (*sys->ranges));
+    if (sys->ranges == NULL)
+        goto error;
+
+    for (unsigned i = 0; i < sys->range_count; i++)
+    {
+        struct prefetch_range *r = &sys->ranges[i];
+
+        r->offset = 0;
+        r->read_offset = 0;
+        r->length = 0;
+        r->last_use = 0; /* unused */
+        r->eof = false;
+        r->buffer = NULL;
+    }
+    /* Start with the first range at the beginning of the stream */
+    sys->current = &sys->ranges[0];
+    sys->current->last_use = sys->switches;
+    sys->current->buffer = malloc(sys->buffer_size);
+    if (sys->current->buffer == NULL)
         goto error;
 
     sys->interrupt = vlc_interrupt_create();
     if (unlikely(sys->interrupt == NULL))
         goto error;
 
+    /* Statistics, for the interfaces to tell how well the buffer works */
+    var_Create(stream, "prefetch-hits", VLC_VAR_INTEGER);
+    var_Create(stream, "prefetch-misses", VLC_VAR_INTEGER);
+    var_Create(stream, "prefetch-seeks", VLC_VAR_INTEGER);
+
     vlc_mutex_init(&sys->lock);
     vlc_cond_init(&sys->wait_data);
     vlc_cond_init(&sys->wait_space);
@@ -484,18 +688,21 @@ static int Open(vlc_object_t *obj)
         vlc_cond_destroy(&sys->wait_data);
         vlc_mutex_destroy(&sys->lock);
         vlc_interrupt_destroy(sys->interrupt);
+        var_Destroy(stream, "prefetch-seeks");
+        var_Destroy(stream, "prefetch-misses");
+        var_Destroy(stream, "prefetch-hits");
         goto error;
     }
 
-    msg_Dbg(stream, "using %zu bytes buffer, %zu bytes read",
-            sys->buffer_size, sys->read_size);
+    msg_Dbg(stream, "using %u ranges of %zu bytes buffer, %zu bytes read",
+            sys->range_count, sys->buffer_size, sys->read_size);
     stream->pf_read = Read;
     stream->pf_readdir = ReadDir;
     stream->pf_control = Control;
     return VLC_SUCCESS;
 
 error:
-    free(sys->buffer);
+    FreeRanges(sys);
     free(sys->content_type);
     free(sys);
     return VLC_ENOMEM;
@@ -518,7 +725,13 @@ static void Close (vlc_object_t *obj)
     vlc_cond_destroy(&sys->wait_data);
     vlc_mutex_destroy(&sys->lock);
 
-    free(sys->buffer);
+    msg_Dbg(stream, "%"PRIu64" reads from buffer, %"PRIu64" waiting, "
+            "%"PRIu64" upstream seeks", sys->hits, sys->misses, sys->seeks);
+    var_Destroy(stream, "prefetch-seeks");
+    var_Destroy(stream, "prefetch-misses");
+    var_Destroy(stream, "prefetch-hits");
+
+    FreeRanges(sys);
     free(sys->content_type);
     free(sys);
 }
@@ -534,6 +747,11 @@ vlc_module_begin()
     add_integer("prefetch-buffer-size", 1 << 14, N_("Buffer size"),
                 N_("Prefetch buffer size (KiB)"), false)
         change_integer_range(4, 1 << 20)
+    add_integer("prefetch-ranges", 4, N_("Ranges"),
+                N_("Number of separate stream ranges to keep in the prefetch "
+                   "buffer, e.g. for badly interleaved files. Each range "
+                   "uses up to the prefetch buffer size."), true)
+        change_integer_range(1, 16)
     add_integer("prefetch-read-size", 1 << 14, N_("Read size"),
                 N_("Prefetch background read size (bytes)"), true)
         change_integer_range(1, 1 << 29)
@@ -255,11 +255,21 @@ void input_ExtractAttachmentAndCacheArt( input_thread_t *p_input,
 
 int input_item_WriteMeta( vlc_object_t *obj, input_item_t *p_item )
 {
+    return input_item_WriteMetaExt( obj, p_item, NULL );
+}
+
+int input_item_WriteMetaExt( vlc_object_t *obj, input_item_t *p_item,
+                             uint64_t *written )
+{
+    if( written != NULL )
+        *written = UINT64_MAX;
+
     meta_export_t *p_export =
         vlc_custom_create( obj, sizeof( *p_export ), "meta writer" );
     if( p_export == NULL )
         return VLC_ENOMEM;
     p_export->p_item = p_item;
+    p_export->i_written = UINT64_MAX;
 
     int type;
     vlc_mutex_lock( &p_item->lock );
@@ -277,8 +287,11 @@ int input_item_WriteMeta( vlc_object_t *obj, input_item_t *p_item )
         goto error;
 
     module_t *p_mod = module_need( p_export, "meta writer", NULL, false );
-    if( p_mod )
-        module_unneed( p_export, p_mod );
+    if( p_mod == NULL )
+        goto error;
+    module_unneed( p_export, p_mod );
+    if( written != NULL )
+        *written = p_export->i_written;
     vlc_object_release( p_export );
     return VLC_SUCCESS;
 
@@ -34,6 +34,7 @@
 #include <vlc_common.h>
 #include <vlc_block.h>
 #include <vlc_fs.h>
+#include <vlc_atomic.h>
 
 #ifndef NDEBUG
 static void BlockNoRelease( block_t *b )
@@ -117,8 +118,291 @@ static void BlockMetaCopy( block_t *restrict out, const block_t *in )
 /** Initial reserved header and footer size. */
 #define BLOCK_PADDING      32
 
+static void block_SetPayload (block_t *b, size_t size)
+{
+    static_assert ((BLOCK_PADDING % BLOCK_ALIGN) == 0,
+                   "BLOCK_PADDING must be a multiple of BLOCK_ALIGN");
+    b->p_buffer += BLOCK_PADDING + BLOCK_ALIGN - 1;
+    b->p_buffer = (void *)(((uintptr_t)b->p_buffer) & ~(BLOCK_ALIGN - 1));
+    b->i_buffer = size;
+}
+
+/*
+ * Block pool
+ *
+ * Blocks up to BLOCK_POOL_MAX_SIZE bytes are recycled by power of two size
+ * classes rather than going through malloc() and free() every time.
+ * A released block goes to the free list of the releasing thread. Threads
+ * exchange blocks with a shared depot only by batches, so that the depot
+ * lock is taken once per batch, not once per block.
+ *
+ * The depot is bounded overall, and batches left unused in it for a while
+ * are freed. A thread keeps at most two batches per size class, which go
+ * to the depot, within its bound, when the thread exits.
+ * Blocks are not returned to the malloc() arena of the thread that
+ * allocated them: free() does that whenever a block is eventually freed.
+ */
+#define BLOCK_POOL_MIN_SHIFT   8 /* 256 bytes */
+#define BLOCK_POOL_CLASSES     9
+#define BLOCK_POOL_MAX_SIZE    ((size_t)1 << (BLOCK_POOL_MIN_SHIFT + BLOCK_POOL_CLASSES - 1))
+/** Bytes moved at once between a thread and the depot. */
+#define BLOCK_POOL_BATCH_BYTES (128 * 1024)
+#define BLOCK_POOL_BATCH_MAX   32
+/** Bytes kept in the depot overall, the rest is freed. */
+#define BLOCK_POOL_DEPOT_BYTES (1024 * 1024)
+/** Depot batches unused for that long are freed. */
+#define BLOCK_POOL_IDLE_DELAY  (5 * CLOCK_FREQ)
+
+typedef struct block_pooled_t
+{
+    block_t self; /* p_next links free blocks */
+    struct block_pooled_t *batch; /**< next batch, for the first block of
+                                       a batch in the depot */
+    mtime_t date; /**< when the batch went to the depot, for its first block */
+    unsigned count; /**< blocks in the batch, for its first block */
+    unsigned size_class;
+} block_pooled_t;
+
+typedef struct
+{
+    block_pooled_t *head[BLOCK_POOL_CLASSES];
+    unsigned count[BLOCK_POOL_CLASSES];
+} block_cache_t;
+
+static struct
+{
+    vlc_mutex_t lock;
+    block_pooled_t *batches[BLOCK_POOL_CLASSES]; /**< most recent first */
+    size_t bytes;
+} block_depot = { .lock = VLC_STATIC_MUTEX };
+
+static vlc_threadvar_t block_cache_key;
+
+static size_t block_pool_ClassSize (unsigned c)
+{
+    return (size_t)1 << (BLOCK_POOL_MIN_SHIFT + c);
+}
+
+static unsigned block_pool_BatchCount (unsigned c)
+{
+    size_t n = BLOCK_POOL_BATCH_BYTES / block_pool_ClassSize (c);
+    return (n > BLOCK_POOL_BATCH_MAX) ? BLOCK_POOL_BATCH_MAX
+                                      : (n < 2) ? 2 : n;
+}
+
+static void block_pool_FreeChain (block_pooled_t *b)
+{
+    while (b != NULL)
+    {
+        block_pooled_t *next = (block_pooled_t *)b->self.p_next;
+        free (b);
+        b = next;
+    }
+}
+
+/* Unlinks the depot batches unused since the deadline, and returns them.
+ * The depot lock must be held. */
+static block_pooled_t *block_depot_Trim (mtime_t deadline)
+{
+    block_pooled_t *idle = NULL;
+
+    for (unsigned c = 0; c < BLOCK_POOL_CLASSES; c++)
+    {
+        block_pooled_t **pp = &block_depot.batches[c];
+
+        while (*pp != NULL && (*pp)->date >= deadline)
+            pp = &(*pp)->batch;
+
+        /* The older batches are all further down the list */
+        for (block_pooled_t *b = *pp, *next; b != NULL; b = next)
+        {
+            next = b->batch;
+            block_depot.bytes -= b->count * block_pool_ClassSize (c);
+            b->batch = idle;
+            idle = b;
+        }
+        *pp = NULL;
+    }
+    return idle;
+}
+
+static void block_depot_FreeBatches (block_pooled_t *batch)
+{
+    while (batch != NULL)
+    {
+        block_pooled_t *next = batch->batch;
+        block_pool_FreeChain (batch);
+        batch = next;
+    }
+}
+
+static void block_depot_Put (unsigned c, block_pooled_t *batch, unsigned count)
+{
+    const size_t bytes = count * block_pool_ClassSize (c);
+    const mtime_t now = mdate ();
+
+    batch->count = count;
+    batch->date = now;
+
+    vlc_mutex_lock (&block_depot.lock);
+    block_pooled_t *idle = block_depot_Trim (now - BLOCK_POOL_IDLE_DELAY);
+    if (block_depot.bytes + bytes <= BLOCK_POOL_DEPOT_BYTES)
+    {
+        batch->batch = block_depot.batches[c];
+        block_depot.batches[c] = batch;
+        block_depot.bytes += bytes;
+        batch = NULL;
+    }
+    vlc_mutex_unlock (&block_depot.lock);
+
+    block_pool_FreeChain (batch);
+    block_depot_FreeBatches (idle);
+}
+
+static block_pooled_t *block_depot_Get (unsigned c, unsigned *count)
+{
+    vlc_mutex_lock (&block_depot.lock);
+    block_pooled_t *batch = block_depot.batches[c];
+    if (batch != NULL)
+    {
+        block_depot.batches[c] = batch->batch;
+        block_depot.bytes -= batch->count * block_pool_ClassSize (c);
+        *count = batch->count;
+    }
+    vlc_mutex_unlock (&block_depot.lock);
+    return batch;
+}
+
+/* Hands the free blocks of an exiting thread over to the depot, which frees
+ * what exceeds its bound */
+static void block_cache_Destroy (void *data)
+{
+    block_cache_t *cache = data;
+
+    for (unsigned c = 0; c < BLOCK_POOL_CLASSES; c++)
+        if (cache->head[c] != NULL)
+            block_depot_Put (c, cache->head[c], cache->count[c]);
+    free (cache);
+}
+
+static block_cache_t *block_cache_Get (void)
+{
+    static atomic_uint state = ATOMIC_VAR_INIT(0); /* 1: ready, 2: failed */
+    static vlc_mutex_t lock = VLC_STATIC_MUTEX;
+
+    unsigned ready = atomic_load_explicit (&state, memory_order_acquire);
+    if (unlikely(ready == 0))
+    {
+        vlc_mutex_lock (&lock);
+        ready = atomic_load_explicit (&state, memory_order_relaxed);
+        if (ready == 0)
+        {
+            ready = vlc_threadvar_create (&block_cache_key,
+                                          block_cache_Destroy) ? 2 : 1;
+            atomic_store_explicit (&state, ready, memory_order_release);
+        }
+        vlc_mutex_unlock (&lock);
+    }
+    if (unlikely(ready != 1))
+        return NULL;
+
+    block_cache_t *cache = vlc_threadvar_get (block_cache_key);
+    if (unlikely(cache == NULL))
+    {
+        cache = calloc (1, sizeof (*cache));
+        if (cache != NULL && vlc_threadvar_set (block_cache_key, cache))
+        {
+            free (cache);
+            cache = NULL;
+        }
+    }
+    return cache;
+}
+
+static void block_pool_Release (block_t *block)
+{
+    block_pooled_t *b = (block_pooled_t *)block;
+    const unsigned c = b->size_class;
+
+    assert (block->p_start == (unsigned char *)(b + 1));
+    block_Invalidate (block);
+
+    block_cache_t *cache = block_cache_Get ();
+    if (unlikely(cache == NULL))
+    {
+        free (b);
+        return;
+    }
+
+    b->self.p_next = (block_t *)cache->head[c];
+    cache->head[c] = b;
+
+    const unsigned batch = block_pool_BatchCount (c);
+    if (++cache->count[c] < 2 * batch)
+        return;
+
+    /* Keep the most recently used blocks, give the others back */
+    block_pooled_t *last = cache->head[c];
+    for (unsigned i = 1; i < batch; i++)
+        last = (block_pooled_t *)last->self.p_next;
+
+    block_pooled_t *rest = (block_pooled_t *)last->self.p_next;
+    last->self.p_next = NULL;
+    block_depot_Put (c, rest, cache->count[c] - batch);
+    cache->count[c] = batch;
+}
+
+static block_t *block_pool_Alloc (size_t size)
+{
+    unsigned c = 0;
+    while (block_pool_ClassSize (c) < size)
+        c++;
+
+    block_cache_t *cache = block_cache_Get ();
+    block_pooled_t *b = NULL;
+
+    if (likely(cache != NULL))
+    {
+        if (cache->head[c] == NULL)
+        {
+            unsigned count;
+            block_pooled_t *batch = block_depot_Get (c, &count);
+            if (batch != NULL)
+            {
+                cache->head[c] = batch;
+                cache->count[c] = count;
+            }
+        }
+
+        b = cache->head[c];
+        if (b != NULL)
+        {
+            cache->head[c] = (block_pooled_t *)b->self.p_next;
+            cache->count[c]--;
+        }
+    }
+
+    const size_t alloc = BLOCK_ALIGN + (2 * BLOCK_PADDING)
+                       + block_pool_ClassSize (c);
+    if (b == NULL)
+    {
+        b = malloc (sizeof (*b) + alloc);
+        if (unlikely(b == NULL))
+            return NULL;
+        b->size_class = c;
+    }
+
+    block_Init (&b->self, b + 1, alloc);
+    block_SetPayload (&b->self, size);
+    b->self.pf_release = block_pool_Release;
+    return &b->self;
+}
+
 block_t *block_Alloc (size_t size)
 {
+    if (size <= BLOCK_POOL_MAX_SIZE)
+        return block_pool_Alloc (size);
+
     /* 2 * BLOCK_PADDING: pre + post padding */
     const size_t alloc = sizeof (block_t) + BLOCK_ALIGN + (2 * BLOCK_PADDING)
                        + size;
@@ -130,11 +414,7 @@ block_t *block_Alloc (size_t size)
         return NULL;
 
     block_Init (b, b + 1, alloc - sizeof (*b));
-    static_assert ((BLOCK_PADDING % BLOCK_ALIGN) == 0,
-                   "BLOCK_PADDING must be a multiple of BLOCK_ALIGN");
-    b->p_buffer += BLOCK_PADDING + BLOCK_ALIGN - 1;
-    b->p_buffer = (void *)(((uintptr_t)b->p_buffer) & ~(BLOCK_ALIGN - 1));
-    b->i_buffer = size;
+    block_SetPayload (b, size);
     b->pf_release = block_generic_Release;
     return b;
 }
@@ -30,6 +30,7 @@
 
 #include <vlc_common.h>
 #include <vlc_block.h>
+#include <vlc_atomic.h>
 #include "libvlc.h"
 
 /**
@@ -233,3 +234,173 @@ size_t block_FifoCount (block_fifo_t *fifo)
     vlc_mutex_unlock (&fifo->lock);
     return depth;
 }
+
+/**
+ * Internal state for single producer single consumer block queues
+ */
+struct block_spsc_t
+{
+    vlc_mutex_t         lock;      /**< only taken to sleep or wake up */
+    vlc_cond_t          wait;      /**< Wait for data or room */
+    atomic_bool         reader_waiting;
+    atomic_bool         writer_waiting;
+    size_t              mask;
+
+    /* Keep the counters owned by each side on different cache lines */
+    char                pad0[64];
+    atomic_size_t       head;      /**< next to read, owned by the consumer */
+    atomic_size_t       bytes_out; /**< bytes ever read, owned by the consumer */
+    char                pad1[64];
+    atomic_size_t       tail;      /**< next to write, owned by the producer */
+    atomic_size_t       bytes_in;  /**< bytes ever written, owned by the producer */
+    char                pad2[64];
+
+    block_t             *ring[];
+};
+
+block_spsc_t *block_SpscNew(size_t size)
+{
+    size_t count = 1;
+    while (count < size)
+    {
+        count <<= 1;
+        if (unlikely(count == 0))
+            return NULL;
+    }
+
+    block_spsc_t *fifo = malloc(sizeof (*fifo) + count * sizeof (block_t *));
+    if (unlikely(fifo == NULL))
+        return NULL;
+
+    vlc_mutex_init(&fifo->lock);
+    vlc_cond_init(&fifo->wait);
+    atomic_init(&fifo->reader_waiting, false);
+    atomic_init(&fifo->writer_waiting, false);
+    fifo->mask = count - 1;
+    atomic_init(&fifo->head, 0);
+    atomic_init(&fifo->bytes_out, 0);
+    atomic_init(&fifo->tail, 0);
+    atomic_init(&fifo->bytes_in, 0);
+    return fifo;
+}
+
+void block_SpscRelease(block_spsc_t *fifo)
+{
+    block_t *block;
+
+    while ((block = block_SpscTryGet(fifo)) != NULL)
+        block_Release(block);
+    vlc_cond_destroy(&fifo->wait);
+    vlc_mutex_destroy(&fifo->lock);
+    free(fifo);
+}
+
+/* The index stores and the waiting flag loads are sequentially consistent:
+ * either the sleeping side sees the other's update before sleeping, or the
+ * updating side sees the flag and wakes it up. */
+static void block_SpscWake(block_spsc_t *fifo, atomic_bool *waiting)
+{
+    if (atomic_load(waiting))
+    {
+        vlc_mutex_lock(&fifo->lock);
+        vlc_cond_signal(&fifo->wait);
+        vlc_mutex_unlock(&fifo->lock);
+    }
+}
+
+static void block_SpscWait(block_spsc_t *fifo, atomic_bool *waiting,
+                           const atomic_size_t *index, size_t value)
+{
+    vlc_mutex_lock(&fifo->lock);
+    mutex_cleanup_push(&fifo->lock);
+    atomic_store(waiting, true);
+    while (atomic_load(index) == value)
+        vlc_cond_wait(&fifo->wait, &fifo->lock);
+    atomic_store(waiting, false);
+    vlc_cleanup_pop();
+    vlc_mutex_unlock(&fifo->lock);
+}
+
+bool block_SpscTryPut(block_spsc_t *fifo, block_t *block)
+{
+    size_t tail = atomic_load_explicit(&fifo->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&fifo->head, memory_order_acquire);
+
+    assert(block->p_next == NULL);
+    if (tail - head > fifo->mask)
+        return false; /* full */
+
+    fifo->ring[tail & fifo->mask] = block;
+    /* Only this thread writes the counter: no read-modify-write needed.
+     * Account before publishing, so that the size never goes below zero. */
+    size_t bytes = atomic_load_explicit(&fifo->bytes_in, memory_order_relaxed);
+    atomic_store_explicit(&fifo->bytes_in, bytes + block->i_buffer,
+                          memory_order_release);
+    atomic_store(&fifo->tail, tail + 1);
+    block_SpscWake(fifo, &fifo->reader_waiting);
+    return true;
+}
+
+void block_SpscPut(block_spsc_t *fifo, block_t *block)
+{
+    while (block != NULL)
+    {
+        block_t *next = block->p_next;
+
+        block->p_next = NULL;
+        while (!block_SpscTryPut(fifo, block))
+        {   /* Wait until the consumer frees a slot */
+            size_t head = atomic_load(&fifo->head);
+            if (atomic_load_explicit(&fifo->tail, memory_order_relaxed)
+                    - head > fifo->mask)
+                block_SpscWait(fifo, &fifo->writer_waiting, &fifo->head, head);
+        }
+        block = next;
+    }
+}
+
+block_t *block_SpscTryGet(block_spsc_t *fifo)
+{
+    size_t head = atomic_load_explicit(&fifo->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&fifo->tail, memory_order_acquire);
+
+    if (head == tail)
+        return NULL; /* empty */
+
+    block_t *block = fifo->ring[head & fifo->mask];
+    size_t bytes = atomic_load_explicit(&fifo->bytes_out, memory_order_relaxed);
+    atomic_store_explicit(&fifo->bytes_out, bytes + block->i_buffer,
+                          memory_order_release);
+    atomic_store(&fifo->head, head + 1);
+    block_SpscWake(fifo, &fifo->writer_waiting);
+    return block;
+}
+
+block_t *block_SpscGet(block_spsc_t *fifo)
+{
+    block_t *block;
+
+    vlc_testcancel();
+
+    while ((block = block_SpscTryGet(fifo)) == NULL)
+    {
+        size_t head = atomic_load_explicit(&fifo->head, memory_order_relaxed);
+        block_SpscWait(fifo, &fifo->reader_waiting, &fifo->tail, head);
+    }
+    return block;
+}
+
+size_t block_SpscGetCount(const block_spsc_t *fifo)
+{
+    size_t head = atomic_load(&fifo->head);
+    return atomic_load(&fifo->tail) - head;
+}
+
+size_t block_SpscGetBytes(const block_spsc_t *fifo)
+{
+    /* Both counters only grow (modulo wrap-around), and a block is counted
+     * in before it can be counted out: reading the out counter first keeps
+     * the difference from going below zero. */
+    size_t out = atomic_load_explicit(&fifo->bytes_out, memory_order_acquire);
+    return atomic_load_explicit(&fifo->bytes_in, memory_order_acquire) - out;
+}
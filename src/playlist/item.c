@@ -726,6 +726,81 @@ mtime_t playlist_GetNodeDuration( playlist_item_t* node )
     return duration;
 }
 
+static size_t CountLeaves( const playlist_item_t *node )
+{
+    size_t count = 0;
+
+    for( int i = 0; i < node->i_children; i++ )
+    {
+        const playlist_item_t *child = node->pp_children[i];
+        count += child->i_children >= 0 ? CountLeaves( child ) : 1;
+    }
+    return count;
+}
+
+static void SnapshotLeaves( const playlist_item_t *node,
+                            playlist_snapshot_t *snapshot )
+{
+    for( int i = 0; i < node->i_children; i++ )
+    {
+        const playlist_item_t *child = node->pp_children[i];
+        if( child->i_children >= 0 )
+        {
+            SnapshotLeaves( child, snapshot );
+            continue;
+        }
+
+        playlist_snapshot_entry_t *entry =
+            &snapshot->p_entries[snapshot->i_count++];
+        input_item_t *input = child->p_input;
+
+        entry->p_input = input_item_Hold( input );
+
+        vlc_mutex_lock( &input->lock );
+        entry->psz_uri = input->psz_uri ? strdup( input->psz_uri ) : NULL;
+        vlc_mutex_unlock( &input->lock );
+    }
+}
+
+playlist_snapshot_t *playlist_NodeSnapshot( playlist_t *p_playlist,
+                                            playlist_item_t *p_node )
+{
+    PL_ASSERT_LOCKED;
+
+    playlist_snapshot_t *snapshot = malloc( sizeof( *snapshot ) );
+    if( unlikely(snapshot == NULL) )
+        return NULL;
+
+    size_t count = CountLeaves( p_node );
+    snapshot->i_count = 0;
+    snapshot->p_entries = NULL;
+    if( count > 0 )
+    {
+        snapshot->p_entries = malloc( count * sizeof( *snapshot->p_entries ) );
+        if( unlikely(snapshot->p_entries == NULL) )
+        {
+            free( snapshot );
+            return NULL;
+        }
+        SnapshotLeaves( p_node, snapshot );
+    }
+    assert( snapshot->i_count == count );
+    return snapshot;
+}
+
+void playlist_SnapshotRelease( playlist_snapshot_t *snapshot )
+{
+    for( size_t i = 0; i < snapshot->i_count; i++ )
+    {
+        playlist_snapshot_entry_t *entry = &snapshot->p_entries[i];
+
+        input_item_Release( entry->p_input );
+        free( entry->psz_uri );
+    }
+    free( snapshot->p_entries );
+    free( snapshot );
+}
+
 /***************************************************************************
  * The following functions are local
  ***************************************************************************/
@@ -0,0 +1,331 @@
+/*****************************************************************************
+ * acoustid.c: AcoustID webservice client test
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "../../../modules/misc/webservices/acoustid.c"
+#include "../../../modules/misc/webservices/json.c"
+
+/* after the module sources, as they include config.h and assert.h again */
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <vlc_common.h>
+#include <vlc_memstream.h>
+#include "../../../lib/libvlc_internal.h"
+
+#include <vlc/vlc.h>
+
+/*
+ * Local stand-in for the AcoustID service: answers each posted fingerprint
+ * (either "fingerprint=" or "fingerprint.N=") with one result whose id is
+ * the fingerprint itself. Batch replies are sent in reverse order, so that
+ * the client has to match them by index.
+ */
+static int server_fd;
+static vlc_mutex_t lock = VLC_STATIC_MUTEX;
+static unsigned requests;
+static size_t longest_request; /**< largest request body */
+
+static void reply_result(struct vlc_memstream *ms, const char *fp, size_t len)
+{
+    vlc_memstream_printf(ms, "[{\"score\": 0.5, \"id\": \"%.*s\", "
+                         "\"recordings\": [{\"id\": \"mbid-%.*s\", "
+                         "\"title\": \"title-%.*s\", "
+                         "\"artists\": [{\"name\": \"artist\"}]}]}]",
+                         (int)len, fp, (int)len, fp, (int)len, fp);
+}
+
+static void *server_thread(void *data)
+{
+    (void) data;
+
+    for (;;)
+    {
+        int fd = accept(server_fd, NULL, NULL);
+        if (fd == -1)
+            continue;
+
+        int canc = vlc_savecancel();
+
+        /* read the headers, then as much body as they announce */
+        char *req = NULL;
+        size_t len = 0, size = 0, body_off = 0, body_len = 0;
+        ssize_t val;
+
+        do
+        {
+            if (size - len < 4096)
+            {
+                size += 65536;
+                req = realloc(req, size + 1);
+                assert(req != NULL);
+            }
+            val = recv(fd, req + len, size - len, 0);
+            if (val > 0)
+                len += val;
+            req[len] = '\0';
+
+            const char *end;
+            if (body_off == 0 && (end = strstr(req, "\r\n\r\n")) != NULL)
+            {
+                const char *cl = strstr(req, "Content-Length: ");
+                assert(cl != NULL && cl < end);
+                body_len = strtoul(cl + strlen("Content-Length: "), NULL, 10);
+                body_off = end + 4 - req;
+            }
+        }
+        while (val > 0 && (body_off == 0 || len < body_off + body_len));
+
+        assert(body_off != 0 && len == body_off + body_len);
+        const char *body = req + body_off;
+        assert(!strncmp(req, "POST /acoustid.php HTTP/1.0\r\n",
+                        strlen("POST /acoustid.php HTTP/1.0\r\n")));
+
+        vlc_mutex_lock(&lock);
+        requests++;
+        if (body_len > longest_request)
+            longest_request = body_len;
+        vlc_mutex_unlock(&lock);
+
+        const char *fps[ACOUSTID_MAX_BATCH];
+        size_t lens[ACOUSTID_MAX_BATCH];
+        size_t count = 0;
+        bool batch = false;
+
+        for (const char *p = strstr(body, "&fingerprint"); p != NULL;
+             p = strstr(p, "&fingerprint"))
+        {
+            p += strlen("&fingerprint");
+            if (*p == '.')
+            {
+                size_t index = strtoul(p + 1, (char **)&p, 10);
+                assert(index == count);
+                batch = true;
+            }
+            assert(*p == '=');
+            p++;
+            assert(count < ACOUSTID_MAX_BATCH);
+            fps[count] = p;
+            lens[count] = strcspn(p, "& ");
+            count++;
+        }
+
+        struct vlc_memstream reply;
+        vlc_memstream_open(&reply);
+        vlc_memstream_puts(&reply, "{\"status\": \"ok\", ");
+        if (!batch)
+        {
+            assert(count == 1);
+            vlc_memstream_puts(&reply, "\"results\": ");
+            reply_result(&reply, fps[0], lens[0]);
+        }
+        else
+        {
+            vlc_memstream_puts(&reply, "\"fingerprints\": [");
+            for (size_t i = count; i-- > 0;)
+            {
+                vlc_memstream_printf(&reply, "{\"index\": \"%zu\", "
+                                     "\"results\": ", i);
+                reply_result(&reply, fps[i], lens[i]);
+                vlc_memstream_puts(&reply, i ? "}, " : "}");
+            }
+            vlc_memstream_putc(&reply, ']');
+        }
+        vlc_memstream_putc(&reply, '}');
+        assert(vlc_memstream_close(&reply) == 0);
+
+        char hdr[256];
+        int hdrlen = snprintf(hdr, sizeof (hdr), "HTTP/1.1 200 OK\r\n"
+                              "Content-Type: application/json\r\n"
+                              "Content-Length: %zu\r\n"
+                              "Connection: close\r\n\r\n", reply.length);
+        assert(write(fd, hdr, hdrlen) == hdrlen);
+        assert(write(fd, reply.ptr, reply.length) == (ssize_t)reply.length);
+        free(reply.ptr);
+        free(req);
+        close(fd);
+
+        vlc_restorecancel(canc);
+    }
+    vlc_assert_unreachable();
+}
+
+/* Returns and resets the server statistics */
+static unsigned take_requests(size_t *longest)
+{
+    vlc_mutex_lock(&lock);
+    unsigned count = requests;
+    if (longest != NULL)
+        *longest = longest_request;
+    requests = 0;
+    longest_request = 0;
+    vlc_mutex_unlock(&lock);
+    return count;
+}
+
+static void check_results(acoustid_fingerprint_t *fp)
+{
+    char mbid[MB_ID_SIZE + 1], *title;
+
+    assert(fp->results.count == 1);
+    acoustid_result_t *r = &fp->results.p_results[0];
+    assert(!strcmp(r->psz_id, fp->psz_fingerprint));
+    assert(r->recordings.count == 1);
+
+    musicbrainz_recording_t *rec = &r->recordings.p_recordings[0];
+    assert(asprintf(&title, "title-%s", fp->psz_fingerprint) != -1);
+    assert(!strcmp(rec->psz_title, title));
+    free(title);
+    assert(!strcmp(rec->psz_artist, "artist"));
+    snprintf(mbid, sizeof (mbid), "mbid-%s", fp->psz_fingerprint);
+    assert(!strncmp(rec->s_musicbrainz_id, mbid, strlen(mbid)));
+}
+
+static void clean_results(acoustid_fingerprint_t *fp)
+{
+    for (unsigned i = 0; i < fp->results.count; i++)
+        free_acoustid_result_t(&fp->results.p_results[i]);
+    free(fp->results.p_results);
+    fp->results.p_results = NULL;
+    fp->results.count = 0;
+}
+
+int main(void)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    socklen_t addrlen = sizeof (addr);
+
+    server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    assert(server_fd != -1);
+    assert(bind(server_fd, (struct sockaddr *)&addr, sizeof (addr)) == 0);
+    assert(listen(server_fd, 8) == 0);
+    assert(getsockname(server_fd, (struct sockaddr *)&addr, &addrlen) == 0);
+
+    vlc_thread_t th;
+    assert(vlc_clone(&th, server_thread, NULL, VLC_THREAD_PRIORITY_LOW) == 0);
+
+    setenv("VLC_PLUGIN_PATH", "../modules", 1);
+
+    libvlc_instance_t *vlc = libvlc_new(0, NULL);
+    assert(vlc != NULL);
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    char url[64];
+    snprintf(url, sizeof (url), "http://127.0.0.1:%u/acoustid.php",
+             (unsigned) ntohs(addr.sin_port));
+    var_Create(obj, "acoustid-server", VLC_VAR_STRING);
+    var_SetString(obj, "acoustid-server", url);
+
+    char names[5][8] = { "AQADtA", "AQADtB", "AQADtC", "AQADtD", "AQADtE" };
+    acoustid_fingerprint_t fps[5];
+    acoustid_fingerprint_t *pfps[5];
+    bool answered[5];
+
+    for (unsigned i = 0; i < 5; i++)
+    {
+        fps[i].psz_fingerprint = names[i];
+        fps[i].i_duration = 180 + i;
+        fps[i].results.p_results = NULL;
+        fps[i].results.count = 0;
+        pfps[i] = &fps[i];
+    }
+
+    /* Single lookup */
+    assert(DoAcoustIdWebRequest(obj, &fps[0]) == VLC_SUCCESS);
+    assert(take_requests(NULL) == 1);
+    check_results(&fps[0]);
+    clean_results(&fps[0]);
+
+    /* Batched lookup: one round trip, replies matched by index */
+    assert(DoAcoustIdWebRequests(obj, pfps, answered, 5) == VLC_SUCCESS);
+    assert(take_requests(NULL) == 1);
+    for (unsigned i = 0; i < 5; i++)
+    {
+        assert(answered[i]);
+        check_results(&fps[i]);
+        clean_results(&fps[i]);
+    }
+
+    /* Fingerprints of usual length (a few KiB) still fit one request */
+    char *longs[5];
+    for (unsigned i = 0; i < 5; i++)
+    {
+        longs[i] = malloc(3001);
+        assert(longs[i] != NULL);
+        memset(longs[i], 'A' + i, 3000);
+        longs[i][3000] = '\0';
+        fps[i].psz_fingerprint = longs[i];
+    }
+
+    assert(DoAcoustIdWebRequests(obj, pfps, answered, 5) == VLC_SUCCESS);
+    assert(take_requests(NULL) == 1);
+    for (unsigned i = 0; i < 5; i++)
+    {
+        assert(answered[i]);
+        check_results(&fps[i]);
+        clean_results(&fps[i]);
+    }
+
+    /* Huge fingerprints: the batch is split to bound the body size */
+    const size_t huge = ACOUSTID_MAX_BODY * 2 / 5;
+    for (unsigned i = 0; i < 5; i++)
+    {
+        longs[i] = realloc(longs[i], huge + 1);
+        assert(longs[i] != NULL);
+        memset(longs[i], 'A' + i, huge);
+        longs[i][huge] = '\0';
+        fps[i].psz_fingerprint = longs[i];
+    }
+
+    size_t longest;
+    assert(DoAcoustIdWebRequests(obj, pfps, answered, 5) == VLC_SUCCESS);
+    assert(take_requests(&longest) == 3);
+    assert(longest <= ACOUSTID_MAX_BODY);
+    for (unsigned i = 0; i < 5; i++)
+    {
+        assert(answered[i]);
+        check_results(&fps[i]);
+        clean_results(&fps[i]);
+        free(longs[i]);
+    }
+
+    libvlc_release(vlc);
+
+    vlc_cancel(th);
+    vlc_join(th, NULL);
+    close(server_fd);
+
+    return 0;
+}
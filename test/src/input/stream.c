@@ -22,6 +22,7 @@
 #include "../lib/libvlc_internal.h"
 
 #include <vlc_md5.h>
+#include <vlc_access.h>
 #include <vlc_stream.h>
 #include <vlc_rand.h>
 #include <vlc_fs.h>
@@ -182,7 +183,7 @@ stream_close( struct reader *p_reader )
 }
 
 static struct reader *
-stream_open( const char *psz_url )
+stream_open( const char *psz_url, bool b_mmap, bool b_raw )
 {
     libvlc_instance_t *p_vlc;
     struct reader *p_reader;
@@ -194,6 +195,7 @@ stream_open( const char *psz_url )
         "--no-media-library",
         "--vout=dummy",
         "--aout=dummy",
+        b_mmap ? "--file-mmap" : "--no-file-mmap",
     };
 
     p_reader = calloc( 1, sizeof(struct reader) );
@@ -202,7 +204,12 @@ stream_open( const char *psz_url )
     p_vlc = libvlc_new( sizeof(argv) / sizeof(argv[0]), argv );
     assert( p_vlc != NULL );
 
-    p_reader->u.s = vlc_stream_NewURL( p_vlc->p_libvlc_int, psz_url );
+    /* The raw access has no stream filters, e.g. no prefetch nor cache */
+    if( b_raw )
+        p_reader->u.s = vlc_access_NewMRL( VLC_OBJECT( p_vlc->p_libvlc_int ),
+                                           psz_url );
+    else
+        p_reader->u.s = vlc_stream_NewURL( p_vlc->p_libvlc_int, psz_url );
     if( !p_reader->u.s )
     {
         libvlc_release( p_vlc );
@@ -216,7 +223,7 @@ stream_open( const char *psz_url )
     p_reader->pf_tell = stream_tell;
     p_reader->pf_seek = stream_seek;
     p_reader->p_data = p_vlc;
-    p_reader->psz_name = "stream";
+    p_reader->psz_name = b_raw ? "access" : "stream";
     return p_reader;
 }
 
@@ -344,6 +351,160 @@ test( struct reader **pp_readers, unsigned int i_readers, const char *psz_md5 )
 }
 
 #ifndef TEST_NET
+/* Sequential read throughput through the whole stream chain, as demuxers
+ * read, with the file access reading or mapping the file */
+static void
+bench_stream( const char *psz_url, bool b_mmap )
+{
+    struct reader *p_reader = stream_open( psz_url, b_mmap, false );
+    static uint8_t p_buf[7 * 188 * 64];
+    uint64_t i_total = 0;
+    ssize_t i_ret;
+
+    assert( p_reader != NULL );
+
+    mtime_t i_start = mdate();
+    for( unsigned i = 0; i < 4; i++ )
+    {
+        assert( p_reader->pf_seek( p_reader, 0 ) == 0 );
+        while( ( i_ret = p_reader->pf_read( p_reader, p_buf,
+                                            sizeof (p_buf) ) ) > 0 )
+            i_total += i_ret;
+    }
+    mtime_t i_elapsed = mdate() - i_start;
+
+    log( "%s: %.0f MiB/s\n", b_mmap ? "mmap" : "read",
+         (double)i_total * CLOCK_FREQ / ( i_elapsed ? i_elapsed : 1 )
+             / ( 1024 * 1024 ) );
+    p_reader->pf_close( p_reader );
+}
+
+/*
+ * Prefetch ranges: a seekable but slow-seeking source (as network accesses
+ * are), read back and forth between two distant offsets, as badly
+ * interleaved files are. Only filling the ranges should seek upstream, not
+ * every switch between them.
+ */
+#define SOURCE_SIZE (64 * 1024 * 1024)
+
+static uint8_t
+source_byte( uint64_t i_offset )
+{
+    return ( i_offset >> 12 ) ^ i_offset;
+}
+
+static ssize_t
+source_read( stream_t *s, void *p_buf, size_t i_len )
+{
+    uint64_t *p_pos = s->p_sys;
+    uint8_t *p = p_buf;
+
+    if( *p_pos >= SOURCE_SIZE )
+        return 0;
+    if( i_len > SOURCE_SIZE - *p_pos )
+        i_len = SOURCE_SIZE - *p_pos;
+    for( size_t i = 0; i < i_len; i++ )
+        p[i] = source_byte( *p_pos + i );
+    *p_pos += i_len;
+    return i_len;
+}
+
+static int
+source_seek( stream_t *s, uint64_t i_offset )
+{
+    *(uint64_t *)s->p_sys = i_offset;
+    return VLC_SUCCESS;
+}
+
+static int
+source_control( stream_t *s, int i_query, va_list args )
+{
+    (void) s;
+    switch( i_query )
+    {
+        case STREAM_CAN_SEEK:
+        case STREAM_CAN_CONTROL_PACE:
+            *va_arg( args, bool * ) = true;
+            return VLC_SUCCESS;
+        case STREAM_CAN_FASTSEEK:
+        case STREAM_CAN_PAUSE:
+            *va_arg( args, bool * ) = false;
+            return VLC_SUCCESS;
+        case STREAM_GET_SIZE:
+            *va_arg( args, uint64_t * ) = SOURCE_SIZE;
+            return VLC_SUCCESS;
+        case STREAM_GET_PTS_DELAY:
+            *va_arg( args, int64_t * ) = 0;
+            return VLC_SUCCESS;
+        default:
+            return VLC_EGENERIC;
+    }
+}
+
+static void
+source_destroy( stream_t *s )
+{
+    free( s->p_sys );
+}
+
+static void
+test_prefetch_ranges( void )
+{
+    const char * argv[] = {
+        "-v",
+        "--ignore-config",
+        "-I",
+        "dummy",
+        "--no-media-library",
+        "--prefetch-buffer-size=1024",
+        "--prefetch-ranges=4",
+    };
+    static const uint64_t pi_offsets[] = { 0, SOURCE_SIZE / 2 };
+    const unsigned i_passes = 100;
+    uint8_t p_buf[4096];
+
+    log( "Test prefetch ranges\n" );
+    libvlc_instance_t *p_vlc = libvlc_new( ARRAY_SIZE( argv ), argv );
+    assert( p_vlc != NULL );
+
+    stream_t *p_source = vlc_stream_CommonNew( VLC_OBJECT( p_vlc->p_libvlc_int ),
+                                               source_destroy );
+    assert( p_source != NULL );
+    p_source->p_sys = calloc( 1, sizeof (uint64_t) );
+    assert( p_source->p_sys != NULL );
+    p_source->pf_read = source_read;
+    p_source->pf_seek = source_seek;
+    p_source->pf_control = source_control;
+
+    stream_t *s = vlc_stream_FilterNew( p_source, "prefetch" );
+    assert( s != NULL );
+
+    /* The reader goes back and forth between two 64 KiB windows: once both
+     * are buffered, switching needs no upstream seek */
+    for( unsigned i = 0; i < 2 * i_passes; i++ )
+    {
+        uint64_t i_offset = pi_offsets[i % 2];
+
+        assert( vlc_stream_Seek( s, i_offset ) == VLC_SUCCESS );
+        for( unsigned j = 0; j < 16; j++ )
+        {
+            assert( vlc_stream_Read( s, p_buf, sizeof (p_buf) )
+                    == sizeof (p_buf) );
+            for( size_t k = 0; k < sizeof (p_buf); k++ )
+                assert( p_buf[k] == source_byte( i_offset + k ) );
+            i_offset += sizeof (p_buf);
+        }
+    }
+
+    int64_t i_seeks = var_GetInteger( s, "prefetch-seeks" );
+    log( "%"PRId64" upstream seeks for %u switches\n", i_seeks, 2 * i_passes );
+    assert( i_seeks >= 1 );
+    assert( i_seeks < i_passes / 4 );
+
+    vlc_stream_Delete( s );
+    libvlc_release( p_vlc );
+}
+
 static void
 fill_rand( int i_fd, size_t i_size )
 {
@@ -365,7 +526,7 @@ fill_rand( int i_fd, size_t i_size )
 int
 main( void )
 {
-    struct reader *pp_readers[3];
+    struct reader *pp_readers[4];
 
     test_init();
 
@@ -381,19 +542,27 @@ main( void )
     assert( asprintf( &psz_url, "file://%s", psz_tmp_path ) != -1 );
 
     assert( ( pp_readers[0] = libc_open( psz_tmp_path ) ) );
-    assert( ( pp_readers[1] = stream_open( psz_url ) ) );
+    assert( ( pp_readers[1] = stream_open( psz_url, false, false ) ) );
+    assert( ( pp_readers[2] = stream_open( psz_url, true, false ) ) );
+    assert( ( pp_readers[3] = stream_open( psz_url, true, true ) ) );
 
-    test( pp_readers, 2, NULL );
-    for( unsigned int i = 0; i < 2; ++i )
+    test( pp_readers, 4, NULL );
+    for( unsigned int i = 0; i < 4; ++i )
         pp_readers[i]->pf_close( pp_readers[i] );
+
+    log( "Benchmark file access\n" );
+    bench_stream( psz_url, false );
+    bench_stream( psz_url, true );
     free( psz_url );
 
     close( i_tmp_fd );
+
+    test_prefetch_ranges();
 #else
 
     log( "Test http url with stream\n" );
     alarm( 0 );
-    if( !( pp_readers[0] = stream_open( HTTP_URL ) ) )
+    if( !( pp_readers[0] = stream_open( HTTP_URL, false, false ) ) )
     {
         log( "WARNING: can't test http url" );
         return 0;
@@ -0,0 +1,198 @@
+/*****************************************************************************
+ * block.c: test and benchmark block allocation
+ *****************************************************************************
+ * Copyright (C) 2017 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_FORK
+# include <sys/wait.h>
+#endif
+#include <unistd.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include "transfer.h"
+
+/* Sizes the demuxers commonly ask for: TS packets, UDP datagrams, ... */
+static const size_t sizes[] = {
+    0, 1, 188, 7 * 188, 1500, 4096, 5000, 65536, 65537, 1 << 20,
+};
+
+static void check_block (const block_t *b, size_t size)
+{
+    assert (b != NULL);
+    assert (b->i_buffer == size);
+    assert (((uintptr_t)b->p_buffer % 32) == 0);
+    assert (b->p_buffer - b->p_start >= 32);
+    assert ((b->p_start + b->i_size) - (b->p_buffer + b->i_buffer) >= 32);
+    assert (b->p_next == NULL);
+    assert (b->i_flags == 0);
+    assert (b->i_pts == VLC_TS_INVALID && b->i_dts == VLC_TS_INVALID);
+}
+
+static void test_alloc (void)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(sizes); i++)
+    {
+        block_t *b = block_Alloc (sizes[i]);
+        check_block (b, sizes[i]);
+        memset (b->p_buffer, 0x5A, b->i_buffer);
+        b->i_flags = BLOCK_FLAG_DISCONTINUITY;
+        b->i_pts = 42;
+        block_Release (b);
+
+        /* recycled blocks must look brand new */
+        b = block_Alloc (sizes[i]);
+        check_block (b, sizes[i]);
+        block_Release (b);
+    }
+}
+
+static void test_realloc (void)
+{
+    for (size_t i = 1; i < ARRAY_SIZE(sizes); i++)
+    {
+        const size_t size = sizes[i];
+        block_t *b = block_Alloc (size);
+        assert (b != NULL);
+        for (size_t j = 0; j < size; j++)
+            b->p_buffer[j] = j;
+
+        b = block_Realloc (b, 100, size + 3000);
+        assert (b != NULL && b->i_buffer == size + 3100);
+        for (size_t j = 0; j < size; j++)
+            assert (b->p_buffer[100 + j] == (uint8_t)j);
+
+        b = block_Realloc (b, -100, 100 + size / 2);
+        assert (b != NULL && b->i_buffer == size / 2);
+        for (size_t j = 0; j < size / 2; j++)
+            assert (b->p_buffer[j] == (uint8_t)j);
+        block_Release (b);
+    }
+}
+
+/*
+ * Benchmark: a demux thread allocating packets which a decoder thread
+ * releases, as on the usual input path.
+ */
+static void malloc_Release (block_t *b)
+{
+    free (b);
+}
+
+/* What block_Alloc() used to do for every block */
+static block_t *malloc_Alloc (size_t size)
+{
+    block_t *b = malloc (sizeof (*b) + 32 + 64 + size);
+    if (b == NULL)
+        return NULL;
+    block_Init (b, b + 1, 32 + 64 + size);
+    b->p_buffer = (void *)(((uintptr_t)b->p_buffer + 63) & ~31);
+    b->i_buffer = size;
+    b->pf_release = malloc_Release;
+    return b;
+}
+
+static void fifo_Put (void *fifo, block_t *b)
+{
+    block_FifoPut (fifo, b);
+}
+
+static block_t *fifo_Get (void *fifo)
+{
+    return block_FifoGet (fifo);
+}
+
+static size_t current_rss (void)
+{
+    size_t rss = 0;
+#ifdef __linux__
+    FILE *stream = fopen ("/proc/self/statm", "r");
+    if (stream != NULL)
+    {
+        unsigned long pages;
+        if (fscanf (stream, "%*u %lu", &pages) == 1)
+            rss = pages * sysconf (_SC_PAGESIZE);
+        fclose (stream);
+    }
+#endif
+    return rss;
+}
+
+static void bench (const char *name, block_t *(*alloc) (size_t), unsigned count)
+{
+    /* don't let the fifo grow unbounded */
+    struct transfer cfg = {
+        .queue = block_FifoNew (), .put = fifo_Put, .get = fifo_Get,
+        .alloc = alloc, .window = 4096,
+    };
+    assert (cfg.queue != NULL);
+
+    size_t rss = current_rss ();
+    double rate = transfer_Run (&cfg, count);
+    printf ("%-8s %10.0f packets/s, RSS +%zu KiB\n", name, rate,
+            (current_rss () - rss) / 1024);
+    block_FifoRelease (cfg.queue);
+}
+
+/* Runs each benchmark in its own process, so that the memory one retains
+ * does not count for the next one */
+static void bench_process (const char *name, block_t *(*alloc) (size_t),
+                           unsigned count)
+{
+#ifdef HAVE_FORK
+    fflush (stdout);
+    pid_t pid = fork ();
+    assert (pid != -1);
+    if (pid == 0)
+    {
+        bench (name, alloc, count);
+        fflush (stdout);
+        _exit (0);
+    }
+
+    int status;
+    assert (waitpid (pid, &status, 0) == pid);
+    assert (WIFEXITED (status) && WEXITSTATUS (status) == 0);
+#else
+    bench (name, alloc, count);
+#endif
+}
+
+int main (int argc, char *argv[])
+{
+    /* Only bound the default run: long benchmarks can be asked for */
+    if (argc <= 1)
+        alarm (10);
+
+    test_alloc ();
+    test_realloc ();
+
+    unsigned count = (argc > 1) ? strtoul (argv[1], NULL, 0) : 100000;
+    bench_process ("malloc", malloc_Alloc, count);
+    bench_process ("pool", block_Alloc, count);
+    return 0;
+}
@@ -0,0 +1,139 @@
+/*****************************************************************************
+ * fifo.c: test and benchmark single producer single consumer block FIFO
+ *****************************************************************************
+ * Copyright (C) 2017 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include "transfer.h"
+
+static block_t *numbered (unsigned i)
+{
+    block_t *b = block_Alloc (i % 100);
+    assert (b != NULL);
+    b->i_pts = VLC_TS_0 + i;
+    return b;
+}
+
+static void test_single_thread (void)
+{
+    block_spsc_t *fifo = block_SpscNew (5); /* rounded to 8 */
+    assert (fifo != NULL);
+    assert (block_SpscTryGet (fifo) == NULL);
+    assert (block_SpscGetCount (fifo) == 0);
+
+    size_t bytes = 0;
+    for (unsigned i = 0; i < 8; i++)
+    {
+        assert (block_SpscTryPut (fifo, numbered (i)));
+        bytes += i % 100;
+    }
+    assert (block_SpscGetCount (fifo) == 8);
+    assert (block_SpscGetBytes (fifo) == bytes);
+
+    block_t *extra = numbered (8);
+    assert (!block_SpscTryPut (fifo, extra));
+
+    for (unsigned i = 0; i < 4; i++)
+    {
+        block_t *b = block_SpscGet (fifo);
+        assert (b->i_pts == VLC_TS_0 + i);
+        block_Release (b);
+    }
+    assert (block_SpscGetCount (fifo) == 4);
+    assert (block_SpscGetBytes (fifo) == 4 + 5 + 6 + 7);
+
+    /* lists are queued in order */
+    extra->p_next = numbered (9);
+    block_SpscPut (fifo, extra);
+    assert (block_SpscGetCount (fifo) == 6);
+
+    /* left over blocks are released */
+    block_SpscRelease (fifo);
+}
+
+/*
+ * Threaded transfer through the lock-free FIFO, compared with the locked one
+ */
+static void spsc_Put (void *fifo, block_t *b)
+{
+    block_SpscPut (fifo, b);
+}
+
+static block_t *spsc_Get (void *fifo)
+{
+    return block_SpscGet (fifo);
+}
+
+static void fifo_Put (void *fifo, block_t *b)
+{
+    block_FifoPut (fifo, b);
+}
+
+static block_t *fifo_Get (void *fifo)
+{
+    return block_FifoGet (fifo);
+}
+
+static void bench_locked (unsigned count)
+{
+    struct transfer cfg = {
+        .queue = block_FifoNew (), .put = fifo_Put, .get = fifo_Get,
+        .alloc = block_Alloc, .window = 4096,
+    };
+    assert (cfg.queue != NULL);
+    printf ("locked      %10.0f packets/s\n", transfer_Run (&cfg, count));
+    block_FifoRelease (cfg.queue);
+}
+
+static void bench_spsc (size_t size, unsigned count)
+{
+    block_spsc_t *fifo = block_SpscNew (size);
+    struct transfer cfg = {
+        .queue = fifo, .put = spsc_Put, .get = spsc_Get, .alloc = block_Alloc,
+    };
+    assert (fifo != NULL);
+    printf ("spsc (%4zu) %10.0f packets/s\n", size, transfer_Run (&cfg, count));
+    assert (block_SpscGetCount (fifo) == 0);
+    assert (block_SpscGetBytes (fifo) == 0);
+    block_SpscRelease (fifo);
+}
+
+int main (int argc, char *argv[])
+{
+    if (argc <= 1)
+        alarm (10); /* benchmarks may take longer */
+
+    test_single_thread ();
+
+    unsigned count = (argc > 1) ? strtoul (argv[1], NULL, 0) : 100000;
+    bench_locked (count);
+    bench_spsc (2, count); /* mostly full or empty: exercises sleeping */
+    bench_spsc (1024, count);
+    return 0;
+}
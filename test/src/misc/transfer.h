@@ -0,0 +1,85 @@
+/*****************************************************************************
+ * transfer.h: benchmark of blocks passed from a thread to another
+ *****************************************************************************
+ * Copyright (C) 2017 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*
+ * A demux thread allocates numbered packets and queues them, a decoder
+ * thread dequeues them in order and releases them, as on the input path.
+ */
+struct transfer
+{
+    void *queue;
+    void (*put) (void *queue, block_t *);
+    block_t *(*get) (void *queue);
+    block_t *(*alloc) (size_t);
+    unsigned window; /**< blocks in flight at most, 0 if the queue bounds it */
+};
+
+struct transfer_run
+{
+    const struct transfer *cfg;
+    vlc_sem_t released;
+    unsigned count;
+};
+
+static void *transfer_Consumer (void *data)
+{
+    struct transfer_run *run = data;
+
+    for (unsigned i = 0; i < run->count; i++)
+    {
+        block_t *b = run->cfg->get (run->cfg->queue);
+        assert (b->i_pts == VLC_TS_0 + i);
+        block_Release (b);
+        vlc_sem_post (&run->released);
+    }
+    return NULL;
+}
+
+/**
+ * Transfers count packets.
+ * @return the packet rate (per second)
+ */
+static double transfer_Run (const struct transfer *cfg, unsigned count)
+{
+    struct transfer_run run = { .cfg = cfg, .count = count };
+    vlc_thread_t th;
+
+    vlc_sem_init (&run.released, 0);
+    mtime_t start = mdate ();
+    if (vlc_clone (&th, transfer_Consumer, &run, VLC_THREAD_PRIORITY_LOW))
+        abort ();
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (cfg->window != 0 && i >= cfg->window)
+            vlc_sem_wait (&run.released);
+
+        /* mostly TS sized packets, some bigger PES */
+        block_t *b = cfg->alloc ((i % 16) ? 7 * 188 : 16384);
+        assert (b != NULL);
+        b->i_pts = VLC_TS_0 + i;
+        cfg->put (cfg->queue, b);
+    }
+    vlc_join (th, NULL);
+
+    mtime_t elapsed = mdate () - start;
+    vlc_sem_destroy (&run.released);
+    return (double)count * CLOCK_FREQ / (elapsed ? elapsed : 1);
+}
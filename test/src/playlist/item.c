@@ -0,0 +1,160 @@
+/*****************************************************************************
+ * item.c: test playlist items snapshots
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vlc_common.h>
+#include <vlc_input_item.h>
+#include <vlc_playlist.h>
+#include "../../../lib/libvlc_internal.h"
+
+#undef NDEBUG
+#include <assert.h>
+
+/* The playlist is created for the items given on the command line */
+static playlist_t *GetPlaylist(libvlc_int_t *vlc)
+{
+    vlc_list_t *list = vlc_list_children(vlc);
+    playlist_t *pl = NULL;
+
+    for (int i = 0; i < list->i_count && pl == NULL; i++)
+    {
+        vlc_object_t *obj = list->p_values[i].p_address;
+        if (!strcmp(obj->obj.object_type, "playlist"))
+            pl = (playlist_t *)obj;
+    }
+    vlc_list_release(list);
+    return pl;
+}
+
+static input_item_t *Add(playlist_t *pl, playlist_item_t *node,
+                         const char *uri, const char *name)
+{
+    input_item_t *input = input_item_New(uri, name);
+    assert(input != NULL);
+    assert(playlist_NodeAddInput(pl, input, node, PLAYLIST_END) != NULL);
+    input_item_Release(input);
+    return input;
+}
+
+static void CheckEntry(const playlist_snapshot_t *snapshot, size_t i,
+                       const input_item_t *input, const char *uri)
+{
+    const playlist_snapshot_entry_t *entry = &snapshot->p_entries[i];
+
+    assert(entry->p_input == input);
+    if (uri != NULL)
+    {
+        assert(entry->psz_uri != NULL);
+        assert(entry->psz_uri != input->psz_uri); /* a copy */
+        assert(!strcmp(entry->psz_uri, uri));
+    }
+}
+
+static void test_snapshot(playlist_t *pl)
+{
+    playlist_Lock(pl);
+
+    playlist_item_t *root = pl->p_playing;
+    assert(root->i_children == 1); /* from the command line */
+    input_item_t *nop = root->pp_children[0]->p_input;
+
+    /*
+     * nop
+     * a
+     * album/
+     *   b
+     *   empty/
+     *   c
+     * d
+     */
+    input_item_t *a = Add(pl, root, "file:///a.ogg", "a");
+    playlist_item_t *album = playlist_NodeCreate(pl, "album", root,
+                                                 PLAYLIST_END, 0);
+    assert(album != NULL);
+    input_item_t *b = Add(pl, album, "file:///album/b.ogg", "b");
+    playlist_item_t *empty = playlist_NodeCreate(pl, "empty", album,
+                                                 PLAYLIST_END, 0);
+    assert(empty != NULL);
+    input_item_t *c = Add(pl, album, "file:///album/c.ogg", "c");
+    input_item_t *d = Add(pl, root, "file:///d.ogg", "d");
+
+    /* Leaves only, in tree order */
+    playlist_snapshot_t *all = playlist_NodeSnapshot(pl, root);
+    assert(all != NULL);
+    assert(all->i_count == 5);
+    CheckEntry(all, 0, nop, NULL);
+    CheckEntry(all, 1, a, "file:///a.ogg");
+    CheckEntry(all, 2, b, "file:///album/b.ogg");
+    CheckEntry(all, 3, c, "file:///album/c.ogg");
+    CheckEntry(all, 4, d, "file:///d.ogg");
+
+    playlist_snapshot_t *sub = playlist_NodeSnapshot(pl, album);
+    assert(sub != NULL);
+    assert(sub->i_count == 2);
+    CheckEntry(sub, 0, b, "file:///album/b.ogg");
+    CheckEntry(sub, 1, c, "file:///album/c.ogg");
+    playlist_SnapshotRelease(sub);
+
+    playlist_snapshot_t *none = playlist_NodeSnapshot(pl, empty);
+    assert(none != NULL);
+    assert(none->i_count == 0);
+    playlist_SnapshotRelease(none);
+
+    /* The snapshot holds its items beyond the playlist ones */
+    playlist_Clear(pl, pl_Locked);
+    playlist_Unlock(pl);
+
+    assert(!strcmp(all->p_entries[4].p_input->psz_name, "d"));
+    assert(!strcmp(all->p_entries[4].psz_uri, "file:///d.ogg"));
+    playlist_SnapshotRelease(all);
+}
+
+int main(void)
+{
+    setenv("VLC_PLUGIN_PATH", "../modules", 1);
+    alarm(10);
+
+    const char *args[] = {
+        "test", "--ignore-config", "--quiet", "--no-auto-preparse",
+        "vlc://nop",
+    };
+    libvlc_int_t *vlc = libvlc_InternalCreate();
+    assert(vlc != NULL);
+    if (libvlc_InternalInit(vlc, ARRAY_SIZE(args), args) != VLC_SUCCESS)
+    {
+        libvlc_InternalDestroy(vlc);
+        return 77;
+    }
+
+    playlist_t *pl = GetPlaylist(vlc);
+    assert(pl != NULL);
+    test_snapshot(pl);
+
+    libvlc_InternalCleanup(vlc);
+    libvlc_InternalDestroy(vlc);
+    return 0;
+}